@@ -0,0 +1,105 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    argument_forwarding_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Measures passing of big by-value arguments through call and FunctionProxy.
+ *
+ * \details
+ * `copies` and `moves` counters show how many times the argument was copied
+ * and moved per call(trampolines pass it by reference, so it is moved only
+ * into the parameter of polymorphicExtend).
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <numeric>
+#include <vector>
+
+namespace {
+struct sum {};
+
+std::size_t copies = 0;
+std::size_t moves = 0;
+
+struct Samples {
+  Samples() = default;
+  explicit Samples(std::size_t count) : values_m(count, 1.0F) {}
+  Samples(Samples const &other) : values_m(other.values_m) { ++copies; }
+  Samples(Samples &&other) noexcept : values_m(std::move(other.values_m)) {
+    ++moves;
+  }
+  Samples &operator=(Samples const &) = delete;
+  Samples &operator=(Samples &&) = delete;
+  ~Samples() = default;
+
+  std::vector<float> values_m;
+};
+
+struct Accumulator {
+  float total_m = 0;
+};
+
+void polymorphicExtend(sum /*unused*/, Accumulator &obj, Samples samples) {
+  obj.total_m = std::accumulate(samples.values_m.begin(),
+                                samples.values_m.end(), obj.total_m);
+}
+
+using AccumulatorPolymorphic =
+    plugins::Polymorphic<plugins::TaggedSignature<sum, void(Samples)>>;
+
+void reportCounts(benchmark::State &state) {
+  auto const calls = static_cast<double>(state.iterations());
+  state.counters["copies"] = static_cast<double>(copies) / calls;
+  state.counters["moves"] = static_cast<double>(moves) / calls;
+  copies = 0;
+  moves = 0;
+}
+
+void BM_ForwardRvalueArgument(benchmark::State &state) {
+  AccumulatorPolymorphic accumulator{Accumulator{}};
+  Samples samples(static_cast<std::size_t>(state.range(0)));
+  copies = 0;
+  moves = 0;
+  for (auto _ : state) {
+    // moved-from samples are refilled, so the cost includes an allocation
+    accumulator.call<sum>(std::move(samples));
+    samples.values_m.resize(static_cast<std::size_t>(state.range(0)), 1.0F);
+  }
+  reportCounts(state);
+}
+
+void BM_ForwardLvalueArgument(benchmark::State &state) {
+  AccumulatorPolymorphic accumulator{Accumulator{}};
+  Samples samples(static_cast<std::size_t>(state.range(0)));
+  copies = 0;
+  moves = 0;
+  for (auto _ : state) {
+    accumulator.call<sum>(samples);
+  }
+  reportCounts(state);
+}
+
+void BM_ForwardThroughFunctionProxy(benchmark::State &state) {
+  AccumulatorPolymorphic accumulator{Accumulator{}};
+  Samples samples(static_cast<std::size_t>(state.range(0)));
+  copies = 0;
+  moves = 0;
+  for (auto _ : state) {
+    accumulator[sum{}](samples);
+  }
+  reportCounts(state);
+}
+} // namespace
+
+BENCHMARK(BM_ForwardRvalueArgument)->Range(1 << 4, 1 << 12);
+BENCHMARK(BM_ForwardLvalueArgument)->Range(1 << 4, 1 << 12);
+BENCHMARK(BM_ForwardThroughFunctionProxy)->Range(1 << 4, 1 << 12);
@@ -0,0 +1,222 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_all_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Compares calling a tag for shuffled objects of many types one by one and
+ * grouped by the target function.
+ *
+ * \details
+ * Difference comes from indirect branch prediction and instruction cache, so
+ * every benchmark reports branch and L1 instruction cache misses per call
+ * (`branch_misses`, `icache_misses`). Counters are read with Linux perf
+ * events and are omitted if the kernel doesn't provide them(other systems,
+ * most virtual machines, `perf_event_paranoid` above 2).
+ */
+
+#include <cxx_plugins/call_all.hpp>
+#include <cxx_plugins/polymorphic.hpp>
+#include <cxx_plugins/vector.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+//! \brief Hardware event counter of the calling thread
+class HardwareCounter {
+public:
+  HardwareCounter(std::uint32_t type, std::uint64_t config) noexcept {
+#ifdef __linux__
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    fd_m = static_cast<int>(
+        syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+#else
+    static_cast<void>(type);
+    static_cast<void>(config);
+#endif
+  }
+  HardwareCounter(HardwareCounter const &) = delete;
+  auto operator=(HardwareCounter const &) -> HardwareCounter & = delete;
+  ~HardwareCounter() {
+#ifdef __linux__
+    if (isAvailable())
+      close(fd_m);
+#endif
+  }
+
+  [[nodiscard]] auto isAvailable() const noexcept -> bool { return fd_m >= 0; }
+
+  void start() noexcept {
+#ifdef __linux__
+    if (isAvailable()) {
+      ioctl(fd_m, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_m, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  //! \brief Stops counting and returns number of events since start
+  auto stop() noexcept -> std::uint64_t {
+    std::uint64_t count = 0;
+#ifdef __linux__
+    if (isAvailable()) {
+      ioctl(fd_m, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd_m, &count, sizeof(count)) != sizeof(count))
+        count = 0;
+    }
+#endif
+    return count;
+  }
+
+private:
+  int fd_m = -1;
+};
+
+/*!
+ * \brief
+ * Counts branch and L1 instruction cache misses of the benchmark loop and
+ * reports them per call.
+ */
+class MissCounters {
+public:
+  void start() noexcept {
+    branch_misses_m.start();
+    icache_misses_m.start();
+  }
+
+  void report(benchmark::State &state) noexcept {
+    auto const calls = static_cast<double>(state.iterations() * state.range(0));
+    auto const branch_misses = branch_misses_m.stop();
+    auto const icache_misses = icache_misses_m.stop();
+    if (branch_misses_m.isAvailable()) {
+      state.counters["branch_misses"] =
+          static_cast<double>(branch_misses) / calls;
+    }
+    if (icache_misses_m.isAvailable()) {
+      state.counters["icache_misses"] =
+          static_cast<double>(icache_misses) / calls;
+    }
+  }
+
+private:
+#ifdef __linux__
+  HardwareCounter branch_misses_m{PERF_TYPE_HARDWARE,
+                                  PERF_COUNT_HW_BRANCH_MISSES};
+  HardwareCounter icache_misses_m{
+      PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8U) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16U)};
+#else
+  HardwareCounter branch_misses_m{0, 0};
+  HardwareCounter icache_misses_m{0, 0};
+#endif
+};
+
+struct step {};
+
+template <std::size_t id> struct System {
+  void step(float delta) noexcept {
+    state_m = state_m * static_cast<float>(id + 1) + delta;
+  }
+  float state_m = 0;
+};
+
+template <typename T>
+void polymorphicExtend(step /*unused*/, T &obj, float delta) {
+  obj.step(delta);
+}
+
+using SystemPolymorphic =
+    plugins::Polymorphic<plugins::TaggedSignature<step, void(float)>>;
+
+constexpr std::size_t type_count = 16;
+
+template <std::size_t... ids>
+auto makeShuffledSystems(std::size_t count,
+                         std::index_sequence<ids...> /*unused*/)
+    -> plugins::Vector<SystemPolymorphic> {
+  using Factory = SystemPolymorphic (*)();
+  static constexpr Factory factories[] = {
+      [] { return SystemPolymorphic(System<ids>{}); }...};
+
+  plugins::Vector<SystemPolymorphic> result;
+  result.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    result.push_back(factories[i % sizeof...(ids)]());
+  }
+  std::shuffle(result.begin(), result.end(), std::mt19937{42});
+  return result;
+}
+
+auto makeShuffledSystems(std::size_t count)
+    -> plugins::Vector<SystemPolymorphic> {
+  return makeShuffledSystems(count, std::make_index_sequence<type_count>{});
+}
+
+void BM_CallAllOneByOne(benchmark::State &state) {
+  auto systems = makeShuffledSystems(static_cast<std::size_t>(state.range(0)));
+  MissCounters misses;
+  misses.start();
+  for (auto _ : state) {
+    for (auto &system : systems) {
+      system.call<step>(0.5F);
+    }
+    benchmark::ClobberMemory();
+  }
+  misses.report(state);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_CallAllGrouped(benchmark::State &state) {
+  auto systems = makeShuffledSystems(static_cast<std::size_t>(state.range(0)));
+  MissCounters misses;
+  misses.start();
+  for (auto _ : state) {
+    plugins::callAll<step>(systems, 0.5F);
+    benchmark::ClobberMemory();
+  }
+  misses.report(state);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_CallAllCachedSchedule(benchmark::State &state) {
+  auto systems = makeShuffledSystems(static_cast<std::size_t>(state.range(0)));
+  auto schedule = plugins::makeCallSchedule<step>(systems);
+  state.counters["runs"] = static_cast<double>(schedule.runCount());
+  MissCounters misses;
+  misses.start();
+  for (auto _ : state) {
+    schedule(0.5F);
+    benchmark::ClobberMemory();
+  }
+  misses.report(state);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+} // namespace
+
+BENCHMARK(BM_CallAllOneByOne)->Range(1 << 8, 1 << 16);
+BENCHMARK(BM_CallAllGrouped)->Range(1 << 8, 1 << 16);
+BENCHMARK(BM_CallAllCachedSchedule)->Range(1 << 8, 1 << 16);
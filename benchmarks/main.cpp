@@ -0,0 +1,17 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    main.cpp
+ * \author  Andrey Ponomarev
+ * \date    12 Oct 2020
+ * \brief
+ * Entry point for benchmarks
+ */
+
+#include <benchmark/benchmark.h>
+
+BENCHMARK_MAIN();
@@ -0,0 +1,35 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    plugin_load_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Measures loading and unloading of the example plugin. Function tables and
+ * type infos of the plugin are constant initialized, so loading it shouldn't
+ * run any code of cxx_plugins.
+ */
+
+#include <api.hpp>
+
+#include <boost/dll/shared_library.hpp>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+void loadExamplePlugin(benchmark::State &state) {
+  for (auto _ : state) {
+    boost::dll::shared_library library(CXX_PLUGINS_EXAMPLE_PLUGIN_PATH);
+    auto &get_system =
+        library.get<APISystemGetSignature>("get_graphics_engine");
+    auto system = get_system();
+    benchmark::DoNotOptimize(system.typeIndex());
+  }
+}
+} // namespace
+
+BENCHMARK(loadExamplePlugin)->Iterations(1000)->Unit(benchmark::kMicrosecond);
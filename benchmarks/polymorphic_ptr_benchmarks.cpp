@@ -0,0 +1,278 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_ptr_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Compares calls through function table pointer(PrimitivePolymorphicPtr) and
+ * through function pointers stored inside of the pointer(InlinePolymorphicPtr).
+ * Also measures guarded devirtualization with callLikely, calls by tag name
+ * and type checks(`isA`), and arrays of PolymorphicPtr with arrays of
+ * IntrusivePolymorphicPtr.
+ */
+
+#include <cxx_plugins/intrusive_polymorphic_ptr.hpp>
+#include <cxx_plugins/polymorphic_ptr.hpp>
+#include <cxx_plugins/visit.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+struct update {};
+struct value {};
+
+template <std::size_t id> struct Counter {
+  void update(int delta) noexcept {
+    state_m += delta * static_cast<int>(id + 1);
+  }
+  int state_m = 0;
+};
+
+template <typename T>
+void polymorphicExtend(update /*unused*/, T &obj, int delta) {
+  obj.update(delta);
+}
+template <typename T> auto polymorphicExtend(value /*unused*/, T const &obj) {
+  return obj.state_m;
+}
+
+using UpdateSignature = plugins::TaggedSignature<update, void(int)>;
+using ValueSignature = plugins::TaggedSignature<value, int() const>;
+
+template <typename PtrT> auto makeMixedPointers(std::size_t count) {
+  std::vector<Counter<0>> first(count / 2 + 1);
+  std::vector<Counter<1>> second(count / 2 + 1);
+  std::vector<PtrT> pointers;
+  pointers.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i % 2 == 0) {
+      pointers.emplace_back(first[i / 2]);
+    } else {
+      pointers.emplace_back(second[i / 2]);
+    }
+  }
+  // objects of both types are mixed, so every call is a dependent load chain
+  std::shuffle(pointers.begin(), pointers.end(), std::mt19937{42});
+  return std::make_tuple(std::move(first), std::move(second),
+                         std::move(pointers));
+}
+
+template <typename PtrT> void BM_PolymorphicPtrCall(benchmark::State &state) {
+  auto [first, second, pointers] =
+      makeMixedPointers<PtrT>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    for (auto &pointer : pointers) {
+      pointer.template call<update>(1);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename PtrT> void BM_PolymorphicPtrCallLikely(benchmark::State &state) {
+  auto [first, second, pointers] =
+      makeMixedPointers<PtrT>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    for (auto &pointer : pointers) {
+      pointer.template callLikely<update, Counter<0>, Counter<1>>(1);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+//! \brief Calls with tag names known only at runtime(see dynamic_call.hpp)
+void BM_PolymorphicPtrCallByName(benchmark::State &state) {
+  using PtrT = plugins::PolymorphicPtr<UpdateSignature, ValueSignature>;
+  auto const count = static_cast<std::size_t>(state.range(0));
+  std::vector<Counter<0>> first(count / 2 + 1);
+  std::vector<Counter<1>> second(count / 2 + 1);
+  std::vector<PtrT> pointers;
+  pointers.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i % 2 == 0) {
+      pointers.emplace_back(&first[i / 2]);
+    } else {
+      pointers.emplace_back(&second[i / 2]);
+    }
+  }
+  std::shuffle(pointers.begin(), pointers.end(), std::mt19937{42});
+  int delta = 1;
+  int result = 0;
+  plugins::DynamicArgument const update_arguments[] = {delta};
+  struct Command {
+    std::string name;
+    plugins::DynamicArguments arguments;
+    plugins::DynamicArgument result;
+  };
+  std::vector<Command> const commands = {
+      {"update", {update_arguments, 1}, {}}, {"value", {}, result}};
+  for (auto _ : state) {
+    std::size_t i = 0;
+    for (auto &pointer : pointers) {
+      auto const &command = commands[i++ % commands.size()];
+      pointer.callByName(command.name, command.arguments, command.result);
+    }
+    benchmark::DoNotOptimize(result);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+//! \brief `isA` that matches(`hit`) or doesn't match the type of every object
+template <bool hit> void BM_PolymorphicPtrIsA(benchmark::State &state) {
+  using PtrT = plugins::PolymorphicPtr<UpdateSignature, ValueSignature>;
+  std::vector<Counter<0>> objects(static_cast<std::size_t>(state.range(0)));
+  std::vector<PtrT> pointers;
+  pointers.reserve(objects.size());
+  for (auto &obj : objects) {
+    pointers.emplace_back(&obj);
+  }
+  using CheckedT = std::conditional_t<hit, Counter<0>, Counter<1>>;
+  for (auto _ : state) {
+    std::size_t matches = 0;
+    for (auto const &pointer : pointers) {
+      matches += pointer.template isA<CheckedT>() ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/*!
+ * \brief
+ * Compares type_index of info from "another library"(different address, equal
+ * name) with type_id, the path of `isA` for objects created by plugins.
+ */
+template <bool hit> void BM_TypeIndexFromOtherLibrary(benchmark::State &state) {
+  using CheckedT = std::conditional_t<hit, Counter<0>, Counter<1>>;
+  auto const &info = plugins::impl::internTypeInfo(
+      plugins::impl::type_name_v<Counter<0>>);
+  plugins::type_index const index(info);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index == plugins::type_id<CheckedT>());
+  }
+}
+
+//! \brief Updates the object if its type is one of `Ts`, checking one by one
+template <typename T, typename... Ts, typename PtrT>
+void updateWithCastChain(PtrT &pointer) {
+  if (auto *counter_p = polymorphicCast<T>(pointer)) {
+    counter_p->update(1);
+  } else if constexpr (sizeof...(Ts) != 0) {
+    updateWithCastChain<Ts...>(pointer);
+  }
+}
+
+/*!
+ * \brief
+ * Finds concrete type of objects of 8 types with `visit`(`use_visit`) or with
+ * a chain of `polymorphicCast`.
+ */
+template <bool use_visit> void BM_PolymorphicPtrDowncast(benchmark::State &state) {
+  using PtrT = plugins::PolymorphicPtr<UpdateSignature, ValueSignature>;
+  using TypesT = plugins::TypeList<Counter<0>, Counter<1>, Counter<2>,
+                                   Counter<3>, Counter<4>, Counter<5>,
+                                   Counter<6>, Counter<7>>;
+  auto const count = static_cast<std::size_t>(state.range(0));
+  auto objects = std::make_tuple(
+      std::vector<Counter<0>>(count), std::vector<Counter<1>>(count),
+      std::vector<Counter<2>>(count), std::vector<Counter<3>>(count),
+      std::vector<Counter<4>>(count), std::vector<Counter<5>>(count),
+      std::vector<Counter<6>>(count), std::vector<Counter<7>>(count));
+  std::vector<PtrT> pointers;
+  pointers.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    std::apply(
+        [&pointers, i](auto &... vectors) {
+          std::size_t type = 0;
+          ((type++ == i % 8 ? (void)pointers.emplace_back(&vectors[i])
+                            : void()),
+           ...);
+        },
+        objects);
+  }
+  std::shuffle(pointers.begin(), pointers.end(), std::mt19937{42});
+  auto const visitor =
+      plugins::Overloaded{[](auto &counter) { counter.update(1); },
+                          [](plugins::UnknownType /*unused*/) {}};
+  for (auto _ : state) {
+    for (auto &pointer : pointers) {
+      if constexpr (use_visit) {
+        plugins::visit<TypesT>(pointer, visitor);
+      } else {
+        updateWithCastChain<Counter<0>, Counter<1>, Counter<2>, Counter<3>,
+                            Counter<4>, Counter<5>, Counter<6>, Counter<7>>(
+            pointer);
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/*!
+ * \brief
+ * Calls objects created by IntrusivePolymorphicPtr::make through an array of
+ * intrusive pointers(`intrusive`) or of PolymorphicPtr to the same objects.
+ */
+template <bool intrusive>
+void BM_PolymorphicPtrArrayCall(benchmark::State &state) {
+  using IntrusivePtrT =
+      plugins::IntrusivePolymorphicPtr<UpdateSignature, ValueSignature>;
+  using PtrT = std::conditional_t<intrusive, IntrusivePtrT,
+                                  typename IntrusivePtrT::PolymorphicPtrT>;
+  auto const count = static_cast<std::size_t>(state.range(0));
+  std::vector<IntrusivePtrT> objects;
+  objects.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    objects.push_back(i % 2 == 0 ? IntrusivePtrT::make<Counter<0>>({})
+                                 : IntrusivePtrT::make<Counter<1>>({}));
+  }
+  std::vector<PtrT> pointers(objects.begin(), objects.end());
+  std::shuffle(pointers.begin(), pointers.end(), std::mt19937{42});
+  for (auto _ : state) {
+    for (auto &pointer : pointers) {
+      pointer.template call<update>(1);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["pointer_bytes"] = static_cast<double>(sizeof(PtrT));
+  for (auto &object : objects) {
+    object.destroy({});
+  }
+}
+
+using TablePtr =
+    plugins::PrimitivePolymorphicPtr<UpdateSignature, ValueSignature>;
+using InlinePtr =
+    plugins::InlinePolymorphicPtr<UpdateSignature, ValueSignature>;
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrCall, TablePtr)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrCall, InlinePtr)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrCallLikely, TablePtr)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrCallLikely, InlinePtr)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK(BM_PolymorphicPtrCallByName)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrIsA, true)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrIsA, false)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_TypeIndexFromOtherLibrary, true);
+BENCHMARK_TEMPLATE(BM_TypeIndexFromOtherLibrary, false);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrDowncast, true)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrDowncast, false)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrArrayCall, true)->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicPtrArrayCall, false)->Range(1 << 8, 1 << 16);
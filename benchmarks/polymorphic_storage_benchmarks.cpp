@@ -0,0 +1,206 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_storage_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    12 Oct 2020
+ * \brief
+ * Compares storage policies of Polymorphic on containers of plugin objects.
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <memory_resource>
+#include <vector>
+
+namespace {
+struct update {};
+
+template <std::size_t size> struct Plugin {
+  void update() noexcept { ++state_m[0]; }
+  std::uint32_t state_m[size / sizeof(std::uint32_t)] = {};
+};
+
+template <typename T> void polymorphicExtend(update /*unused*/, T &obj) {
+  obj.update();
+}
+
+template <typename StoragePolicy>
+using PluginPolymorphic = plugins::BasicPolymorphic<
+    StoragePolicy, plugins::TaggedSignature<update, void()>>;
+
+using Small = Plugin<16>;
+using Medium = Plugin<48>;
+using Large = Plugin<256>;
+
+template <typename StoragePolicy>
+auto makePlugins(std::size_t count) -> std::vector<PluginPolymorphic<StoragePolicy>> {
+  std::vector<PluginPolymorphic<StoragePolicy>> result;
+  result.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    switch (i % 3) {
+    case 0:
+      result.emplace_back(Small{});
+      break;
+    case 1:
+      result.emplace_back(Medium{});
+      break;
+    default:
+      result.emplace_back(Large{});
+      break;
+    }
+  }
+  return result;
+}
+
+template <typename StoragePolicy>
+void BM_PolymorphicStorageConstruct(benchmark::State &state) {
+  auto const count = static_cast<std::size_t>(state.range(0));
+  for (auto _ : state) {
+    auto plugins = makePlugins<StoragePolicy>(count);
+    benchmark::DoNotOptimize(plugins.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+/*!
+ * Constructs heap allocated objects from several threads, either with the
+ * default memory resource(looked up under global mutex) or with thread local
+ * resource passed with std::allocator_arg.
+ */
+void BM_PolymorphicStorageConstructThreaded(benchmark::State &state) {
+  using PolymorphicT = PluginPolymorphic<plugins::HeapStorage>;
+  bool const use_local_resource = state.range(0) != 0;
+  std::pmr::unsynchronized_pool_resource local_resource;
+  for (auto _ : state) {
+    if (use_local_resource) {
+      PolymorphicT plugin{std::allocator_arg, local_resource, Large{}};
+      benchmark::DoNotOptimize(plugin.data());
+    } else {
+      PolymorphicT plugin{Large{}};
+      benchmark::DoNotOptimize(plugin.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename StoragePolicy>
+void BM_PolymorphicStorageCopy(benchmark::State &state) {
+  auto const plugins = makePlugins<StoragePolicy>(
+      static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto copy = plugins;
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename StoragePolicy>
+void BM_PolymorphicStorageCall(benchmark::State &state) {
+  auto plugins =
+      makePlugins<StoragePolicy>(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    for (auto &plugin : plugins) {
+      plugin.template call<update>();
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <typename StoragePolicy>
+void BM_PolymorphicStorageRelocate(benchmark::State &state) {
+  using PolymorphicT = PluginPolymorphic<StoragePolicy>;
+  auto const count = static_cast<std::size_t>(state.range(0));
+  auto plugins = makePlugins<StoragePolicy>(count);
+  std::vector<std::aligned_storage_t<sizeof(PolymorphicT),
+                                     alignof(PolymorphicT)>>
+      buffer(count);
+  auto *src_p = plugins.data();
+  auto *dst_p = reinterpret_cast<PolymorphicT *>(buffer.data());
+  for (auto _ : state) {
+    plugins::uninitializedRelocate(src_p, src_p + count, dst_p);
+    std::swap(src_p, dst_p);
+    benchmark::ClobberMemory();
+  }
+  // objects should end up in the vector to be destroyed properly
+  if (src_p != plugins.data()) {
+    plugins::uninitializedRelocate(src_p, src_p + count, plugins.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_PolymorphicStorageCallReference(benchmark::State &state) {
+  auto const count = static_cast<std::size_t>(state.range(0));
+  std::vector<Small> small(count / 3 + 1);
+  std::vector<Medium> medium(count / 3 + 1);
+  std::vector<Large> large(count / 3 + 1);
+
+  std::vector<PluginPolymorphic<plugins::ReferenceStorage>> refs;
+  refs.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    switch (i % 3) {
+    case 0:
+      refs.emplace_back(small[i / 3]);
+      break;
+    case 1:
+      refs.emplace_back(medium[i / 3]);
+      break;
+    default:
+      refs.emplace_back(large[i / 3]);
+      break;
+    }
+  }
+
+  for (auto _ : state) {
+    for (auto &ref : refs) {
+      ref.call<update>();
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+using InlinePolicy = plugins::InlineStorage<sizeof(Large)>;
+using HeapPolicy = plugins::HeapStorage;
+using HybridPolicy = plugins::HybridStorage<64>;
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageConstruct, InlinePolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageConstruct, HeapPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageConstruct, HybridPolicy)
+    ->Range(1 << 8, 1 << 16);
+
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCopy, InlinePolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCopy, HeapPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCopy, HybridPolicy)
+    ->Range(1 << 8, 1 << 16);
+
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCall, InlinePolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCall, HeapPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageCall, HybridPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageRelocate, InlinePolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageRelocate, HeapPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK_TEMPLATE(BM_PolymorphicStorageRelocate, HybridPolicy)
+    ->Range(1 << 8, 1 << 16);
+BENCHMARK(BM_PolymorphicStorageCallReference)->Range(1 << 8, 1 << 16);
+BENCHMARK(BM_PolymorphicStorageConstructThreaded)
+    ->ArgName("local_resource")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 8);
@@ -0,0 +1,97 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_vector_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Compares calling a tag on every object of PolymorphicVector and of vector of
+ * Polymorphic.
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+#include <cxx_plugins/polymorphic_vector.hpp>
+#include <cxx_plugins/vector.hpp>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+struct step {};
+
+template <std::size_t id> struct System {
+  void step(float delta) noexcept { state_m += delta * static_cast<float>(id); }
+  float state_m = 0;
+};
+
+template <typename T>
+void polymorphicExtend(step /*unused*/, T &obj, float delta) {
+  obj.step(delta);
+}
+
+using StepSignature = plugins::TaggedSignature<step, void(float)>;
+
+template <typename Inserter>
+void fillSystems(std::size_t count, Inserter &&insert) {
+  for (std::size_t i = 0; i < count; ++i) {
+    switch (i % 4) {
+    case 0:
+      insert(System<0>{});
+      break;
+    case 1:
+      insert(System<1>{});
+      break;
+    case 2:
+      insert(System<2>{});
+      break;
+    default:
+      insert(System<3>{});
+      break;
+    }
+  }
+}
+
+void BM_VectorOfPolymorphicCall(benchmark::State &state) {
+  plugins::Vector<plugins::Polymorphic<StepSignature>> systems;
+  fillSystems(static_cast<std::size_t>(state.range(0)),
+              [&systems](auto &&system) { systems.emplace_back(system); });
+  for (auto _ : state) {
+    for (auto &system : systems) {
+      system.call<step>(0.5F);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_PolymorphicVectorForEach(benchmark::State &state) {
+  plugins::PolymorphicVector<StepSignature> systems;
+  fillSystems(static_cast<std::size_t>(state.range(0)),
+              [&systems](auto &&system) { systems.pushBack(system); });
+  for (auto _ : state) {
+    systems.forEach<step>(0.5F);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_PolymorphicVectorIterate(benchmark::State &state) {
+  plugins::PolymorphicVector<StepSignature> systems;
+  fillSystems(static_cast<std::size_t>(state.range(0)),
+              [&systems](auto &&system) { systems.pushBack(system); });
+  for (auto _ : state) {
+    for (auto system : systems) {
+      system.call<step>(0.5F);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+} // namespace
+
+BENCHMARK(BM_VectorOfPolymorphicCall)->Range(1 << 8, 1 << 18);
+BENCHMARK(BM_PolymorphicVectorForEach)->Range(1 << 8, 1 << 18);
+BENCHMARK(BM_PolymorphicVectorIterate)->Range(1 << 8, 1 << 18);
@@ -0,0 +1,90 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    type_map_benchmarks.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Compares lookups by type in TypeMap, StaticTypeMap and
+ * `UnorderedMap<type_index, V>`.
+ */
+
+#include <cxx_plugins/type_map.hpp>
+#include <cxx_plugins/unordered_map.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+template <std::size_t I> struct Service {};
+
+constexpr std::size_t service_count = 64;
+
+template <std::size_t... I>
+auto serviceTypes(std::index_sequence<I...> /*unused*/) {
+  std::vector<plugins::type_index> types = {plugins::type_id<Service<I>>()...};
+  std::shuffle(types.begin(), types.end(), std::mt19937{42});
+  return types;
+}
+
+void BM_TypeMapFind(benchmark::State &state) {
+  auto const types = serviceTypes(std::make_index_sequence<service_count>{});
+  plugins::TypeMap<std::size_t> map;
+  for (std::size_t i = 0; i < types.size(); ++i) {
+    map.tryEmplace(types[i], i);
+  }
+  for (auto _ : state) {
+    std::size_t sum = 0;
+    for (auto type : types) {
+      sum += *map.find(type);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * service_count);
+}
+
+void BM_UnorderedMapFind(benchmark::State &state) {
+  auto const types = serviceTypes(std::make_index_sequence<service_count>{});
+  plugins::UnorderedMap<plugins::type_index, std::size_t,
+                        boost::hash<plugins::type_index>>
+      map;
+  for (std::size_t i = 0; i < types.size(); ++i) {
+    map.emplace(types[i], i);
+  }
+  for (auto _ : state) {
+    std::size_t sum = 0;
+    for (auto type : types) {
+      sum += map.find(type)->second;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * service_count);
+}
+
+template <std::size_t... I>
+void BM_StaticTypeMapFind(benchmark::State &state,
+                          std::index_sequence<I...> /*unused*/) {
+  plugins::StaticTypeMap<std::size_t> map;
+  (map.tryEmplace<Service<I>>(I), ...);
+  for (auto _ : state) {
+    std::size_t sum = (std::size_t{0} + ... + *map.find<Service<I>>());
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * service_count);
+}
+} // namespace
+
+BENCHMARK(BM_TypeMapFind);
+BENCHMARK(BM_UnorderedMapFind);
+BENCHMARK_CAPTURE(BM_StaticTypeMapFind, services,
+                  std::make_index_sequence<service_count>{});
@@ -11,9 +11,12 @@
 # This file contains initialization for cached variables and options of project
 
 option(CXX_PLUGINS_BUILD_TESTS "Build tests for CXX Plugins library" OFF)
+option(CXX_PLUGINS_BUILD_BENCHMARKS "Build benchmarks for CXX Plugins library" OFF)
 option(CXX_PLUGINS_SHARED      "Build CXX Plugins as shared library(isn't implemented yet)" OFF)
 option(CXX_PLUGINS_BUILD_DOCUMENTATION  "Create HTML based documentation" OFF)
 option(CXX_PLUGINS_ENABLE_RTTI_TYPE_INDEX OFF)
+option(CXX_PLUGINS_INSTRUMENT "Count calls through function tables per interface, tag and type" OFF)
+option(CXX_PLUGINS_INSTRUMENT_LATENCY "Measure duration of instrumented calls" OFF)
 
 if (CXX_PLUGINS_BUILD_TESTS)
   enable_testing()
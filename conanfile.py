@@ -10,8 +10,10 @@ class CxxPlugins(ConanFile):
     settings = "os", "compiler", "build_type", "arch"
     generators = "cmake"
 
-    options = {"shared": [True, False], "enable_tests": [True, False], "enable_documentation": [True, False]}
-    default_options = {"shared": False, "enable_tests": False, "enable_documentation": False}
+    options = {"shared": [True, False], "enable_tests": [True, False], "enable_benchmarks": [True, False],
+               "enable_documentation": [True, False]}
+    default_options = {"shared": False, "enable_tests": False, "enable_benchmarks": False,
+                       "enable_documentation": False}
     requires = ["boost/1.73.0", "rapidjson/1.1.0", "fmt/6.2.1"]
     exports_sources = "*", "!.github", "!.vscode", "!build"
 
@@ -22,6 +24,7 @@ class CxxPlugins(ConanFile):
 
     def package_id(self):
         del self.info.options.enable_tests
+        del self.info.options.enable_benchmarks
         del self.info.options.enable_documentation
 
     # def source(self):
@@ -31,6 +34,7 @@ class CxxPlugins(ConanFile):
     def build(self):
         cmake = CMake(self)
         cmake.definitions['CXX_PLUGINS_BUILD_TESTS'] = 'ON' if self.options.enable_tests else 'OFF'
+        cmake.definitions['CXX_PLUGINS_BUILD_BENCHMARKS'] = 'ON' if self.options.enable_benchmarks else 'OFF'
         cmake.definitions['CXX_PLUGINS_SHARED'] = 'ON' if self.options.shared else 'OFF'
         cmake.definitions['CXX_PLUGINS_BUILD_DOCUMENTATION'] = 'ON' if self.options.enable_documentation else 'OFF'
 
@@ -42,6 +46,8 @@ class CxxPlugins(ConanFile):
     def requirements(self):
         if self.options.enable_tests:
             self.requires('gtest/1.10.0')
+        if self.options.enable_benchmarks:
+            self.requires('benchmark/1.5.2')
 
     def package(self):
         self.copy("*", dst="include", src="include")
@@ -0,0 +1,208 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_all.hpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Contains callAll and CallSchedule - calling a tag for a range of Polymorphic
+ * or PolymorphicPtr objects grouped by the called function.
+ *
+ * \details
+ * Calling a tag for objects of different types in arbitrary order makes
+ * indirect branch prediction almost useless. Both callAll and CallSchedule
+ * order calls by the target function, so calls to the same function go one
+ * after another.
+ */
+#pragma once
+
+#include "cxx_plugins/function_proxy.hpp"
+#include "cxx_plugins/vector.hpp"
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace plugins {
+
+namespace impl {
+/*!
+ * \brief
+ * Open addressing hash table that maps function pointers to the index of their
+ * run and counts calls in every run.
+ */
+template <typename FunctionT> class RunTable {
+public:
+  RunTable() : slots_m(initial_slot_count, empty) {}
+
+  //! \brief Returns index of the run of `fn_p`
+  auto add(FunctionT fn_p) -> std::size_t {
+    if (!functions_m.empty() && functions_m[last_m] == fn_p) {
+      ++counts_m[last_m];
+      return last_m;
+    }
+    auto slot = find(fn_p);
+    if (slots_m[slot] == empty) {
+      if ((functions_m.size() + 1) * 2 > slots_m.size()) {
+        rehash(slots_m.size() * 2);
+        slot = find(fn_p);
+      }
+      slots_m[slot] = functions_m.size();
+      functions_m.push_back(fn_p);
+      counts_m.push_back(0);
+    }
+    last_m = slots_m[slot];
+    ++counts_m[last_m];
+    return last_m;
+  }
+
+  //! \brief Returns offset of the first call of every run
+  [[nodiscard]] auto offsets() const -> Vector<std::size_t> {
+    Vector<std::size_t> result(counts_m.size());
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < counts_m.size(); ++i) {
+      result[i] = offset;
+      offset += counts_m[i];
+    }
+    return result;
+  }
+
+private:
+  static constexpr std::size_t initial_slot_count = 64;
+  static constexpr std::size_t empty = static_cast<std::size_t>(-1);
+
+  auto find(FunctionT fn_p) const noexcept -> std::size_t {
+    auto const mask = slots_m.size() - 1;
+    // functions are at least 16 bytes aligned on most platforms
+    auto slot = (reinterpret_cast<std::uintptr_t>(fn_p) >> 4U) & mask;
+    while (slots_m[slot] != empty && functions_m[slots_m[slot]] != fn_p) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void rehash(std::size_t slot_count) {
+    slots_m.assign(slot_count, empty);
+    for (std::size_t i = 0; i < functions_m.size(); ++i) {
+      slots_m[find(functions_m[i])] = i;
+    }
+  }
+
+  Vector<std::size_t> slots_m;
+  Vector<FunctionT> functions_m;
+  Vector<std::size_t> counts_m;
+  std::size_t last_m = 0;
+};
+
+template <typename TagT, typename Range>
+using CallAllFunctionT = std::decay_t<decltype(
+    std::declval<Range &>().begin()->functionTable()[TagT{}])>;
+} // namespace impl
+
+template <typename TagT, typename FunctionT> class CallSchedule;
+
+/*!
+ * \brief
+ * Cached order of calls of TagT for a range of objects.
+ * \details
+ * Stores target function and object pointer for every object grouped by
+ * target function(objects of the same type keep their relative order). Build
+ * it once with makeCallSchedule and call it as many times as you need while
+ * the objects stay alive and aren't reassigned.
+ */
+template <typename TagT, typename Return, typename ObjectPtrT,
+          typename... Args>
+class CallSchedule<TagT, Return (*)(ObjectPtrT, Args...)> {
+public:
+  using FunctionT = Return (*)(ObjectPtrT, Args...);
+
+  CallSchedule() = default;
+
+  //! \brief Collects calls for every non empty object of the range
+  template <typename Range> explicit CallSchedule(Range &&range) {
+    // Counting sort by the function: first pass finds the run of every call,
+    // second one places calls into their runs.
+    Vector<Entry> unordered;
+    Vector<std::size_t> run_indices;
+    impl::RunTable<FunctionT> runs;
+    for (auto &&obj : range) {
+      if (obj.isEmpty())
+        continue;
+      FunctionT fn_p = obj.functionTable()[TagT{}];
+      run_indices.push_back(runs.add(fn_p));
+      unordered.push_back(Entry{fn_p, obj.data()});
+    }
+
+    auto offsets = runs.offsets();
+    calls_m.resize(unordered.size());
+    for (std::size_t i = 0; i < unordered.size(); ++i) {
+      calls_m[offsets[run_indices[i]]++] = unordered[i];
+    }
+  }
+
+  /*!
+   * \brief Calls TagT for every object.
+   * \details Arguments are passed to every call, so they are never moved.
+   */
+  template <typename... Us> void operator()(Us &&... args) const {
+    for (auto const &call : calls_m) {
+      impl::invokeTrampoline(call.fn_p, call.obj_p, args...);
+    }
+  }
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t {
+    return calls_m.size();
+  }
+
+  //! \brief Returns number of runs of calls with the same function
+  [[nodiscard]] auto runCount() const noexcept -> std::size_t {
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < calls_m.size(); ++i) {
+      if (i == 0 || calls_m[i].fn_p != calls_m[i - 1].fn_p) {
+        ++result;
+      }
+    }
+    return result;
+  }
+
+private:
+  struct Entry {
+    FunctionT fn_p;
+    ObjectPtrT obj_p;
+  };
+
+  Vector<Entry> calls_m;
+};
+
+/*!
+ * \brief Creates CallSchedule of TagT for the range of Polymorphic or
+ * PolymorphicPtr objects.
+ */
+template <typename TagT, typename Range>
+auto makeCallSchedule(Range &&range)
+    -> CallSchedule<TagT, impl::CallAllFunctionT<TagT, Range>> {
+  return CallSchedule<TagT, impl::CallAllFunctionT<TagT, Range>>(
+      std::forward<Range>(range));
+}
+
+/*!
+ * \brief
+ * Calls TagT for every object of the range of Polymorphic or PolymorphicPtr
+ * objects, grouping calls by the target function.
+ * \details
+ * Grouping costs a pass over the range and a temporary buffer, so it pays off
+ * when the range is big and calls are not trivial.
+ * Order of calls between objects of different types is unspecified.
+ * If the range is called repeatedly prefer makeCallSchedule, so the ordering
+ * is computed only once.
+ */
+template <typename TagT, typename Range, typename... Args>
+void callAll(Range &&range, Args &&... args) {
+  makeCallSchedule<TagT>(std::forward<Range>(range))(args...);
+}
+
+} // namespace plugins
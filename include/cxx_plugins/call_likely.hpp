@@ -0,0 +1,178 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_likely.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains implementation of `callLikely` of Polymorphic and PolymorphicPtr -
+ * call with guarded devirtualization for the most likely types, and profiling
+ * of the types that reach every `callLikely`.
+ *
+ * \details
+ * `obj.callLikely<Tag, A, B>(args...)` compares type in the header of the
+ * function table of `obj` with `A` and `B` and on a hit calls
+ * `polymorphicExtend` of the type directly, so it can be inlined. Otherwise
+ * the function is called through the table as with `call`. Headers are copied
+ * into tables remapped by upcasting, so pointers converted from Polymorphic or
+ * other interfaces are recognized as well.
+ *
+ * If `CXX_PLUGINS_PROFILE_CALL_LIKELY` is non-zero every `callLikely` records
+ * types of objects it was called for, and writeHotTypes emits a header with
+ * the most frequent ones, so they can be passed to `callLikely` as TypeList:
+ * ```cpp
+ * #include "hot_types.hpp" // using update_hot_types = TypeList<A, B>;
+ * obj.callLikely<update, update_hot_types>(delta);
+ * ```
+ */
+#pragma once
+
+#include "cxx_plugins/type_index.hpp"
+#include "cxx_plugins/type_traits.hpp"
+#include "cxx_plugins/vtable.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <utility>
+
+#ifndef CXX_PLUGINS_PROFILE_CALL_LIKELY
+#define CXX_PLUGINS_PROFILE_CALL_LIKELY 0
+#endif
+
+namespace plugins {
+
+namespace impl {
+using TypeInfoPtrT = TypeInfo const *;
+
+/*!
+ * \brief
+ * Counts objects of every type that reached one `callLikely` site.
+ * \details
+ * Counting is lock free, sites register themselves in the global list on
+ * construction and remove themselves on destruction(profiles of a plugin are
+ * destroyed when it is unloaded). Only first `capacity` types are counted
+ * separately, they are matched by id and kept as interned infos, so types of
+ * unloaded plugins are still reported.
+ */
+class CallSiteProfile {
+public:
+  static constexpr std::size_t capacity = 32;
+
+  CallSiteProfile(TypeInfoPtrT tag_info, TypeInfoPtrT likely_info) noexcept;
+  CallSiteProfile(CallSiteProfile const &) = delete;
+  auto operator=(CallSiteProfile const &) -> CallSiteProfile & = delete;
+  ~CallSiteProfile();
+
+  void record(TypeInfoPtrT type_info) noexcept {
+    auto const id = type_info->id_m;
+    auto slot = static_cast<std::size_t>(id % capacity);
+    for (std::size_t i = 0; i < capacity; ++i) {
+      auto &entry = entries_m[(slot + i) % capacity];
+      auto current = entry.type_info.load(std::memory_order_acquire);
+      if (current == nullptr) {
+        // only the first call for a type gets here
+        auto const *interned_p = &internTypeInfo(*type_info);
+        if (entry.type_info.compare_exchange_strong(
+                current, interned_p, std::memory_order_acq_rel)) {
+          current = interned_p;
+        }
+      }
+      if (current->id_m == id) {
+        entry.count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    other_count_m.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  struct Entry {
+    //! \brief Interned info of the type
+    std::atomic<TypeInfoPtrT> type_info{nullptr};
+    std::atomic<std::uint64_t> count{0};
+  };
+
+  TypeInfoPtrT tag_info_m;
+  TypeInfoPtrT likely_info_m;
+  Entry entries_m[capacity];
+  std::atomic<std::uint64_t> other_count_m{0};
+  CallSiteProfile *next_m = nullptr;
+};
+
+template <typename TagT, typename... Ts>
+auto callSiteProfile() noexcept -> CallSiteProfile & {
+  static CallSiteProfile profile(&typeInfoConstruct<TagT>(),
+                                 &typeInfoConstruct<TypeList<Ts...>>());
+  return profile;
+}
+
+template <typename FunctionT> struct TrampolineSignature;
+template <typename Return, typename... Args>
+struct TrampolineSignature<Return (*)(void *, Args...)> {
+  using Type = Return(Args...);
+};
+template <typename Return, typename... Args>
+struct TrampolineSignature<Return (*)(void const *, Args...)> {
+  using Type = Return(Args...) const;
+};
+
+template <typename TagT, typename... Ts> struct CallLikely {
+  template <typename TableT, typename ObjectPtrT, typename... Args>
+  static decltype(auto) call(TableT const &table, ObjectPtrT obj_p,
+                             Args &&... args) {
+#if CXX_PLUGINS_PROFILE_CALL_LIKELY
+    callSiteProfile<TagT, Ts...>().record(table.header().type_info);
+#endif
+    return dispatch<Ts...>(table, obj_p, std::forward<Args>(args)...);
+  }
+
+private:
+  template <typename... Rest, typename TableT, typename ObjectPtrT,
+            typename... Args>
+  static decltype(auto) dispatch(TableT const &table, ObjectPtrT obj_p,
+                                 Args &&... args) {
+    if constexpr (sizeof...(Rest) == 0) {
+      return invokeTrampoline(table[TagT{}], obj_p,
+                              std::forward<Args>(args)...);
+    } else {
+      return dispatchFirst<Rest...>(table, obj_p, std::forward<Args>(args)...);
+    }
+  }
+
+  template <typename T, typename... Rest, typename TableT, typename ObjectPtrT,
+            typename... Args>
+  static decltype(auto) dispatchFirst(TableT const &table, ObjectPtrT obj_p,
+                                      Args &&... args) {
+    using SignatureT = typename TrampolineSignature<
+        typename TableT::template FunctionTypeAt<TagT>>::Type;
+    if (isHeaderOf<T>(table.header())) {
+      return invokeTrampoline(&PolymorphicTrampoline<TagT, T, SignatureT>::call,
+                              obj_p, std::forward<Args>(args)...);
+    }
+    return dispatch<Rest...>(table, obj_p, std::forward<Args>(args)...);
+  }
+};
+
+template <typename TagT, typename... Ts>
+struct CallLikely<TagT, TypeList<Ts...>> : CallLikely<TagT, Ts...> {};
+} // namespace impl
+
+/*!
+ * \brief
+ * Writes header with the most frequent types of every `callLikely` site that
+ * was called(requires `CXX_PLUGINS_PROFILE_CALL_LIKELY`).
+ * \details
+ * For every site header contains statistics in comments and
+ * `using <tag>_hot_types = plugins::TypeList<...>;` with up to `max_types`
+ * types, each of which got at least `min_share` of calls.
+ * Types from anonymous namespaces can't be named in the header, so they are
+ * listed in comments only.
+ */
+void writeHotTypes(std::ostream &out, std::size_t max_types = 3,
+                   double min_share = 0.05);
+
+} // namespace plugins
@@ -18,6 +18,61 @@
 #include <string_view>
 #include <exception>
 
+/*!
+ * \brief
+ * If non-zero, HybridStorage counts objects that didn't fit into its buffer,
+ * see plugins::fallbackAllocationCount.
+ * \details
+ * Enabled by default if `NDEBUG` macro is undefined. It only decides whether
+ * function tables built by this library point to counters, the layout of
+ * VTableHeader is the same, so debug plugins can be loaded by release
+ * applications and vice versa.
+ */
+#ifndef CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS
+#ifdef NDEBUG
+#define CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS 0
+#else
+#define CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS 1
+#endif
+#endif
+
+/*!
+ * \brief
+ * If non-zero, VTable, PrimitiveVTable and InlineVTable use function tables
+ * interned in `cxx_plugins` library, so tables of the same type from different
+ * plugins are equal.
+ * \details
+ * Disabled by default: a shared table points to functions of the library that
+ * used it first, so that library must not be unloaded while other libraries
+ * use the type. Types are compared by ids, which are the same in every library,
+ * in both modes.
+ */
+#ifndef CXX_PLUGINS_SHARED_VTABLES
+#define CXX_PLUGINS_SHARED_VTABLES 0
+#endif
+
+/*!
+ * \brief
+ * If non-zero, functions of VTable, PrimitiveVTable and InlineVTable count
+ * their calls per interface, tag and type, see plugins::collectCallStatistics.
+ * \details
+ * Set by `CXX_PLUGINS_INSTRUMENT` CMake option. Disabled by default.
+ */
+#ifndef CXX_PLUGINS_INSTRUMENT
+#define CXX_PLUGINS_INSTRUMENT 0
+#endif
+
+/*!
+ * \brief
+ * If non-zero(and `CXX_PLUGINS_INSTRUMENT` is enabled), instrumented calls
+ * also measure their duration with `std::chrono::steady_clock`.
+ * \details
+ * Set by `CXX_PLUGINS_INSTRUMENT_LATENCY` CMake option.
+ */
+#ifndef CXX_PLUGINS_INSTRUMENT_LATENCY
+#define CXX_PLUGINS_INSTRUMENT_LATENCY 0
+#endif
+
 /*!
  * \brief Assert function.
  * \details
@@ -0,0 +1,439 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    dynamic_call.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains lookup of tags by name and calls with type erased arguments.
+ *
+ * \details
+ * For callers that know the tag only at runtime(scripts, configs, console
+ * commands):
+ * ```cpp
+ * int delta = 4;
+ * ptr.callByName("add", {delta});         // plugins::DynamicArgument(delta)
+ * int result = 0;
+ * ptr.callByName("value", {}, result);    // result is assigned
+ * ```
+ * Names are mapped to tags with a perfect hash that is built at compile time,
+ * so a lookup is one hash of the name and one comparison.
+ */
+#pragma once
+
+#include "cxx_plugins/definitions.hpp"
+#include "cxx_plugins/function_cast.hpp"
+#include "cxx_plugins/function_proxy.hpp"
+#include "cxx_plugins/polymorphic_traits.hpp"
+#include "cxx_plugins/type_index.hpp"
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace plugins {
+
+namespace impl {
+/*!
+ * \brief
+ * Returns `name` without namespaces(of the name itself, not of its template
+ * arguments).
+ */
+constexpr auto unqualifiedTypeName(std::string_view name) noexcept
+    -> std::string_view {
+  std::size_t depth = 0;
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (name[i] == '<' || name[i] == '(') {
+      ++depth;
+    } else if (name[i] == '>' || name[i] == ')') {
+      --depth;
+    } else if (depth == 0 && name[i] == ':' && i + 1 < name.size() &&
+               name[i + 1] == ':') {
+      start = i + 2;
+    }
+  }
+  return name.substr(start);
+}
+} // namespace impl
+
+/*!
+ * \brief
+ * Name of the tag that is used by callByName, the name of the tag type without
+ * namespaces by default(`update` for `System::update`).
+ * \details
+ * Can be specialized, names of tags in one interface should be unique.
+ */
+template <typename TagT> struct TagName {
+  static constexpr std::string_view value =
+      impl::unqualifiedTypeName(impl::type_name_v<TagT>);
+};
+
+template <typename TagT> struct TagName<Tag<TagT>> : TagName<TagT> {};
+
+template <typename TagT>
+static constexpr std::string_view tag_name_v = TagName<TagT>::value;
+
+//! \brief Thrown if a call by name doesn't match any function of the interface
+class DynamicCallError : public std::invalid_argument {
+  using std::invalid_argument::invalid_argument;
+};
+
+/*!
+ * \brief Reference to an lvalue of any type for callByName.
+ * \details
+ * Parameters taken by value or by const reference are copied from(or bound
+ * to) the object, parameters taken by rvalue reference move from it.
+ */
+class DynamicArgument {
+public:
+  constexpr DynamicArgument() noexcept = default;
+
+  template <typename T, typename = std::enable_if_t<
+                            !std::is_same_v<std::remove_cv_t<T>, DynamicArgument>>>
+  constexpr DynamicArgument(T &obj) noexcept
+      : data_p_m{const_cast<void *>(
+            static_cast<void const *>(std::addressof(obj)))},
+        type_info_p_m{&impl::typeInfoConstruct<T>()}, is_const_m{
+                                                          std::is_const_v<T>} {}
+
+  [[nodiscard]] constexpr auto isEmpty() const noexcept -> bool {
+    return data_p_m == nullptr;
+  }
+  [[nodiscard]] constexpr auto isConst() const noexcept -> bool {
+    return is_const_m;
+  }
+  [[nodiscard]] auto typeIndex() const noexcept -> type_index {
+    return isEmpty() ? type_id<void>() : type_index(*type_info_p_m);
+  }
+  [[nodiscard]] constexpr auto data() const noexcept -> void * {
+    return data_p_m;
+  }
+
+private:
+  void *data_p_m = nullptr;
+  impl::TypeInfo const *type_info_p_m = nullptr;
+  bool is_const_m = false;
+};
+
+//! \brief Non-owning view of arguments for callByName
+class DynamicArguments {
+public:
+  constexpr DynamicArguments() noexcept = default;
+  constexpr DynamicArguments(DynamicArgument const *data_p,
+                             std::size_t size) noexcept
+      : data_p_m{data_p}, size_m{size} {}
+  constexpr DynamicArguments(
+      std::initializer_list<DynamicArgument> arguments) noexcept
+      : data_p_m{arguments.begin()}, size_m{arguments.size()} {}
+  //! \brief From contiguous containers(std::array, Vector, ...)
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible_v<
+                decltype(std::declval<Container const &>().data()),
+                DynamicArgument const *>>>
+  constexpr DynamicArguments(Container const &arguments) noexcept
+      : data_p_m{arguments.data()}, size_m{arguments.size()} {}
+
+  [[nodiscard]] constexpr auto size() const noexcept -> std::size_t {
+    return size_m;
+  }
+  constexpr auto operator[](std::size_t i) const noexcept
+      -> DynamicArgument const & {
+    return data_p_m[i];
+  }
+
+private:
+  DynamicArgument const *data_p_m = nullptr;
+  std::size_t size_m = 0;
+};
+
+namespace impl {
+//! \brief splitmix64 of the hash displaced by `displacement`
+constexpr auto mixHash(std::uint64_t hash, std::uint64_t displacement) noexcept
+    -> std::uint64_t {
+  hash += displacement * 0x9E3779B97F4A7C15ULL;
+  hash = (hash ^ (hash >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  hash = (hash ^ (hash >> 27U)) * 0x94D049BB133111EBULL;
+  return hash ^ (hash >> 31U);
+}
+
+constexpr auto ceilPowerOfTwo(std::size_t value) noexcept -> std::size_t {
+  std::size_t result = 1;
+  while (result < value) {
+    result *= 2;
+  }
+  return result;
+}
+
+/*!
+ * \brief
+ * Perfect hash from `Keys::keys`(`Keys::count` distinct 64-bit hashes) to
+ * their indices, built at compile time with "hash and displace": keys are
+ * split into buckets, then every bucket(largest first) gets the displacement
+ * that moves all of its keys to free slots.
+ * \details
+ * Other values are mapped to npos or to an arbitrary index, so users compare
+ * the key at the index.
+ */
+template <typename Keys> class PerfectHash {
+public:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  static constexpr auto find(std::uint64_t key) noexcept -> std::size_t {
+    if constexpr (count == 0) {
+      return npos;
+    } else {
+      auto const displacement = displacements[key % bucket_count];
+      return slots[mixHash(key, displacement) & (slot_count - 1)];
+    }
+  }
+
+private:
+  static constexpr std::size_t count = Keys::count;
+  static constexpr std::size_t capacity = count == 0 ? 1 : count;
+  static constexpr std::size_t bucket_count = (capacity + 1) / 2;
+  static constexpr std::size_t max_slot_count = 8 * ceilPowerOfTwo(capacity);
+  static constexpr std::uint64_t max_displacement = 1U << 16U;
+
+  static constexpr auto keyAt(std::size_t i) noexcept -> std::uint64_t {
+    return Keys::keys[i];
+  }
+
+  //! \returns false if some bucket can't be placed with `slot_count` slots
+  static constexpr auto build(std::size_t slot_count,
+                              std::uint64_t *displacements_p,
+                              std::size_t *slots_p) noexcept -> bool {
+    std::array<std::size_t, capacity> bucket_sizes = {};
+    std::size_t max_bucket_size = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+      auto &size = bucket_sizes[keyAt(i) % bucket_count];
+      ++size;
+      max_bucket_size = size > max_bucket_size ? size : max_bucket_size;
+    }
+    for (std::size_t slot = 0; slot < slot_count; ++slot) {
+      slots_p[slot] = npos;
+    }
+    for (auto size = max_bucket_size; size > 0; --size) {
+      for (std::size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        if (bucket_sizes[bucket] != size)
+          continue;
+        if (!placeBucket(bucket, slot_count, displacements_p, slots_p))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  static constexpr auto placeBucket(std::size_t bucket, std::size_t slot_count,
+                                    std::uint64_t *displacements_p,
+                                    std::size_t *slots_p) noexcept -> bool {
+    auto slotOf = [slot_count](std::size_t i, std::uint64_t displacement) {
+      return mixHash(keyAt(i), displacement) & (slot_count - 1);
+    };
+    for (std::uint64_t displacement = 0; displacement < max_displacement;
+         ++displacement) {
+      bool fits = true;
+      for (std::size_t i = 0; i < count && fits; ++i) {
+        if (keyAt(i) % bucket_count != bucket)
+          continue;
+        auto const slot = slotOf(i, displacement);
+        fits = slots_p[slot] == npos;
+        // keys of the same bucket shouldn't collide either
+        for (std::size_t j = 0; j < i && fits; ++j) {
+          fits = keyAt(j) % bucket_count != bucket ||
+                 slotOf(j, displacement) != slot;
+        }
+      }
+      if (!fits)
+        continue;
+      displacements_p[bucket] = displacement;
+      for (std::size_t i = 0; i < count; ++i) {
+        if (keyAt(i) % bucket_count == bucket) {
+          slots_p[slotOf(i, displacement)] = i;
+        }
+      }
+      return true;
+    }
+    return false;
+  }
+
+  static constexpr std::size_t slot_count = [] {
+    for (auto slot_count = ceilPowerOfTwo(capacity);
+         slot_count <= max_slot_count; slot_count *= 2) {
+      std::array<std::uint64_t, bucket_count> displacements = {};
+      std::array<std::size_t, max_slot_count> slots = {};
+      if (build(slot_count, displacements.data(), slots.data()))
+        return slot_count;
+    }
+    return std::size_t{0};
+  }();
+  static_assert(slot_count != 0, "Failed to build perfect hash");
+
+  static constexpr std::array<std::uint64_t, bucket_count> displacements = [] {
+    std::array<std::uint64_t, bucket_count> result = {};
+    std::array<std::size_t, slot_count> slots = {};
+    build(slot_count, result.data(), slots.data());
+    return result;
+  }();
+
+  static constexpr std::array<std::size_t, slot_count> slots = [] {
+    std::array<std::uint64_t, bucket_count> displacements = {};
+    std::array<std::size_t, slot_count> result = {};
+    build(slot_count, displacements.data(), result.data());
+    return result;
+  }();
+};
+
+//! \brief Perfect hash from names of `Tags` to their indices
+template <typename... Tags> class TagNameHash {
+public:
+  static constexpr std::size_t count = sizeof...(Tags);
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  //! \brief Returns index of the tag in `Tags...` or npos
+  static constexpr auto find(std::string_view name) noexcept -> std::size_t {
+    auto const index = PerfectHash<TagNameHash>::find(fnv1a(name));
+    return index != npos && names[index] == name ? index : npos;
+  }
+
+  static constexpr std::size_t capacity = count == 0 ? 1 : count;
+  static constexpr std::array<std::string_view, capacity> names = {
+      tag_name_v<Tags>...};
+  static constexpr std::array<std::uint64_t, capacity> keys = {
+      fnv1a(tag_name_v<Tags>)...};
+
+private:
+  static constexpr auto hasUniqueNames() noexcept -> bool {
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t j = i + 1; j < count; ++j) {
+        if (names[i] == names[j])
+          return false;
+      }
+    }
+    return true;
+  }
+  static_assert(hasUniqueNames(),
+                "Tags of the interface should have unique names, "
+                "specialize plugins::TagName for one of them");
+};
+
+template <typename Param>
+auto dynamicArgumentAs(DynamicArgument const &argument) noexcept
+    -> decltype(auto) {
+  using ValueT = std::remove_cv_t<std::remove_reference_t<Param>>;
+  auto *value_p = static_cast<ValueT *>(argument.data());
+  if constexpr (std::is_rvalue_reference_v<Param>) {
+    return std::move(*value_p);
+  } else if constexpr (std::is_lvalue_reference_v<Param> &&
+                       !std::is_const_v<std::remove_reference_t<Param>>) {
+    return *value_p;
+  } else {
+    return std::as_const(*value_p);
+  }
+}
+
+template <typename Param>
+auto isDynamicArgumentOf(DynamicArgument const &argument) noexcept -> bool {
+  using ValueT = std::remove_cv_t<std::remove_reference_t<Param>>;
+  constexpr bool needs_mutable =
+      std::is_rvalue_reference_v<Param> ||
+      (std::is_lvalue_reference_v<Param> &&
+       !std::is_const_v<std::remove_reference_t<Param>>);
+  return !argument.isEmpty() && argument.typeIndex() == type_id<ValueT>() &&
+         !(needs_mutable && argument.isConst());
+}
+
+[[noreturn]] inline void throwDynamicCallError(std::string_view tag_name,
+                                               std::string_view message) {
+  std::string what = "Dynamic call of `";
+  what.append(tag_name).append("`: ").append(message);
+  throw DynamicCallError(what);
+}
+
+/*!
+ * \brief
+ * Checks type erased arguments against `Signature` and calls the function of
+ * the table with them.
+ */
+template <typename Signature> struct DynamicInvoker;
+
+template <typename Return, typename... Args>
+struct DynamicInvoker<Return(Args...)> {
+  using FunctionT = Return (*)(void *, TrampolineArgT<Args>...);
+
+  static void invoke(FnPtr<void()> fn_p, void const *obj_p,
+                     bool is_const_object, std::string_view tag_name,
+                     DynamicArguments args, DynamicArgument result) {
+    if (is_const_object) {
+      throwDynamicCallError(tag_name, "function requires non-const object");
+    }
+    check(tag_name, args, result);
+    call(reinterpret_cast<FunctionT>(fn_p), const_cast<void *>(obj_p), args,
+         result, std::index_sequence_for<Args...>{});
+  }
+
+  static void check(std::string_view tag_name, DynamicArguments args,
+                    DynamicArgument result) {
+    if (args.size() != sizeof...(Args)) {
+      throwDynamicCallError(tag_name, "wrong number of arguments");
+    }
+    std::size_t i = 0;
+    if (!(isDynamicArgumentOf<Args>(args[i++]) && ...)) {
+      throwDynamicCallError(tag_name, "argument " + std::to_string(i - 1) +
+                                          " has wrong type or constness");
+    }
+    if constexpr (!std::is_void_v<Return>) {
+      if (!result.isEmpty() &&
+          !isDynamicArgumentOf<std::remove_cv_t<std::remove_reference_t<
+              Return>> &>(result)) {
+        throwDynamicCallError(tag_name, "result has wrong type");
+      }
+    }
+  }
+
+  template <typename ObjectPtrT, typename FunctionPtrT, std::size_t... I>
+  static void call(FunctionPtrT fn_p, ObjectPtrT obj_p, DynamicArguments args,
+                   DynamicArgument result,
+                   std::index_sequence<I...> /*unused*/) {
+    if constexpr (std::is_void_v<Return>) {
+      invokeTrampoline(fn_p, obj_p, dynamicArgumentAs<Args>(args[I])...);
+    } else if (result.isEmpty()) {
+      invokeTrampoline(fn_p, obj_p, dynamicArgumentAs<Args>(args[I])...);
+    } else {
+      using ResultT = std::remove_cv_t<std::remove_reference_t<Return>>;
+      *static_cast<ResultT *>(result.data()) =
+          invokeTrampoline(fn_p, obj_p, dynamicArgumentAs<Args>(args[I])...);
+    }
+  }
+};
+
+template <typename Return, typename... Args>
+struct DynamicInvoker<Return(Args...) const> {
+  using FunctionT = Return (*)(void const *, TrampolineArgT<Args>...);
+
+  static void invoke(FnPtr<void()> fn_p, void const *obj_p,
+                     bool /*is_const_object*/, std::string_view tag_name,
+                     DynamicArguments args, DynamicArgument result) {
+    using BaseT = DynamicInvoker<Return(Args...)>;
+    BaseT::check(tag_name, args, result);
+    BaseT::call(reinterpret_cast<FunctionT>(fn_p), obj_p, args, result,
+                std::index_sequence_for<Args...>{});
+  }
+};
+
+using DynamicInvokerT = void (*)(FnPtr<void()>, void const *, bool,
+                                 std::string_view, DynamicArguments,
+                                 DynamicArgument);
+} // namespace impl
+
+} // namespace plugins
@@ -9,13 +9,92 @@
  * \author  Andrey Ponomarev
  * \date    18 Jun 2020
  * \brief
- * $BRIEF$
+ * Contains FunctionProxy and the calling convention of trampolines.
+ *
+ * \details
+ * Trampolines take parameters that are expensive to copy by rvalue reference
+ * (see TrampolineArgT), so an argument passed by value is constructed only
+ * once: by the caller of `call`(or FunctionProxy) or by the parameter of
+ * `polymorphicExtend`, which moves it from the reference.
  */
 #pragma once
 
+#include <type_traits>
 #include <utility>
 
 namespace plugins {
+namespace impl {
+/*!
+ * \brief
+ * Type that is used by trampolines to pass parameter of type `Arg`.
+ * \details
+ * References and small trivially copyable types are passed as is(in
+ * registers), everything else is passed by rvalue reference.
+ */
+template <typename Arg, typename = void> struct TrampolineArg {
+  using Type = Arg &&;
+};
+template <typename Arg>
+struct TrampolineArg<Arg, std::enable_if_t<std::is_reference_v<Arg>>> {
+  using Type = Arg;
+};
+template <typename Arg>
+struct TrampolineArg<Arg, std::enable_if_t<!std::is_reference_v<Arg> &&
+                                           std::is_trivially_copyable_v<Arg> &&
+                                           sizeof(Arg) <= 2 * sizeof(void *)>> {
+  using Type = Arg;
+};
+template <typename Arg>
+using TrampolineArgT = typename TrampolineArg<Arg>::Type;
+
+//! \brief Copy initializes `T` from the argument(only implicit conversions)
+template <typename T, typename U> constexpr auto implicitCopy(U &&arg) -> T {
+  return std::forward<U>(arg);
+}
+
+/*!
+ * \brief
+ * Converts argument to the parameter type of trampoline.
+ * \details
+ * If parameter is an rvalue reference and argument can't be bound to it(it
+ * is an lvalue or of another type) a temporary is created, it lives until the
+ * end of the call.
+ */
+template <typename ParamT, typename U>
+constexpr decltype(auto) passArgument(U &&arg) {
+  using ValueT = std::remove_reference_t<ParamT>;
+  using SourceT = std::remove_reference_t<U>;
+  constexpr bool can_bind =
+      !std::is_lvalue_reference_v<U> && !std::is_const_v<SourceT> &&
+      (std::is_same_v<ValueT, SourceT> || std::is_base_of_v<ValueT, SourceT>);
+  if constexpr (std::is_rvalue_reference_v<ParamT> && !can_bind) {
+    return implicitCopy<ValueT>(std::forward<U>(arg));
+  } else {
+    return std::forward<U>(arg);
+  }
+}
+
+/*!
+ * \brief Calls trampoline, converting arguments with passArgument.
+ */
+template <typename Return, typename ObjectPtrT, typename... Params,
+          typename ArgObjectPtrT, typename... Us>
+constexpr auto invokeTrampoline(Return (*fn_p)(ObjectPtrT, Params...),
+                                ArgObjectPtrT obj_p, Us &&... args) -> Return {
+  return fn_p(obj_p, passArgument<Params>(std::forward<Us>(args))...);
+}
+} // namespace impl
+
+/*!
+ * \brief
+ * Binds function of a table to an object.
+ * \details
+ * Signature is the one of the trampoline(see TrampolineArgT), arguments are
+ * forwarded to it without intermediate copies. Non-template overload takes
+ * parameters of the trampoline, so braced initializers can be passed as
+ * before(`proxy(obj, {1, 2})`). Braced initializer and lvalue can't be mixed
+ * if the lvalue is passed by rvalue reference(it should be copied explicitly).
+ */
 template <typename Signature> struct FunctionProxy;
 
 template <typename Return, typename... Args>
@@ -28,6 +107,11 @@ public:
     return fn_p_m(obj_p_m, std::forward<Args>(args)...);
   }
 
+  template <typename... Us>
+  constexpr auto operator()(Us &&... args) const -> Return {
+    return impl::invokeTrampoline(fn_p_m, obj_p_m, std::forward<Us>(args)...);
+  }
+
 private:
   Return (*fn_p_m)(void *, Args...) = nullptr;
   void *obj_p_m = nullptr;
@@ -44,6 +128,11 @@ public:
     return fn_p_m(obj_p_m, std::forward<Args>(args)...);
   }
 
+  template <typename... Us>
+  constexpr auto operator()(Us &&... args) const -> Return {
+    return impl::invokeTrampoline(fn_p_m, obj_p_m, std::forward<Us>(args)...);
+  }
+
 private:
   Return (*fn_p_m)(void const *, Args...) = nullptr;
   void const *obj_p_m = nullptr;
@@ -0,0 +1,181 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    instrumentation.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains counters of calls through function tables per interface, tag and
+ * type of the object.
+ *
+ * \details
+ * If `CXX_PLUGINS_INSTRUMENT` is non-zero every function of VTableStorage
+ * (and InlineVTable) counts its calls, and with
+ * `CXX_PLUGINS_INSTRUMENT_LATENCY` it also measures their duration.
+ * Every thread counts in its own counters, collectCallStatistics merges them:
+ * ```cpp
+ * plugins::writeCallStatistics(std::cout); // the most called tags first
+ * ```
+ * If instrumentation is disabled tables contain the trampolines themselves,
+ * so calls cost nothing extra.
+ */
+#pragma once
+
+#include "cxx_plugins/definitions.hpp"
+#include "cxx_plugins/type_index.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace plugins {
+
+//! \brief Number of latency buckets, bucket `i` counts calls of `[2^i, 2^(i+1))` ns
+static constexpr std::size_t call_latency_bucket_count = 32;
+
+//! \brief Calls of one tag for objects of one type through one interface
+struct CallStatistics {
+  type_index interface;
+  type_index tag;
+  type_index type;
+  std::uint64_t count = 0;
+  //! \brief Empty unless `CXX_PLUGINS_INSTRUMENT_LATENCY` is enabled
+  std::array<std::uint64_t, call_latency_bucket_count> latency = {};
+};
+
+namespace impl {
+/*!
+ * \brief Counters of one call site, written only by the owning thread.
+ * \details
+ * Counters are atomic only so other threads can read them while merging,
+ * so increments are plain loads and stores.
+ */
+struct CallCounter {
+  std::atomic<std::uint64_t> count{0};
+  std::atomic<std::uint64_t> latency[call_latency_bucket_count] = {};
+};
+
+inline void increment(std::atomic<std::uint64_t> &counter) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+/*!
+ * \brief
+ * Counters of every call site for one thread.
+ * \details
+ * Counters are allocated in chunks that never move, so they can be read by
+ * collectCallStatistics while the thread keeps counting.
+ */
+class ThreadCallCounters {
+public:
+  static constexpr std::size_t chunk_size = 256;
+  static constexpr std::size_t max_chunks = 1024;
+
+  auto counter(std::uint32_t site_id) noexcept -> CallCounter & {
+    auto *chunk_p = chunks_m[site_id / chunk_size].load(std::memory_order_relaxed);
+    if (chunk_p == nullptr) {
+      chunk_p = allocateChunk(site_id / chunk_size);
+    }
+    return chunk_p->counters[site_id % chunk_size];
+  }
+
+  struct Chunk {
+    CallCounter counters[chunk_size];
+  };
+
+  std::atomic<Chunk *> chunks_m[max_chunks] = {};
+
+private:
+  auto allocateChunk(std::size_t index) noexcept -> Chunk *;
+};
+
+/*!
+ * \brief
+ * Returns id of the call site for the tag of interface and type.
+ * \details
+ * Called once per instantiation of InstrumentedTrampoline. Infos are
+ * interned, so statistics of unloaded plugins can still be written.
+ */
+auto registerCallSite(TypeInfo const &interface, TypeInfo const &tag,
+                      TypeInfo const &type) noexcept -> std::uint32_t;
+
+/*!
+ * \brief Returns counters of the current thread, creating them on first use.
+ * \details
+ * Counters of finished threads are reused by new threads, so they are never
+ * lost.
+ */
+auto acquireThreadCallCounters() noexcept -> ThreadCallCounters &;
+
+inline thread_local ThreadCallCounters *thread_call_counters_p = nullptr;
+
+inline auto callCounter(std::uint32_t site_id) noexcept -> CallCounter & {
+  if (thread_call_counters_p == nullptr) {
+    thread_call_counters_p = &acquireThreadCallCounters();
+  }
+  return thread_call_counters_p->counter(site_id);
+}
+
+//! \brief Adds duration of the call to the histogram on destruction
+class CallTimer {
+public:
+  explicit CallTimer(CallCounter &counter) noexcept
+      : counter_m(counter), start_m(std::chrono::steady_clock::now()) {}
+  CallTimer(CallTimer const &) = delete;
+  CallTimer &operator=(CallTimer const &) = delete;
+
+  ~CallTimer() {
+    auto nanoseconds = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_m)
+            .count());
+    std::size_t bucket = 0;
+    while (nanoseconds > 1 && bucket + 1 < call_latency_bucket_count) {
+      nanoseconds >>= 1U;
+      ++bucket;
+    }
+    increment(counter_m.latency[bucket]);
+  }
+
+private:
+  CallCounter &counter_m;
+  std::chrono::steady_clock::time_point start_m;
+};
+} // namespace impl
+
+/*!
+ * \brief
+ * Returns statistics of every called site(requires `CXX_PLUGINS_INSTRUMENT`)
+ * merged from all threads, sorted by number of calls.
+ * \details
+ * Counts of running threads may be slightly behind. Returns std::vector,
+ * because this header is included by vtable.hpp(and PolymorphicAllocator
+ * depends on it).
+ */
+auto collectCallStatistics() -> std::vector<CallStatistics>;
+
+/*!
+ * \brief Writes statistics from collectCallStatistics as a table.
+ */
+void writeCallStatistics(std::ostream &out);
+
+/*!
+ * \brief
+ * Writes header with VTableSlotPriority specializations for called tags:
+ * the more calls a tag has(through every interface), the higher its priority.
+ * \details
+ * Including the header(before tables are used) in the next build places hot
+ * functions first in function tables. Tags without a unique name(from
+ * anonymous namespaces) are skipped.
+ */
+void writeSlotPriorities(std::ostream &out);
+
+} // namespace plugins
@@ -0,0 +1,235 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    intrusive_polymorphic_ptr.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains IntrusivePolymorphicPtr - PolymorphicPtr of the size of one
+ * pointer for objects that keep their function table in front of them.
+ *
+ * \details
+ * Objects are created with `make` and are preceded by one word - the function
+ * table of the interface for their type:
+ * ```
+ * | padding | function table | object |
+ *                            ^ IntrusivePolymorphicPtr points here
+ * ```
+ * So arrays of these pointers take as much memory as arrays of raw pointers,
+ * but every call loads the function table from the object first:
+ * ```cpp
+ * auto ptr = IntrusivePolymorphicPtr<Tag<update>>::make<Node>(allocator);
+ * ptr.call<update>(dt);
+ * PolymorphicPtr<Tag<update>> fat = ptr;
+ * ptr.destroy(allocator);
+ * ```
+ */
+#pragma once
+
+#include "cxx_plugins/polymorphic_allocator.hpp"
+#include "cxx_plugins/polymorphic_ptr.hpp"
+#include "cxx_plugins/polymorphic_storage.hpp"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace plugins {
+
+template <typename... Ts>
+using IntrusivePolymorphicPtr = std::conditional_t<
+    (is_tagged_signature<Ts> && ...), impl::IntrusivePolymorphicPtr<Ts...>,
+    impl::IntrusivePolymorphicPtr<
+        TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+
+namespace impl {
+//! \brief Word that is placed right before objects of IntrusivePolymorphicPtr
+template <typename FunctionTableT> struct IntrusiveBlockHeader {
+  FunctionTableT function_table;
+};
+
+/*!
+ * \brief
+ * Pointer to polymorphic object that is created by `make`, function table is
+ * stored in front of the object instead of inside of the pointer.
+ * \details
+ * Doesn't own the object, as PolymorphicPtr. It is converted to
+ * PolymorphicPtr with the same interface(one load), which can be upcasted as
+ * usual.
+ */
+#ifdef DOXYGEN
+template <typename... TaggedSignatures>
+class IntrusivePolymorphicPtr
+#else
+template <typename... Tags, typename... Signatures>
+class IntrusivePolymorphicPtr<TaggedSignature<Tags, Signatures>...>
+#endif
+{
+public:
+  using PolymorphicPtrT =
+      impl::PolymorphicPtr<TaggedSignature<Tags, Signatures>...>;
+  using PointerT = typename PolymorphicPtrT::PointerT;
+  using FunctionTableT = typename PolymorphicPtrT::FunctionTableT;
+
+  constexpr IntrusivePolymorphicPtr() noexcept = default;
+
+  /*!
+   * \brief
+   * Creates object of type `T` from `args` with the function table in front
+   * of it.
+   * \details
+   * Memory is taken from `allocator` and the object is constructed with it
+   * (uses-allocator construction). The same allocator should be passed to
+   * destroy.
+   */
+  template <typename T, typename... Args>
+  [[nodiscard]] static auto make(PolymorphicAllocator<std::byte> allocator,
+                                 Args &&... args) -> IntrusivePolymorphicPtr {
+    static_assert(std::is_object_v<T> && !std::is_array_v<T>,
+                  "Only objects can be created");
+    auto const alignment = heapBlockAlignment<BlockHeaderT>(alignof(T));
+    auto const offset = heapBlockOffset<BlockHeaderT>(alignof(T));
+    auto *block_p = static_cast<std::byte *>(
+        allocator.allocate_bytes(offset + sizeof(T), alignment));
+    auto *obj_p = reinterpret_cast<T *>(block_p + offset);
+#ifdef __cpp_exceptions
+    try {
+      allocator.construct(obj_p, std::forward<Args>(args)...);
+    } catch (...) {
+      allocator.deallocate_bytes(block_p, offset + sizeof(T), alignment);
+      throw;
+    }
+#else
+    allocator.construct(obj_p, std::forward<Args>(args)...);
+#endif
+    new (block_p + offset - sizeof(BlockHeaderT))
+        BlockHeaderT{FunctionTableT{std::in_place_type_t<T>{}}};
+    return IntrusivePolymorphicPtr(obj_p);
+  }
+
+  /*!
+   * \brief
+   * Destroys the object and frees its memory, `allocator` should be equal to
+   * the one passed to make. Pointer becomes empty(copies of it dangle).
+   */
+  void destroy(PolymorphicAllocator<std::byte> allocator) noexcept {
+    if (isEmpty())
+      return;
+    auto const &header = functionTable().header();
+    auto *obj_p = mutableData();
+    if (header.destroy != nullptr) {
+      header.destroy(obj_p);
+    }
+    auto const alignment = heapBlockAlignment<BlockHeaderT>(header.alignment);
+    auto const offset = heapBlockOffset<BlockHeaderT>(header.alignment);
+    allocator.deallocate_bytes(static_cast<std::byte *>(obj_p) - offset,
+                               offset + header.size, alignment);
+    data_p_m = nullptr;
+  }
+
+  //! \brief Returns PolymorphicPtr with the same interface and object
+  [[nodiscard]] auto toPolymorphicPtr() const noexcept -> PolymorphicPtrT {
+    return isEmpty() ? PolymorphicPtrT{}
+                     : PolymorphicPtrT{data_p_m, functionTable()};
+  }
+  operator PolymorphicPtrT() const noexcept { return toPolymorphicPtr(); }
+
+  //! \brief Returns proxy object to call function
+  template <typename TagT> auto operator[](TagT &&t) noexcept {
+    return FunctionProxy(functionTable()[std::forward<TagT>(t)], data_p_m);
+  }
+
+  template <typename TagT> auto operator[](TagT &&t) const noexcept {
+    return FunctionProxy(functionTable()[std::forward<TagT>(t)],
+                         const_cast<void const *>(data_p_m));
+  }
+
+  template <typename TagT, typename... Us>
+  //! \brief Calls function with given parameters
+  decltype(auto) call(Us &&... parameters) {
+    return impl::invokeTrampoline(functionTable()[TagT{}], data_p_m,
+                                  std::forward<Us>(parameters)...);
+  }
+
+  template <typename TagT, typename... Us>
+  decltype(auto) call(Us &&... parameters) const {
+    return impl::invokeTrampoline(functionTable()[TagT{}],
+                                  const_cast<void const *>(data_p_m),
+                                  std::forward<Us>(parameters)...);
+  }
+
+  //! \brief Same as PolymorphicPtr::callLikely
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) {
+    return impl::CallLikely<TagT, Likely...>::call(
+        functionTable(), data_p_m, std::forward<Us>(parameters)...);
+  }
+
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) const {
+    return impl::CallLikely<TagT, Likely...>::call(
+        functionTable(), const_cast<void const *>(data_p_m),
+        std::forward<Us>(parameters)...);
+  }
+
+  [[nodiscard]] auto data() noexcept -> PointerT { return data_p_m; }
+  [[nodiscard]] constexpr auto data() const noexcept -> void const * {
+    return data_p_m;
+  }
+
+  /*!
+   * \brief Returns function table that is stored in front of the object.
+   * \details The pointer shouldn't be empty.
+   */
+  [[nodiscard]] auto functionTable() const noexcept -> FunctionTableT const & {
+    cxxPluginsAssert(!isEmpty(),
+                     "Trying to get function table of empty pointer");
+    return heapBlockHeader<BlockHeaderT>(mutableData()).function_table;
+  }
+
+  [[nodiscard]] constexpr auto isEmpty() const noexcept -> bool {
+    return data_p_m == nullptr;
+  }
+  //! \brief Makes pointer empty, the object isn't destroyed
+  void reset() noexcept { data_p_m = nullptr; }
+
+  template <typename T> auto isA() const noexcept -> bool {
+    return type_id<T>() == typeIndex();
+  }
+
+  //! \brief Returns type_index of the object(`void` if pointer is empty)
+  auto typeIndex() const noexcept -> type_index {
+    return isEmpty() ? type_id<void>() : functionTable().typeIndex();
+  }
+
+  friend constexpr auto operator==(IntrusivePolymorphicPtr lhs,
+                                   IntrusivePolymorphicPtr rhs) noexcept
+      -> bool {
+    return lhs.data_p_m == rhs.data_p_m;
+  }
+  friend constexpr auto operator!=(IntrusivePolymorphicPtr lhs,
+                                   IntrusivePolymorphicPtr rhs) noexcept
+      -> bool {
+    return !(lhs == rhs);
+  }
+
+private:
+  using BlockHeaderT = IntrusiveBlockHeader<FunctionTableT>;
+
+  constexpr explicit IntrusivePolymorphicPtr(PointerT data_p) noexcept
+      : data_p_m{data_p} {}
+
+  [[nodiscard]] auto mutableData() const noexcept -> void * {
+    return const_cast<void *>(static_cast<void const *>(data_p_m));
+  }
+
+  PointerT data_p_m = nullptr;
+};
+} // namespace impl
+
+} // namespace plugins
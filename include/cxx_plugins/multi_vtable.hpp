@@ -0,0 +1,300 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    multi_vtable.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains MultiVTable - dispatch of binary operations on the dynamic types
+ * of two Polymorphic or PolymorphicPtr objects.
+ *
+ * \details
+ * Instead of checking `rhs.isA<T>()` for every expected type inside of
+ * `polymorphicExtend`, functions for pairs of types are registered in a 2-D
+ * table: a call finds indices of both types and makes one indirect call.
+ */
+#pragma once
+
+#include "cxx_plugins/definitions.hpp"
+#include "cxx_plugins/function_proxy.hpp"
+#include "cxx_plugins/type_index.hpp"
+#include "cxx_plugins/type_traits.hpp"
+#include "cxx_plugins/vector.hpp"
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace plugins {
+
+namespace impl {
+template <typename Tag, typename T1, typename T2, typename Signature>
+struct MultiTrampoline;
+
+template <typename Tag, typename T1, typename T2, typename Return,
+          typename... Args>
+struct MultiTrampoline<Tag, T1, T2, Return(Args...)> {
+  static Return call(void *lhs_p, void *rhs_p, TrampolineArgT<Args>... args) {
+    return polymorphicExtend(Tag{}, *static_cast<T1 *>(lhs_p),
+                             *static_cast<T2 *>(rhs_p),
+                             std::forward<TrampolineArgT<Args>>(args)...);
+  }
+  //! \brief Calls function of (T2, T1) pair with swapped objects
+  static Return callSwapped(void *lhs_p, void *rhs_p,
+                            TrampolineArgT<Args>... args) {
+    return polymorphicExtend(Tag{}, *static_cast<T2 *>(rhs_p),
+                             *static_cast<T1 *>(lhs_p),
+                             std::forward<TrampolineArgT<Args>>(args)...);
+  }
+};
+
+template <typename Tag, typename T1, typename T2, typename Return,
+          typename... Args>
+struct MultiTrampoline<Tag, T1, T2, Return(Args...) const> {
+  static Return call(void const *lhs_p, void const *rhs_p,
+                     TrampolineArgT<Args>... args) {
+    return polymorphicExtend(Tag{}, *static_cast<T1 const *>(lhs_p),
+                             *static_cast<T2 const *>(rhs_p),
+                             std::forward<TrampolineArgT<Args>>(args)...);
+  }
+  static Return callSwapped(void const *lhs_p, void const *rhs_p,
+                            TrampolineArgT<Args>... args) {
+    return polymorphicExtend(Tag{}, *static_cast<T2 const *>(rhs_p),
+                             *static_cast<T1 const *>(lhs_p),
+                             std::forward<TrampolineArgT<Args>>(args)...);
+  }
+};
+
+template <typename Tag, typename T1, typename T2, typename Signature,
+          typename = void>
+struct IsMultiExtended : std::false_type {};
+
+template <typename Tag, typename T1, typename T2, typename Return,
+          typename... Args>
+struct IsMultiExtended<
+    Tag, T1, T2, Return(Args...),
+    std::void_t<decltype(polymorphicExtend(
+        Tag{}, std::declval<T1 &>(), std::declval<T2 &>(),
+        std::declval<Args>()...))>> : std::true_type {};
+
+template <typename Tag, typename T1, typename T2, typename Return,
+          typename... Args>
+struct IsMultiExtended<
+    Tag, T1, T2, Return(Args...) const,
+    std::void_t<decltype(polymorphicExtend(
+        Tag{}, std::declval<T1 const &>(), std::declval<T2 const &>(),
+        std::declval<Args>()...))>> : std::true_type {};
+
+template <typename Tag, typename Signature> struct MultiFunction;
+template <typename Tag, typename Return, typename... Args>
+struct MultiFunction<Tag, Return(Args...)> {
+  using Type = Return (*)(void *, void *, TrampolineArgT<Args>...);
+  using ObjectPtrT = void *;
+};
+template <typename Tag, typename Return, typename... Args>
+struct MultiFunction<Tag, Return(Args...) const> {
+  using Type = Return (*)(void const *, void const *, TrampolineArgT<Args>...);
+  using ObjectPtrT = void const *;
+};
+} // namespace impl
+
+/*!
+ * \brief
+ * Table of functions for pairs of types that is indexed by the dynamic types
+ * of two polymorphic objects.
+ * \details
+ * Function for the pair (T1, T2) calls
+ * `polymorphicExtend(Tag{}, T1 &lhs, T2 &rhs, args...)`(objects are const if
+ * the signature is const). Every registered type gets a dense index and
+ * functions are kept in a `size x size` table, so a call costs two lookups of
+ * the type index(open addressing by type id) and an indirect call.
+ * ```cpp
+ * MultiVTable<collide, void(Contact &)> collisions(
+ *     TypeList<Circle, Box, Plane>{});
+ * collisions(lhs, rhs, contact); // lhs and rhs are Polymorphic objects
+ * ```
+ * Type ids are the same in every library, so objects created by plugins are
+ * found as well.
+ * Registration isn't thread safe, calls are.
+ */
+template <typename Tag, typename Signature> class MultiVTable {
+public:
+  using FunctionT = typename impl::MultiFunction<Tag, Signature>::Type;
+
+  MultiVTable() : slots_m(initial_slot_count) {}
+
+  /*!
+   * \brief
+   * Registers every pair (T1, T2) of types from the list for which
+   * `polymorphicExtend` exists.
+   */
+  template <typename... Ts>
+  explicit MultiVTable(TypeList<Ts...> /*unused*/) : MultiVTable() {
+    (addAll<Ts, Ts...>(), ...);
+  }
+
+  //! \brief Registers function for objects of types T1(lhs) and T2(rhs)
+  template <typename T1, typename T2> void add() {
+    using TrampolineT = impl::MultiTrampoline<Tag, T1, T2, Signature>;
+    set(impl::typeInfoConstruct<T1>(), impl::typeInfoConstruct<T2>(),
+        &TrampolineT::call);
+  }
+
+  /*!
+   * \brief
+   * Registers function for (T1, T2) and uses it for (T2, T1) as well, with
+   * swapped objects.
+   */
+  template <typename T1, typename T2> void addSymmetric() {
+    add<T1, T2>();
+    using SwappedT = impl::MultiTrampoline<Tag, T2, T1, Signature>;
+    set(impl::typeInfoConstruct<T2>(), impl::typeInfoConstruct<T1>(),
+        &SwappedT::callSwapped);
+  }
+
+  //! \brief Returns function for types of objects or nullptr
+  template <typename Lhs, typename Rhs>
+  [[nodiscard]] auto find(Lhs const &lhs, Rhs const &rhs) const noexcept
+      -> FunctionT {
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+      return nullptr;
+    }
+    auto lhs_index = indexOf(*lhs.functionTable().header().type_info);
+    auto rhs_index = indexOf(*rhs.functionTable().header().type_info);
+    if (lhs_index == empty || rhs_index == empty) {
+      return nullptr;
+    }
+    return functions_m[lhs_index * types_m.size() + rhs_index];
+  }
+
+  template <typename Lhs, typename Rhs>
+  [[nodiscard]] auto contains(Lhs const &lhs, Rhs const &rhs) const noexcept
+      -> bool {
+    return find(lhs, rhs) != nullptr;
+  }
+
+  /*!
+   * \brief Calls function for the dynamic types of `lhs` and `rhs`.
+   * \details Function should be registered.
+   */
+  template <typename Lhs, typename Rhs, typename... Us>
+  decltype(auto) operator()(Lhs &&lhs, Rhs &&rhs, Us &&... args) const {
+    auto fn_p = find(lhs, rhs);
+    cxxPluginsAssert(fn_p != nullptr,
+                     "MultiVTable: function for types is not registered");
+    return invoke(fn_p, objectPointer(lhs), objectPointer(rhs),
+                  std::forward<Us>(args)...);
+  }
+
+  //! \brief Returns number of registered types
+  [[nodiscard]] auto typeCount() const noexcept -> std::size_t {
+    return types_m.size();
+  }
+
+private:
+  using ObjectPtrT = typename impl::MultiFunction<Tag, Signature>::ObjectPtrT;
+
+  static constexpr std::size_t initial_slot_count = 16;
+  static constexpr std::size_t empty = static_cast<std::size_t>(-1);
+
+  struct Slot {
+    std::uint64_t id = 0;
+    std::size_t index = empty;
+  };
+
+  template <typename T1, typename... Ts> void addAll() {
+    (addIfExtended<T1, Ts>(), ...);
+  }
+
+  template <typename T1, typename T2> void addIfExtended() {
+    if constexpr (impl::IsMultiExtended<Tag, T1, T2, Signature>::value) {
+      add<T1, T2>();
+    }
+  }
+
+  template <typename Object>
+  static auto objectPointer(Object &&obj) noexcept -> ObjectPtrT {
+    if constexpr (std::is_const_v<std::remove_pointer_t<ObjectPtrT>>) {
+      return std::as_const(obj).data();
+    } else {
+      return obj.data();
+    }
+  }
+
+  template <typename Return, typename... Params, typename... Us>
+  static auto invoke(Return (*fn_p)(ObjectPtrT, ObjectPtrT, Params...),
+                     ObjectPtrT lhs_p, ObjectPtrT rhs_p, Us &&... args)
+      -> Return {
+    return fn_p(lhs_p, rhs_p,
+                impl::passArgument<Params>(std::forward<Us>(args))...);
+  }
+
+  auto findSlot(std::uint64_t id) const noexcept -> std::size_t {
+    auto const mask = slots_m.size() - 1;
+    auto slot = static_cast<std::size_t>(id) & mask;
+    while (slots_m[slot].index != empty && slots_m[slot].id != id) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  //! \brief Returns index of the type or `empty`
+  auto indexOf(impl::TypeInfo const &info) const noexcept -> std::size_t {
+    return slots_m[findSlot(info.id_m)].index;
+  }
+
+  //! \brief Returns index of the type, registering it if needed
+  auto addType(impl::TypeInfo const &info) -> std::size_t {
+    auto index = indexOf(info);
+    if (index == empty) {
+      if ((types_m.size() + 1) * 2 > slots_m.size()) {
+        rehash(slots_m.size() * 2);
+      }
+      index = types_m.size();
+      auto const old_size = types_m.size();
+      Vector<FunctionT> functions((old_size + 1) * (old_size + 1), nullptr);
+      for (std::size_t row = 0; row < old_size; ++row) {
+        for (std::size_t column = 0; column < old_size; ++column) {
+          functions[row * (old_size + 1) + column] =
+              functions_m[row * old_size + column];
+        }
+      }
+      functions_m = std::move(functions);
+      types_m.push_back(info.id_m);
+      slots_m[findSlot(info.id_m)] = Slot{info.id_m, index};
+    }
+    return index;
+  }
+
+  void rehash(std::size_t slot_count) {
+    Vector<Slot> old_slots(slot_count, Slot{});
+    std::swap(old_slots, slots_m);
+    for (auto const &slot : old_slots) {
+      if (slot.index != empty) {
+        slots_m[findSlot(slot.id)] = slot;
+      }
+    }
+  }
+
+  void set(impl::TypeInfo const &lhs, impl::TypeInfo const &rhs,
+           FunctionT fn_p) {
+    auto const lhs_index = addType(lhs);
+    auto const rhs_index = addType(rhs);
+    functions_m[lhs_index * types_m.size() + rhs_index] = fn_p;
+  }
+
+  Vector<Slot> slots_m;
+  /*!
+   * \brief Ids of registered types, index of the type is its position.
+   * \details Infos aren't kept: libraries of the types can be unloaded.
+   */
+  Vector<std::uint64_t> types_m;
+  //! \brief Functions for (lhs, rhs) pairs: `[lhs * types_m.size() + rhs]`
+  Vector<FunctionT> functions_m;
+};
+
+} // namespace plugins
@@ -24,6 +24,7 @@
 
 #include <boost/type_index.hpp>
 
+#include <algorithm>
 #include <array>
 #include <filesystem>
 #include <map>
@@ -34,16 +35,92 @@
 
 namespace plugins {
 
+//! \brief Name of the member in JSON, name of the type by default
 template <typename T> struct JsonName {
-  static inline char const * const value = type_id<T>().name();
+  static constexpr char const *value = impl::typeInfoConstruct<T>().type_m;
 };
 template<typename T>
-inline auto getJsonName()->char const* {
+constexpr auto getJsonName()->char const* {
   return JsonName<T>::value;
 }
 
+namespace impl {
+/*!
+ * \brief
+ * Null terminated string in inline storage(truncated to `capacity`), so
+ * error messages are formatted without allocations.
+ */
+template <std::size_t capacity> class InlineMessage {
+public:
+  InlineMessage() noexcept = default;
+
+  //! \brief Formats message with fmt, `format` is copied as is without args
+  template <typename... Args>
+  explicit InlineMessage(fmt::string_view format, Args const &... args) {
+    if constexpr (sizeof...(Args) == 0) {
+      append(std::string_view(format.data(), format.size()));
+    } else {
+#if FMT_VERSION >= 80000
+      auto const result =
+          fmt::format_to_n(data_m, capacity, fmt::runtime(format), args...);
+#else
+      auto const result = fmt::format_to_n(data_m, capacity, format, args...);
+#endif
+      size_m = std::min(static_cast<std::size_t>(result.size), capacity);
+      data_m[size_m] = '\0';
+    }
+  }
+
+  void append(std::string_view value) noexcept {
+    auto const count = std::min(value.size(), capacity - size_m);
+    std::copy_n(value.data(), count, data_m + size_m);
+    size_m += count;
+    data_m[size_m] = '\0';
+  }
+
+  void removeSuffix(std::size_t count) noexcept {
+    size_m -= std::min(count, size_m);
+    data_m[size_m] = '\0';
+  }
+
+  [[nodiscard]] auto c_str() const noexcept -> char const * { return data_m; }
+  operator std::string_view() const noexcept {
+    return std::string_view(data_m, size_m);
+  }
+
+private:
+  char data_m[capacity + 1] = {};
+  std::size_t size_m = 0;
+};
+
+static constexpr std::size_t max_error_message_size = 511;
+} // namespace impl
+
+/*!
+ * \brief
+ * Base of parsing errors.
+ * \details
+ * Message is formatted with fmt into the error itself, so creating an error
+ * doesn't allocate(messages longer than impl::max_error_message_size are
+ * truncated). Errors of nested values start with the message of the innermost
+ * error, followed by the values that contain it, so truncation drops the
+ * outer context and keeps the cause:
+ * ```cpp
+ * throw TypeMismatch("Failed to get type '{}'.", type_id<T>().name());
+ * ```
+ */
 class ParsingError : public std::runtime_error {
-  using std::runtime_error::runtime_error;
+public:
+  template <typename... Args>
+  explicit ParsingError(fmt::string_view format, Args const &... args)
+      : std::runtime_error(""), message_m(format, args...) {}
+
+  [[nodiscard]] auto what() const noexcept -> char const * override {
+    return message_m.c_str();
+  }
+
+private:
+  impl::InlineMessage<impl::max_error_message_size> message_m;
 };
 
 class TypeMismatch : public ParsingError {
@@ -63,40 +140,47 @@ class ObjectMemberMissing : public ParsingError {
 template <typename Encoding, typename Allocator>
 auto getTypeFlagsAsString(
     rapidjson::GenericValue<Encoding, Allocator> const &json_value) noexcept
-    -> std::string {
-  std::string result = "{  ";
-  result.reserve(32);
+    -> impl::InlineMessage<96> {
+  impl::InlineMessage<96> result;
+  result.append("{  ");
 
   if (json_value.IsNull())
-    result += "Null, ";
+    result.append("Null, ");
   if (json_value.IsBool())
-    result += "Bool, ";
+    result.append("Bool, ");
   if (json_value.IsObject())
-    result += "Object, ";
+    result.append("Object, ");
   if (json_value.IsArray())
-    result += "Array, ";
+    result.append("Array, ");
   if (json_value.IsNumber())
-    result += "Number, ";
+    result.append("Number, ");
   if (json_value.IsInt())
-    result += "Int, ";
+    result.append("Int, ");
   if (json_value.IsUint())
-    result += "Uint, ";
+    result.append("Uint, ");
   if (json_value.IsInt64())
-    result += "Int64, ";
+    result.append("Int64, ");
   if (json_value.IsUint64())
-    result += "Uint64, ";
+    result.append("Uint64, ");
   if (json_value.IsFloat())
-    result += "Float, ";
+    result.append("Float, ");
   if (json_value.IsDouble())
-    result += "Double, ";
+    result.append("Double, ");
 
-  result.resize(result.size() - 2);
-  result += "}";
+  result.removeSuffix(2);
+  result.append("}");
   return result;
 }
 
 namespace impl {
 [[noreturn]] void parsingLippincott(std::string_view type_description);
+
+//! \brief Same as above, description is formatted without allocations
+template <typename... Args>
+[[noreturn]] void parsingLippincott(fmt::string_view format,
+                                    Args const &... args) {
+  parsingLippincott(InlineMessage<max_error_message_size>(format, args...));
+}
 } // namespace impl
 
 namespace impl {
@@ -217,9 +301,9 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
   if (json_value.template Is<Int>()) {
     value = json_value.template Get<Int>();
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<Int>().name(), getTypeFlagsAsString(json_value)));
+        type_id<Int>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -232,9 +316,9 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
   if (json_value.IsNumber()) {
     value = json_value.template Get<Float>();
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<Float>().name(), getTypeFlagsAsString(json_value)));
+        type_id<Float>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -250,9 +334,10 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
     string.reserve(json_value.GetStringLength());
     string.assign(json_value.GetString(), json_value.GetStringLength());
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<string_type>().name(), getTypeFlagsAsString(json_value)));
+        type_id<string_type>().name(),
+        getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -282,14 +367,14 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
       try {
         parse(array[i], vec[i], std::forward<AdditionalInfo>(additional_info));
       } catch (...) {
-        impl::parsingLippincott(
-            fmt::format("{} at index {}", type_id<vector_t>().name(), i));
+        impl::parsingLippincott("{} at index {}", type_id<vector_t>().name(),
+                                i);
       }
     }
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<vector_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<vector_t>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -308,9 +393,9 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
     json_array_t const &json_array = json_value.GetArray();
 
     if (json_array.Size() != Size) {
-      throw ArraySizeMismatch(fmt::format(
+      throw ArraySizeMismatch(
           "Size of json array({}) doesn't match size of std::array({}).",
-          json_array.Size(), Size));
+          json_array.Size(), Size);
     }
 
     for (unsigned i = 0; i < array.size(); ++i) {
@@ -318,14 +403,14 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
         parse(json_array[i], array[i],
               std::forward<AdditionalInfo>(additional_info));
       } catch (...) {
-        impl::parsingLippincott(
-            fmt::format("{} at index {}", type_id<array_t>().name(), i));
+        impl::parsingLippincott("{} at index {}", type_id<array_t>().name(),
+                                i);
       }
     }
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<array_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<array_t>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -344,8 +429,8 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> &json_value,
 
     if (json_array.Size() != Size) {
       throw ArraySizeMismatch(
-          fmt::format("Size of json array({}) doesn't match size of {}.",
-                      json_array.Size(), type_id<array_t>().name()));
+          "Size of json array({}) doesn't match size of {}.",
+          json_array.Size(), type_id<array_t>().name());
     }
 
     for (unsigned i = 0; i < array.size(); ++i) {
@@ -353,14 +438,14 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> &json_value,
         parse(json_array[i], array[i],
               std::forward<AdditionalInfo>(additional_info));
       } catch (...) {
-        impl::parsingLippincott(
-            fmt::format("{} at index {}", type_id<array_t>().name(), i));
+        impl::parsingLippincott("{} at index {}", type_id<array_t>().name(),
+                                i);
       }
     }
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<array_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<array_t>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -395,16 +480,16 @@ void deserializeMapImpl(
         parse(json_member.value, value,
               std::forward<AdditionalInfo>(additional_info));
       } catch (...) {
-        impl::parsingLippincott(fmt::format(
-            "{} at key {}", type_id<map_t>().name(), type_id<key_t>().name()));
+        impl::parsingLippincott("{} at key {}", type_id<map_t>().name(),
+                                type_id<key_t>().name());
       }
       map.emplace(std::move(key), std::move(value));
     }
 
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: {}.",
-        type_id<map_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<map_t>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 } // namespace impl
@@ -469,8 +554,8 @@ void deserializeTupleImpl(
 
     if (json_array.Size() != tuple_size) {
       throw ArraySizeMismatch(
-          fmt::format("Size of json array({}) doesn't match size of {}.",
-                      json_array.Size(), type_id<tuple_t>().name()));
+          "Size of json array({}) doesn't match size of {}.",
+          json_array.Size(), type_id<tuple_t>().name());
     }
     tupleForEach(
         [&json_array, &additional_info](auto &tuple_val,
@@ -479,17 +564,17 @@ void deserializeTupleImpl(
             parse(json_array[index], tuple_val,
                   std::forward<AdditionalInfo>(additional_info));
           } catch (...) {
-            impl::parsingLippincott(fmt::format(
-                "{} at index {}", type_id<tuple_t>().name(), index));
+            impl::parsingLippincott("{} at index {}",
+                                    type_id<tuple_t>().name(), index);
           }
         },
         tuple, index_array);
 
   } else {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: "
         "{}.(Note: tuples should be represented as lists in json)",
-        type_id<tuple_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<tuple_t>().name(), getTypeFlagsAsString(json_value).c_str());
   }
 }
 
@@ -538,10 +623,10 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
   using json_object_t = typename json_value_t::ConstObject;
 
   if (!json_value.IsObject())
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get type '{}'. JSON value has following type flags: "
         "{}.(Note: TupleMap should be represented as Object in json)",
-        type_id<map_t>().name(), getTypeFlagsAsString(json_value)));
+        type_id<map_t>().name(), getTypeFlagsAsString(json_value).c_str());
 
   json_object_t const &json_object = json_value.GetObject();
 
@@ -552,12 +637,8 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
         using ValueType = typename TaggedMemberType::ValueType;
         auto name = getJsonName<TagType>();
         if (name == nullptr) {
-          if (!type_id<TagType>().name()) {
-            throw std::runtime_error(typeid(TagType).name());
-          } else {
-            throw std::runtime_error(type_id<TagType>().name());
-          }
-
+          throw ParsingError("JSON name of tag '{}' is null",
+                             type_id<TagType>().name());
         }
         auto iter = json_object.FindMember(name);
 
@@ -565,16 +646,16 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
           if constexpr (!impl::is_optional_v<ValueType> &&
                         !impl::is_pointer_v<ValueType>) {
             throw ObjectMemberMissing(
-                fmt::format("Couldn't find member {} for {}",
-                            getJsonName<TagType>(), type_id<map_t>().name()));
+                "Couldn't find member {} for {}", getJsonName<TagType>(),
+                type_id<map_t>().name());
           }
         } else {
           try {
             parse(iter->value, tagged_member.value_m,
                   std::forward<AdditionalInfo>(additional_info));
           } catch (...) {
-            impl::parsingLippincott(fmt::format(
-                "{} at key {}", type_id<map_t>().name(), getJsonName<TagType>()));
+            impl::parsingLippincott("{} at key {}", type_id<map_t>().name(),
+                                    getJsonName<TagType>());
           }
         }
       },
@@ -135,9 +135,9 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
   }
 
   if (!json_value.IsString()) {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get function pointer '{}'. Should be a string in JSON.",
-        type_id<Return (*)(Args...)>().name()));
+        type_id<Return (*)(Args...)>().name());
   }
 
   auto const *json_name = json_value.GetString();
@@ -158,9 +158,9 @@ void parse(rapidjson::GenericValue<Encoding, JSONAllocator> const &json_value,
   }
 
   if (!json_value.IsString()) {
-    throw TypeMismatch(fmt::format(
+    throw TypeMismatch(
         "Failed to get pointer to variable '{}'. Should be a string in JSON.",
-        type_id<T>().name()));
+        type_id<T>().name());
   }
 
   auto const *json_name = json_value.GetString();
@@ -180,7 +180,7 @@ void parse(rapidjson::Value const &value, Library &lib,
   }
   if (!value.IsString()) {
     throw TypeMismatch{
-        fmt::format("Failed to get library. Should be a string in JSON.")};
+        "Failed to get library. Should be a string in JSON."};
   }
 
   auto const *lib_path_name = value.GetString();
@@ -196,7 +196,7 @@ void parse(rapidjson::Value const &value, Library &lib,
                      boost::dll::load_mode::append_decorations);
   if (!lib.library_m.is_loaded()) {
     throw LibraryLoadingFailure{
-        fmt::format("Failed to load library '{}'.", lib_path.string())};
+        "Failed to load library '{}'.", lib_path.string()};
   }
 }
 
@@ -216,18 +216,18 @@ template <typename PluginT>
 void loadPluginFromFile(std::filesystem::path const &file_path, PluginT &plugin) {
   namespace fs = std::filesystem;
   if (!fs::exists(file_path)) {
-    throw ConfigLoadingFailure(fmt::format(
-        "Configuration file '{}' doesn't exist.", file_path.string()));
+    throw ConfigLoadingFailure(
+        "Configuration file '{}' doesn't exist.", file_path.string());
   }
   if (!fs::is_regular_file(file_path)) {
-    throw ConfigLoadingFailure(fmt::format(
-        "Configuration file '{}' is not a regular file", file_path.string()));
+    throw ConfigLoadingFailure(
+        "Configuration file '{}' is not a regular file", file_path.string());
   }
 
   std::ifstream file(file_path);
   if (!file.is_open()) {
-    throw ConfigLoadingFailure(fmt::format(
-        "Failed to open configuration file '{}'", file_path.string()));
+    throw ConfigLoadingFailure(
+        "Failed to open configuration file '{}'", file_path.string());
   }
 
   std::basic_string<char, std::char_traits<char>, PolymorphicAllocator<char>>
@@ -14,50 +14,118 @@
  */
 #pragma once
 
+#include "cxx_plugins/call_likely.hpp"
 #include "cxx_plugins/function_proxy.hpp"
 #include "cxx_plugins/memory/stack_allocator.hpp"
 #include "cxx_plugins/polymorphic_allocator.hpp"
+#include "cxx_plugins/polymorphic_storage.hpp"
 #include "cxx_plugins/vtable.hpp"
 #include "cxx_plugins/polymorphic_cast.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <utility>
+
 namespace plugins {
 
 namespace impl {
-struct obj_dtor_tag {};
 struct obj_copy_ctor_tag {};
+struct obj_relocate_tag {};
+
+//! \brief Priority of functions that only Polymorphic itself calls
+using InternalSlotPriority =
+    std::integral_constant<int, std::numeric_limits<int>::min()>;
 } // namespace impl
 
-template <std::size_t size, typename... TaggedSignatures>
+/*
+ * Internal functions are placed after functions of the user tags, so table of
+ * Polymorphic starts with the table of PolymorphicPtr with the same tags and
+ * conversion to it reuses the table.
+ */
+template <>
+struct VTableSlotPriority<impl::obj_copy_ctor_tag>
+    : impl::InternalSlotPriority {};
+template <>
+struct VTableSlotPriority<impl::obj_relocate_tag>
+    : impl::InternalSlotPriority {};
+
+template <typename StoragePolicy, typename... TaggedSignatures>
 class UniqueGenericPolymorphic;
 
-template <std::size_t size, typename... TaggedSignatures>
+template <typename StoragePolicy, typename... TaggedSignatures>
 using GenericPolymorphic = UniqueGenericPolymorphic<
-    size,
-    TaggedSignature<impl::obj_copy_ctor_tag,
-                    void *(void *)const>,
-    TaggedSignatures...>;
+    StoragePolicy, TaggedSignatures...,
+    TaggedSignature<impl::obj_copy_ctor_tag, void *(void *)const>>;
 
-template <typename... Ts>
-using Polymorphic = std::conditional_t<
+//! \brief Storage policy used by Polymorphic and UniquePolymorphic
+using DefaultStoragePolicy = HybridStorage<56>;
+
+/*!
+ * \brief Same as Polymorphic, but allows to choose storage policy.
+ * \details
+ * Available policies:
+ * + `InlineStorage<size, alignment>` - object is always stored inside of
+ *   Polymorphic.
+ * + `HeapStorage` - object is always allocated, Polymorphic stores pointer.
+ * + `HybridStorage<size, alignment>` - small buffer optimization(default).
+ *   Objects aligned stricter than `alignment` are allocated on the heap.
+ * + `ReferenceStorage` - non-owning, Polymorphic stores pointer to the object.
+ * + `SharedStorage<RefCount>` - copies share one allocated object and copy it
+ *   only when non-const function is called(copy-on-write).
+ */
+template <typename StoragePolicy, typename... Ts>
+using BasicPolymorphic = std::conditional_t<
     (is_tagged_signature<Ts> && ...),
-    GenericPolymorphic<64, Ts...>,
-    GenericPolymorphic<64, TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+    GenericPolymorphic<StoragePolicy, Ts...>,
+    GenericPolymorphic<StoragePolicy,
+                       TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
 
-template <typename... Ts>
-using UniquePolymorphic = std::conditional_t<
+//! \brief Same as UniquePolymorphic, but allows to choose storage policy.
+template <typename StoragePolicy, typename... Ts>
+using BasicUniquePolymorphic = std::conditional_t<
     (is_tagged_signature<Ts> && ...),
-    UniqueGenericPolymorphic<64, Ts...>,
-    UniqueGenericPolymorphic<64, TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+    UniqueGenericPolymorphic<StoragePolicy, Ts...>,
+    UniqueGenericPolymorphic<
+        StoragePolicy, TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+
+template <typename... Ts>
+using Polymorphic = BasicPolymorphic<DefaultStoragePolicy, Ts...>;
+
+template <typename... Ts>
+using UniquePolymorphic = BasicUniquePolymorphic<DefaultStoragePolicy, Ts...>;
+
+/*!
+ * \brief
+ * Polymorphic that stores every type of `TypeListT`(TypeList) inline without
+ * wasting space, e.g. `PolymorphicFor<TypeList<Circle, Square>, draw>`.
+ * \details
+ * Types that are not in the list still can be stored, but may be allocated.
+ */
+template <typename TypeListT, typename... Ts>
+using PolymorphicFor = BasicPolymorphic<StorageForT<TypeListT>, Ts...>;
+
+/*!
+ * \brief Polymorphic with O(1) copies, see SharedStorage.
+ * \details
+ * Use `BasicPolymorphic<SharedStorage<LocalRefCount>, Ts...>` if objects
+ * are never shared between threads.
+ */
+template <typename... Ts>
+using SharedPolymorphic = BasicPolymorphic<SharedStorage<>, Ts...>;
 
 /*!
  *
  */
 #ifdef DOXYGEN
-template<std::size_t size, typename... TaggedSignatures>
+template<typename StoragePolicy, typename... TaggedSignatures>
 class UniqueGenericPolymorphic
 #else
-template <std::size_t size, typename... Tags, typename... FunctionSignatures>
-class UniqueGenericPolymorphic<size, TaggedSignature<Tags, FunctionSignatures>...>
+template <typename StoragePolicy, typename... Tags,
+          typename... FunctionSignatures>
+class UniqueGenericPolymorphic<StoragePolicy,
+                               TaggedSignature<Tags, FunctionSignatures>...>
 #endif
 {
   template <typename U>
@@ -67,43 +135,49 @@ class UniqueGenericPolymorphic<size, TaggedSignature<Tags, FunctionSignatures>..
   static constexpr bool is_const =
       (traits::FunctionTraits<FunctionSignatures>::is_const && ...);
 
-public:
-  using FunctionTableT =
-      VTable<TaggedSignature<impl::obj_dtor_tag, void()>,
-             TaggedSignature<Tags, FunctionSignatures>...>;
+  static constexpr bool is_owning = StoragePolicy::is_owning;
+  static constexpr bool is_shared = StoragePolicy::is_shared;
 
-  constexpr UniqueGenericPolymorphic() noexcept : function_table_m(), type_index_m(type_id<void>()) {
-    setState(State::empty);
-  }
-  constexpr UniqueGenericPolymorphic(UniqueGenericPolymorphic const &other) noexcept
-      : function_table_m{other.functionTable()},
-        type_index_m(other.type_index_m)
-  {
+  static constexpr bool is_copyable =
+      !is_owning || traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>;
 
-    static_assert(traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>,
-        "This Polymorphic is not copyable");
+  static_assert(!is_shared ||
+                    traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>,
+                "Shared storage needs copy constructor for copy-on-write");
 
-    auto other_state = other.getState();
-    if (other_state == State::fallback_allocated)
-      new (data_m) FallbackAllocData();
-    other.call<impl::obj_copy_ctor_tag>(allocateBasedOnState(
-        other_state, other.getSize(), other.getAlignment()));
+  template <typename TagT>
+  static constexpr bool is_const_tag = traits::FunctionTraits<
+      traits::ElementType<traits::index_of<std::decay_t<TagT>, Tags...>,
+                          FunctionSignatures...>>::is_const;
+
+  template <typename T>
+  using StoredT = std::conditional_t<is_owning, std::decay_t<T>,
+                                     std::remove_reference_t<T>>;
+
+public:
+  using FunctionTableT = std::conditional_t<
+      is_owning,
+      VTable<TaggedSignature<Tags, FunctionSignatures>...,
+             TaggedSignature<impl::obj_relocate_tag, void(void *)>>,
+      VTable<TaggedSignature<Tags, FunctionSignatures>...>>;
+  using StoragePolicyT = StoragePolicy;
+
+  constexpr UniqueGenericPolymorphic() noexcept = default;
+  constexpr UniqueGenericPolymorphic(UniqueGenericPolymorphic const &other) noexcept
+      : function_table_m{other.functionTable()}
+  {
+    static_assert(is_copyable, "This Polymorphic is not copyable");
+    copyFrom(other);
   }
   constexpr UniqueGenericPolymorphic(UniqueGenericPolymorphic &&other) noexcept
-      : function_table_m{std::move(other.functionTable())},
-        type_index_m(std::move(other.type_index_m))
+      : function_table_m{std::move(other.functionTable())}
   {
-    std::memcpy(data_m, other.data_m, size);
-    auto other_state = other.getState();
-
-    // change state to empty for now to prevent from deallocating/destructing in destructor
-    other.setState(State::empty);
+    moveFrom(other);
   }
 
   constexpr auto operator=(UniqueGenericPolymorphic const &rhs) noexcept
       -> UniqueGenericPolymorphic & {
-    static_assert(traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>,
-        "This Polymorphic is not copyable");
+    static_assert(is_copyable, "This Polymorphic is not copyable");
 
     if (this == &rhs)
       return *this;
@@ -111,12 +185,7 @@ public:
     destructAndDeallocate();
 
     function_table_m = rhs.functionTable();
-    type_index_m = rhs.type_index_m;
-    auto rhs_state = rhs.getState();
-    if (rhs_state == State::fallback_allocated)
-      new (data_m) FallbackAllocData();
-    rhs.call<impl::obj_copy_ctor_tag>(
-        allocateBasedOnState(rhs_state, rhs.getSize(), rhs.getAlignment()));
+    copyFrom(rhs);
 
     return *this;
   }
@@ -127,16 +196,8 @@ public:
 
     destructAndDeallocate();
 
-    std::memcpy(data_m, rhs.data_m, size);
-    auto rhs_state = rhs.getState();
-    if (rhs_state == State::fallback_allocated) {
-      // change state to empty for now to prevent from
-      // deallocating/destructing in destructor, might have to change the
-      // object pointer in other to nullptr instead if this doesn't work
-      rhs.setState(State::empty);
-    }
     function_table_m = std::move(rhs.functionTable());
-    type_index_m = std::move(rhs.type_index_m);
+    moveFrom(rhs);
 
     return *this;
   }
@@ -151,24 +212,38 @@ public:
                             !is_polymorphic_ref_v<std::decay_t<T>> &&
                             !is_polymorphic_v<std::decay_t<T>>>>
   constexpr UniqueGenericPolymorphic(T &&t) noexcept
-      : function_table_m{std::in_place_type_t<std::remove_reference_t<T>>{}},
-        type_index_m(type_id<T>())
+      : function_table_m{std::in_place_type_t<StoredT<T>>{}}
   {
-    static_assert(
-        std::is_rvalue_reference_v<T &&> ||
-            (std::is_lvalue_reference_v<T &&> &&
-             traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>),
-        "This Polymorphic is not copyable");
-
-    State state;
-    if (sizeof(T) <= size - 3)
-      state = State::stack_allocated;
-    else {
-      state = State::fallback_allocated;
-      new (data_m) FallbackAllocData();
+    store(std::forward<T>(t));
+  }
+
+  /*!
+   * \brief Same as main constructor, but allocates object(if it doesn't fit
+   * inline) from `resource` instead of the default memory resource.
+   * \details
+   * Copies of this Polymorphic allocate from the same resource.
+   */
+  template <typename T, typename = std::enable_if_t<
+                            !is_polymorphic_ref_v<std::decay_t<T>> &&
+                            !is_polymorphic_v<std::decay_t<T>>>>
+  UniqueGenericPolymorphic(std::allocator_arg_t /*unused*/,
+                           MemoryResourcePtr resource, T &&t)
+      : function_table_m{std::in_place_type_t<StoredT<T>>{}} {
+    static_assert(is_owning, "Non-owning Polymorphic doesn't allocate");
+    store(std::forward<T>(t), resource);
+  }
+
+  //! \brief Copies `other` allocating from `resource`
+  UniqueGenericPolymorphic(std::allocator_arg_t /*unused*/,
+                           MemoryResourcePtr resource,
+                           UniqueGenericPolymorphic const &other)
+      : function_table_m{other.functionTable()} {
+    static_assert(is_copyable && is_owning && !is_shared,
+                  "This Polymorphic can't be copied to another resource");
+    if (!other.isEmpty()) {
+      other.call<impl::obj_copy_ctor_tag>(
+          storage_m.allocate(function_table_m.header(), resource));
     }
-    new (allocateBasedOnState(state, sizeof(T), alignof(T)))
-        std::decay_t<T>(std::forward<T>(t));
   }
 
   ~UniqueGenericPolymorphic() { destructAndDeallocate(); }
@@ -185,30 +260,19 @@ public:
   constexpr UniqueGenericPolymorphic &operator=(T &&obj) noexcept {
     destructAndDeallocate();
 
-    static_assert(
-        std::is_rvalue_reference_v<T &&> ||
-            (std::is_lvalue_reference_v<T &&> &&
-             traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>),
-        "This Polymorphic is not copyable"); 
-
-    function_table_m = std::in_place_type_t<std::remove_reference_t<T>>{};
-    type_index_m = type_id<T>();
-    State state;
-    if (sizeof(T) <= size - 3)
-      state = State::stack_allocated;
-    else {
-      state = State::fallback_allocated;
-      new (data_m) FallbackAllocData();
-    }
-    new (allocateBasedOnState(state, sizeof(T), alignof(T)))
-        std::decay_t<T>(std::forward<T>(obj));
+    function_table_m = std::in_place_type_t<StoredT<T>>{};
+    store(std::forward<T>(obj));
 
     return *this;
   }
 
   //! \brief Returns proxy object to call function
   template <typename TagT> constexpr auto operator[](TagT &&t) noexcept {
-    return FunctionProxy(function_table_m[std::forward<TagT>(t)], data());
+    if constexpr (is_shared && !is_const_tag<TagT>) {
+      detach();
+    }
+    return FunctionProxy(function_table_m[std::forward<TagT>(t)],
+                         objectData());
   }
 
   template <typename TagT> constexpr auto operator[](TagT &&t) const noexcept {
@@ -219,32 +283,48 @@ public:
   template <typename TagT, typename... Us>
   //! \brief Calls function with given parameters
   constexpr decltype(auto) call(Us &&... parameters) {
-    return function_table_m[TagT{}](data(), std::forward<Us>(parameters)...);
+    if constexpr (is_shared && !is_const_tag<TagT>) {
+      detach();
+    }
+    return impl::invokeTrampoline(function_table_m[TagT{}], objectData(),
+                                  std::forward<Us>(parameters)...);
   }
 
   template <typename TagT, typename... Us>
   constexpr decltype(auto) call(Us &&... parameters) const {
-    return function_table_m[TagT{}](const_cast<void const *>(data()),
-                                    std::forward<Us>(parameters)...);
+    return impl::invokeTrampoline(function_table_m[TagT{}],
+                                  const_cast<void const *>(data()),
+                                  std::forward<Us>(parameters)...);
   }
 
-  [[nodiscard]] auto data() noexcept -> void * { return getData(); }
-  [[nodiscard]] constexpr auto data() const noexcept -> void const * {
-    // copy-pasted from getData. I don't know how to not do this with the const
-    // function
-    auto state = getState();
-    switch (state) {
-    case State::empty: {
-      return nullptr;
-    }
-    case State::stack_allocated: {
-      return data_m;
-    }
-    case State::fallback_allocated: {
-      auto data = reinterpret_cast<const FallbackAllocData *>(data_m);
-      return data->obj_p;
+  /*!
+   * \brief
+   * Same as call, but if the object is of one of `Likely` types(or TypeList of
+   * them) calls its function directly, see call_likely.hpp.
+   */
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) {
+    if constexpr (is_shared && !is_const_tag<TagT>) {
+      detach();
     }
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, objectData(), std::forward<Us>(parameters)...);
+  }
+
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) const {
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, data(), std::forward<Us>(parameters)...);
+  }
+
+  [[nodiscard]] auto data() noexcept -> void * {
+    if constexpr (is_shared) {
+      detach();
     }
+    return objectData();
+  }
+  [[nodiscard]] constexpr auto data() const noexcept -> void const * {
+    return isEmpty() ? nullptr : storage_m.data(function_table_m.header());
   }
 
   [[nodiscard]] constexpr auto functionTable() const noexcept
@@ -252,169 +332,275 @@ public:
     return function_table_m;
   }
 
-  bool isEmpty() const { return getState() == State::empty; }
+  bool isEmpty() const { return function_table_m.isEmpty(); }
 
-  void reset() noexcept {
-    type_index_m = type_id<void>();
-    function_table_m.reset();
-    destructAndDeallocate();
+  /*!
+   * \brief
+   * Returns true if this Polymorphic can be moved to another place with
+   * memcpy(either it is empty, object is stored outside or object is trivially
+   * relocatable).
+   */
+  [[nodiscard]] auto isTriviallyRelocatable() const noexcept -> bool {
+    if (isEmpty())
+      return true;
+    auto const &header = function_table_m.header();
+    return header.is_trivially_relocatable ||
+           !storage_m.isStoredInline(header);
   }
 
+  void reset() noexcept { destructAndDeallocate(); }
+
   template <typename T> inline auto isA() const noexcept -> bool {
-    return type_id<T> == type_index_m;
+    return type_id<T>() == typeIndex();
   }
 
-  inline auto typeIndex() const noexcept -> type_index const & {
-    return type_index_m;
+  //! \brief Returns type_index of stored object, it is kept in function table
+  inline auto typeIndex() const noexcept -> type_index {
+    return function_table_m.typeIndex();
   }
 
   template <typename T, typename... Args>
-  void emplace(std::in_place_type_t<T> type, Args &&... args) noexcept(
-      std::is_nothrow_constructible_v<T, Args &&...>) {
-    destructAndDeallocate();
+  void emplace(std::in_place_type_t<T> /*unused*/, Args &&... args) noexcept(
+      is_nothrow_emplaceable<T, Args...>) {
+    emplaceImpl<T>(MemoryResourcePtr{}, std::forward<Args>(args)...);
+  }
 
-    function_table_m = std::in_place_type_t<std::remove_reference_t<T>>{};
-    type_index_m = type_id<T>();
-    State state;
-    if (sizeof(T) <= size - 3) {
-      state = State::stack_allocated;
-    } else {
-      state = State::fallback_allocated;
-      new (data_m) FallbackAllocData();
+  //! \brief Same as emplace, but allocates object from `resource`
+  template <typename T, typename... Args>
+  void emplace(std::allocator_arg_t /*unused*/, MemoryResourcePtr resource,
+               std::in_place_type_t<T> /*unused*/,
+               Args &&... args) noexcept(is_nothrow_emplaceable<T, Args...>) {
+    emplaceImpl<T>(resource, std::forward<Args>(args)...);
+  }
+
+  /*!
+   * \brief
+   * Returns memory resource the object was allocated from, or empty pointer
+   * if the object is stored inline.
+   */
+  [[nodiscard]] auto memoryResource() const noexcept -> MemoryResourcePtr {
+    if constexpr (is_owning) {
+      if (!isEmpty()) {
+        return storage_m.resource(function_table_m.header());
+      }
     }
-    new (allocateBasedOnState(state, sizeof(T), alignof(T)))
-        std::decay_t<T>(std::forward<Args>(args)...);
+    return {};
   }
 
 private:
-  enum class State : unsigned char {
-    empty,
-    stack_allocated,
-    fallback_allocated
-  };
-
-  struct FallbackAllocData {
-    FallbackAllocData() : obj_p(nullptr), alloc_size(0), alloc_alignment(0) {}
-    PolymorphicAllocator<std::byte> allocator;
-    void *obj_p;
-    std::size_t alloc_size;
-    std::size_t alloc_alignment;
-  };
-
-  void setState(State state) { data_m[size - 1] = static_cast<char>(state); }
-
-  State getState() const { return static_cast<State>(data_m[size - 1]); }
-
-  std::size_t getSize() const {
-    auto state = getState();
-    switch (state) {
-    case State::empty: {
-      return 0;
-    }
-    case State::stack_allocated: {
-      return static_cast<std::size_t>(data_m[size - 2]);
-    }
-    case State::fallback_allocated: {
-      auto data = reinterpret_cast<FallbackAllocData const *>(data_m);
-      return data->alloc_size;
-    }
-    }
+  /*!
+   * \brief
+   * Objects that the policy keeps inline are moved together with Polymorphic,
+   * so they should be move constructible or trivially relocatable. Objects
+   * that are always allocated(HeapStorage, SharedStorage) are never moved.
+   */
+  template <typename T> static constexpr void requireRelocatable() noexcept {
+    static_assert(!StoragePolicy::isStoredInline(impl::makeVTableHeader<T>()) ||
+                      std::is_move_constructible_v<T> ||
+                      is_trivially_relocatable<T>,
+                  "Type stored inline in Polymorphic should be move "
+                  "constructible or trivially relocatable");
   }
 
-  std::size_t getAlignment() const {
-    auto state = getState();
-    switch (state) {
-    case State::empty: {
-      return 0;
-    }
-    case State::stack_allocated: {
-      return static_cast<std::size_t>(data_m[size - 3]);
-    }
-    case State::fallback_allocated: {
-      auto data = reinterpret_cast<FallbackAllocData const *>(data_m);
-      return data->alloc_alignment;
-    }
+  //! \brief emplace can throw only if the policy allocates or `T` throws
+  template <typename T, typename... Args>
+  static constexpr bool is_nothrow_emplaceable =
+      noexcept(std::declval<StoragePolicy &>().allocate(
+          std::declval<impl::VTableHeader const &>(),
+          std::declval<MemoryResourcePtr>())) &&
+      std::is_nothrow_constructible_v<std::decay_t<T>, Args &&...>;
+
+  template <typename T, typename... Args>
+  void emplaceImpl(MemoryResourcePtr resource, Args &&... args) {
+    using ObjectT = std::decay_t<T>;
+    static_assert(is_owning,
+                  "emplace can't be used with non-owning storage policy");
+    static_assert(StoragePolicy::template can_store<ObjectT>,
+                  "Storage policy can't store objects of this type");
+    requireRelocatable<ObjectT>();
+    destructAndDeallocate();
+
+    // table is set last, so Polymorphic stays empty if anything throws
+    FunctionTableT const function_table{std::in_place_type_t<ObjectT>{}};
+    auto const &header = function_table.header();
+    auto *obj_p = storage_m.allocate(header, resource);
+#ifdef __cpp_exceptions
+    try {
+      new (obj_p) ObjectT(std::forward<Args>(args)...);
+    } catch (...) {
+      storage_m.deallocate(header);
+      throw;
     }
+#else
+    new (obj_p) ObjectT(std::forward<Args>(args)...);
+#endif
+    function_table_m = function_table;
   }
 
-  void *getData() {
-    auto state = getState();
-    switch (state) {
-    case State::empty: {
-      return nullptr;
-    }
-    case State::stack_allocated: {
-      return data_m;
-    }
-    case State::fallback_allocated: {
-      auto data = reinterpret_cast<FallbackAllocData *>(data_m);
-      return data->obj_p;
-    }
+  template <typename T>
+  void store(T &&obj, MemoryResourcePtr resource = {}) {
+    static_assert(StoragePolicy::template can_store<StoredT<T>>,
+                  "Storage policy can't store objects of this type");
+    if constexpr (is_owning) {
+      static_assert(std::is_destructible_v<StoredT<T>>,
+                    "Objects stored in Polymorphic should be destructible");
+      requireRelocatable<StoredT<T>>();
+      static_assert(
+          std::is_rvalue_reference_v<T &&> ||
+              (std::is_lvalue_reference_v<T &&> &&
+               traits::is_in_the_pack_v<impl::obj_copy_ctor_tag, Tags...>),
+          "This Polymorphic is not copyable");
+      new (storage_m.allocate(function_table_m.header(), resource))
+          StoredT<T>(std::forward<T>(obj));
+    } else {
+      static_assert(std::is_lvalue_reference_v<T &&>,
+                    "Non-owning Polymorphic can't reference temporary object");
+      storage_m.reference(std::addressof(obj));
     }
   }
 
-  void *allocateBasedOnState(State state, std::size_t bytes,
-                             std::size_t alignment) {
-    void *ret = nullptr;
-    switch (state) {
-    case State::empty:
-      ret = nullptr;
-      break;
-    case State::stack_allocated:
-      ret = data_m;
-      data_m[size - 2] = static_cast<char>(bytes);
-      data_m[size - 3] = static_cast<char>(alignment);
-      break;
-    case State::fallback_allocated: {
-      auto alloc_data = reinterpret_cast<FallbackAllocData *>(data_m);
-      ret = alloc_data->allocator.allocate_bytes(bytes, alignment);
-      alloc_data->obj_p = ret;
-      alloc_data->alloc_size = bytes;
-      alloc_data->alloc_alignment = alignment;
-      break;
-    }
+  void copyFrom(UniqueGenericPolymorphic const &other) {
+    if (other.isEmpty())
+      return;
+    if constexpr (is_shared) {
+      storage_m.share(other.storage_m);
+    } else if constexpr (is_owning) {
+      // copy allocates from the same resource as the original
+      auto const &header = function_table_m.header();
+      other.call<impl::obj_copy_ctor_tag>(
+          storage_m.allocate(header, other.storage_m.resource(header)));
+    } else {
+      storage_m = other.storage_m;
     }
+  }
 
-    setState(state);
-    return ret;
+  void moveFrom(UniqueGenericPolymorphic &other) noexcept {
+    if (other.isEmpty())
+      return;
+    if constexpr (is_owning) {
+      auto relocate = [this](void *dst_p, void *src_p) {
+        function_table_m[impl::obj_relocate_tag{}](src_p, dst_p);
+      };
+      storage_m.relocateFrom(other.storage_m, function_table_m.header(),
+                             relocate);
+    } else {
+      storage_m = other.storage_m;
+    }
+    // other no longer owns the object, so it shouldn't destruct it
+    other.function_table_m.reset();
   }
 
   void destructAndDeallocate() {
-    auto state = getState();
-    if (state == State::empty)
+    if (isEmpty())
       return;
 
-    call<impl::obj_dtor_tag>();
-
-    switch (state) {
-    case State::fallback_allocated: {
-      auto alloc_data = reinterpret_cast<FallbackAllocData *>(data_m);
-      alloc_data->allocator.deallocate_bytes(alloc_data->obj_p,
-                                             alloc_data->alloc_size,
-                                             alloc_data->alloc_alignment);
-      alloc_data->obj_p = nullptr;
-    } break;
-    default:
-      break;
+    if constexpr (is_shared) {
+      if (!storage_m.release()) {
+        function_table_m.reset();
+        return;
+      }
+    }
+    if constexpr (is_owning) {
+      auto const &header = function_table_m.header();
+      header.destroy(storage_m.data(header));
+      storage_m.deallocate(header);
+    }
+    function_table_m.reset();
+  }
+
+  //! \brief Makes own copy of the object if it is shared with others
+  void detach() {
+    if (isEmpty() || storage_m.isUnique())
+      return;
+    auto const &header = function_table_m.header();
+    StoragePolicy copy;
+    auto *copy_p = copy.allocate(header, storage_m.resource(header));
+#ifdef __cpp_exceptions
+    try {
+      std::as_const(*this).template call<impl::obj_copy_ctor_tag>(copy_p);
+    } catch (...) {
+      copy.deallocate(header);
+      throw;
+    }
+#else
+    std::as_const(*this).template call<impl::obj_copy_ctor_tag>(copy_p);
+#endif
+    // others could release their references in the meantime
+    if (storage_m.release()) {
+      header.destroy(storage_m.data(header));
+      storage_m.deallocate(header);
     }
-    setState(State::empty);
+    storage_m = copy;
+  }
+
+  auto objectData() noexcept -> void * {
+    return isEmpty() ? nullptr : storage_m.data(function_table_m.header());
   }
 
 private:
-  char data_m[size];
+  StoragePolicy storage_m;
   FunctionTableT function_table_m;
-  type_index type_index_m;
 };
 
+/*!
+ * \brief
+ * Moves Polymorphic objects from [first, last) into uninitialized memory
+ * starting at `d_first` and ends lifetime of the source objects.
+ * \details
+ * If every object is trivially relocatable(see
+ * UniqueGenericPolymorphic::isTriviallyRelocatable) the whole range is moved
+ * with one memmove, so containers can use it to grow cheaply.
+ * \return Pointer past the last relocated object.
+ */
+template <typename StoragePolicy, typename... TaggedSignatures>
+auto uninitializedRelocate(
+    UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...> *first,
+    UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...> *last,
+    UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...>
+        *d_first) noexcept
+    -> UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...> * {
+  using PolymorphicT =
+      UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...>;
+
+  bool const is_trivial =
+      std::all_of(first, last, [](PolymorphicT const &poly) {
+        return poly.isTriviallyRelocatable();
+      });
+  if (is_trivial) {
+    std::memmove(static_cast<void *>(d_first), static_cast<void *>(first),
+                 static_cast<std::size_t>(last - first) *
+                     sizeof(PolymorphicT));
+    return d_first + (last - first);
+  }
+  for (; first != last; ++first, ++d_first) {
+    new (d_first) PolymorphicT(std::move(*first));
+    first->~PolymorphicT();
+  }
+  return d_first;
+}
+
 namespace impl {
   template <typename T>
   void *polymorphicExtend(impl::obj_copy_ctor_tag /*unused*/, T const &obj, void *ptr) {
     return new (ptr) T(obj);
   }
 
+  /*!
+   * \brief
+   * Called only for objects that are stored inline and aren't trivially
+   * relocatable. Polymorphic checks that such types are movable(see
+   * UniqueGenericPolymorphic::requireRelocatable), other types can be stored
+   * only by policies that don't relocate them.
+   */
   template <typename T>
-  void polymorphicExtend(impl::obj_dtor_tag /*unused*/, T &obj) {
-    obj.~T();
+  void polymorphicExtend(impl::obj_relocate_tag /*unused*/, T &obj,
+                         void *ptr) {
+    if constexpr (std::is_move_constructible_v<T>) {
+      new (ptr) T(std::move(obj));
+      obj.~T();
+    } else {
+      cxxPluginsUnreachable("Relocation of object that isn't movable");
+    }
   }
 } // namespace impl
 
@@ -13,6 +13,7 @@
  */
 #pragma once
 
+#include "cxx_plugins/call_likely.hpp"
 #include "cxx_plugins/function_proxy.hpp"
 #include "cxx_plugins/type_index.hpp"
 #include "cxx_plugins/vtable.hpp"
@@ -20,11 +21,12 @@
 
 namespace plugins {
 
-template <std::size_t size, typename... TaggedSignatures>
+template <typename StoragePolicy, typename... TaggedSignatures>
 class UniqueGenericPolymorphic;
 namespace impl {
 template <typename... TaggedSignatures> class PolymorphicPtr;
-template <typename... TaggedSignatures> class PrimitivePolymorphicPtr;
+template <template <typename...> class VTableT, typename... TaggedSignatures>
+class BasicPrimitivePolymorphicPtr;
 } // namespace impl
 
 template <typename... Ts>
@@ -32,11 +34,29 @@ using PolymorphicPtr = std::conditional_t<
     (is_tagged_signature<Ts> && ...), impl::PolymorphicPtr<Ts...>,
     impl::PolymorphicPtr<TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
 
+template <template <typename...> class VTableT, typename... Ts>
+using BasicPrimitivePolymorphicPtr = std::conditional_t<
+    (is_tagged_signature<Ts> && ...),
+    impl::BasicPrimitivePolymorphicPtr<VTableT, Ts...>,
+    impl::BasicPrimitivePolymorphicPtr<
+        VTableT, TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+
+template <typename... Ts>
+using PrimitivePolymorphicPtr =
+    BasicPrimitivePolymorphicPtr<PrimitiveVTable, Ts...>;
+
+/*!
+ * \brief
+ * Same as PrimitivePolymorphicPtr, but for interfaces with a few functions
+ * keeps function pointers inside of the pointer(see CompactVTable), so calls
+ * don't load function table first.
+ * \details
+ * Can be constructed from any PolymorphicPtr or Polymorphic that has all
+ * functions of this pointer.
+ */
 template <typename... Ts>
-using PrimitivePolymorphicPtr = std::conditional_t<
-    (is_tagged_signature<Ts> && ...), impl::PrimitivePolymorphicPtr<Ts...>,
-    impl::PrimitivePolymorphicPtr<
-        TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+using InlinePolymorphicPtr =
+    BasicPrimitivePolymorphicPtr<CompactVTable, Ts...>;
 
 namespace impl {
 template <typename... TaggedSignatures> class PolymorphicPtr;
@@ -83,9 +103,18 @@ public:
    *
    */
   constexpr PolymorphicPtr(T *obj_p) noexcept
-      : type_index_m{type_id<T>()}, data_p_m{obj_p},
+      : data_p_m{obj_p},
         function_table_m{std::in_place_type_t<T>{}} {}
 
+  /*!
+   * \brief
+   * Creates PolymorphicPtr from pointer to the object and function table that
+   * was formed for the type of the object.
+   */
+  constexpr PolymorphicPtr(PointerT data_p,
+                           FunctionTableT const &function_table) noexcept
+      : data_p_m{data_p}, function_table_m{function_table} {}
+
   template <typename... OtherTags, typename... OtherFunctions,
             bool const_contraint = !is_const,
             std::enable_if_t<const_contraint, int> = 0,
@@ -98,7 +127,7 @@ public:
   constexpr PolymorphicPtr(
       PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...>
           &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
   template <typename... OtherTags, typename... OtherFunctions,
@@ -110,7 +139,7 @@ public:
   constexpr PolymorphicPtr(
       PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...> const
           &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
   template <typename... OtherTags, typename... OtherFunctions,
@@ -129,7 +158,7 @@ public:
   constexpr PolymorphicPtr(
       PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...>
           &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
   template <typename... OtherTags, typename... OtherFunctions,
@@ -144,10 +173,11 @@ public:
   constexpr PolymorphicPtr(
       PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...> const
           &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
-  template <std::size_t size, typename... OtherTags, typename... OtherFunctions,
+  template <typename StoragePolicy, typename... OtherTags,
+            typename... OtherFunctions,
             bool constraints =
                 // Tags >= 1, because otherwise it is a default constructor
             sizeof...(Tags) >= 1 &&
@@ -161,11 +191,13 @@ public:
    */
   constexpr PolymorphicPtr(
       UniqueGenericPolymorphic<
-          size, TaggedSignature<OtherTags, OtherFunctions>...> &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+          StoragePolicy, TaggedSignature<OtherTags, OtherFunctions>...>
+          &rhs) noexcept
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
-  template <std::size_t size, typename... OtherTags, typename... OtherFunctions,
+  template <typename StoragePolicy, typename... OtherTags,
+            typename... OtherFunctions,
             bool constraints =
                 // Tags >= 1, because otherwise it is a default constructor
             sizeof...(Tags) >= 1 &&
@@ -175,9 +207,9 @@ public:
             std::enable_if_t<constraints, unsigned> = 0>
   constexpr PolymorphicPtr(
       UniqueGenericPolymorphic<
-          size, TaggedSignature<OtherTags, OtherFunctions>...> const
+          StoragePolicy, TaggedSignature<OtherTags, OtherFunctions>...> const
           &rhs) noexcept
-      : type_index_m{rhs.typeIndex()}, data_p_m{rhs.data()},
+      : data_p_m{rhs.data()},
         function_table_m{rhs.functionTable()} {}
 
   template <typename T, typename = std::enable_if_t<
@@ -190,7 +222,6 @@ public:
    *
    */
   constexpr PolymorphicPtr &operator=(T &&obj) noexcept {
-    type_index_m = type_id<T>();
     function_table_m = std::in_place_type_t<decltype(obj)>{};
     data_p_m = &obj;
     return *this;
@@ -222,7 +253,6 @@ public:
   constexpr PolymorphicPtr &
   operator=(PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...>
                 &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
@@ -236,7 +266,6 @@ public:
   constexpr PolymorphicPtr &
   operator=(PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...> const
                 &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
@@ -258,7 +287,6 @@ public:
   constexpr PolymorphicPtr &
   operator=(PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...>
                 &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
@@ -275,13 +303,13 @@ public:
   constexpr PolymorphicPtr &
   operator=(PolymorphicPtr<TaggedSignature<OtherTags, OtherFunctions>...> const
                 &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
   }
 
-  template <std::size_t size, typename... OtherTags, typename... OtherFunctions,
+  template <typename StoragePolicy, typename... OtherTags,
+            typename... OtherFunctions,
             bool constraints =
                 // Tags >= 1, because otherwise it is a default constructor
             sizeof...(Tags) >= 1 &&
@@ -295,14 +323,15 @@ public:
    */
   constexpr PolymorphicPtr &operator=(
       UniqueGenericPolymorphic<
-          size, TaggedSignature<OtherTags, OtherFunctions>...> &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
+          StoragePolicy, TaggedSignature<OtherTags, OtherFunctions>...>
+          &rhs) noexcept {
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
   }
 
-  template <std::size_t size, typename... OtherTags, typename... OtherFunctions,
+  template <typename StoragePolicy, typename... OtherTags,
+            typename... OtherFunctions,
             bool constraints =
                 // Tags >= 1, because otherwise it is a default constructor
             sizeof...(Tags) >= 1 &&
@@ -312,9 +341,8 @@ public:
             std::enable_if_t<constraints, unsigned> = 0>
   constexpr PolymorphicPtr &
   operator=(UniqueGenericPolymorphic<
-            size, TaggedSignature<OtherTags, OtherFunctions>...> const
+            StoragePolicy, TaggedSignature<OtherTags, OtherFunctions>...> const
                 &rhs) noexcept {
-    type_index_m = rhs.typeIndex();
     function_table_m = rhs.functionTable();
     data_p_m = rhs.data();
     return *this;
@@ -333,14 +361,54 @@ public:
   template <typename TagT, typename... Us>
   //! \brief Calls function with given parameters
   constexpr decltype(auto) call(Us &&... parameters) {
-    auto fn_ptr = function_table_m[TagT{}];
-    return fn_ptr(data_p_m, std::forward<Us>(parameters)...);
+    return impl::invokeTrampoline(function_table_m[TagT{}], data_p_m,
+                                  std::forward<Us>(parameters)...);
   }
 
   template <typename TagT, typename... Us>
   constexpr decltype(auto) call(Us &&... parameters) const {
-    return function_table_m[TagT{}](const_cast<void const *>(data_p_m),
-                                    std::forward<Us>(parameters)...);
+    return impl::invokeTrampoline(function_table_m[TagT{}],
+                                  const_cast<void const *>(data_p_m),
+                                  std::forward<Us>(parameters)...);
+  }
+
+  /*!
+   * \brief
+   * Same as call, but if the object is of one of `Likely` types(or TypeList of
+   * them) calls its function directly, see call_likely.hpp.
+   */
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) {
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, data_p_m, std::forward<Us>(parameters)...);
+  }
+
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) const {
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, const_cast<void const *>(data_p_m),
+        std::forward<Us>(parameters)...);
+  }
+
+  /*!
+   * \brief
+   * Calls function of the tag with `name`(see TagName) with type erased
+   * arguments, see dynamic_call.hpp and VTable::callByName.
+   */
+  void callByName(std::string_view name, DynamicArguments args = {},
+                  DynamicArgument result = {}) {
+    function_table_m.callByName(name, data_p_m, args, result);
+  }
+
+  void callByName(std::string_view name, DynamicArguments args = {},
+                  DynamicArgument result = {}) const {
+    function_table_m.callByName(name, const_cast<void const *>(data_p_m),
+                                args, result);
+  }
+
+  //! \brief Returns true if the interface has tag with `name`
+  static constexpr auto hasTag(std::string_view name) noexcept -> bool {
+    return FunctionTableT::slotOf(name) != FunctionTableT::npos;
   }
 
   [[nodiscard]] auto data() noexcept -> PointerT { return data_p_m; }
@@ -357,17 +425,17 @@ public:
     return data_p_m == nullptr;
   }
   void reset() noexcept {
-    type_index_m = type_id<void>();
     data_p_m = nullptr;
     function_table_m.reset();
   }
 
   template <typename T> inline auto isA() const noexcept -> bool {
-    return type_id<T> == type_index_m;
+    return type_id<T>() == typeIndex();
   }
 
-  inline auto typeIndex() const noexcept -> type_index const & {
-    return type_index_m;
+  //! \brief Returns type_index of the object, it is kept in function table
+  inline auto typeIndex() const noexcept -> type_index {
+    return function_table_m.typeIndex();
   }
 
   operator bool() const noexcept{
@@ -376,53 +444,55 @@ public:
 
 private:
   /*
-   * Order of members is important.
-   * Function table is aligned the same way as void*, but it ends with array
-   * of uint8_t which means that if we swap these to members there are gonna be
-   * padding bytes between members and size of these padding bytes can differ
-   * on different compilers.
+   * Data pointer goes first, so `data()` is at offset 0 for every function
+   * table type(VTable is one pointer, InlineVTable is an array of function
+   * pointers).
    */
-  type_index type_index_m = {};
   PointerT data_p_m = nullptr;
   FunctionTableT function_table_m;
 };
 
-template <typename... Signatures> class PrimitivePolymorphicPtr;
+template <template <typename...> class VTableT, typename... Signatures>
+class BasicPrimitivePolymorphicPtr;
 
 /*!
  * \brief
- * PolymorphicRSimplePolymorphicPtrlike wrapper for polymorphic objects.
+ * Pointer-like wrapper for polymorphic objects that doesn't support upcasting.
+ * \details
+ * `VTableT` is PrimitiveVTable or CompactVTable.
  */
 #ifdef DOXYGEN
-template <typename... TaggedSignatures>
-class PrimitivePolymorphicPtr
+template <template <typename...> class VTableT, typename... TaggedSignatures>
+class BasicPrimitivePolymorphicPtr
 #else
-template <typename... Tags, typename... Signatures>
-class PrimitivePolymorphicPtr<TaggedSignature<Tags, Signatures>...>
+template <template <typename...> class VTableT, typename... Tags,
+          typename... Signatures>
+class BasicPrimitivePolymorphicPtr<VTableT,
+                                   TaggedSignature<Tags, Signatures>...>
 #endif
 {
 private:
   template <typename U>
   static constexpr bool is_self =
-      std::is_same_v<std::decay_t<U>, PolymorphicPtr>;
+      std::is_same_v<std::decay_t<U>, BasicPrimitivePolymorphicPtr>;
 
   static constexpr bool is_const =
       (traits::FunctionTraits<Signatures>::is_const && ...);
 
 public:
   using PointerT = std::conditional_t<is_const, void const *, void *>;
-  using FunctionTableT = PrimitiveVTable<TaggedSignature<
-      Tags, PolymorphicSignatureT<PrimitivePolymorphicPtr, Signatures>>...>;
+  using FunctionTableT = VTableT<TaggedSignature<
+      Tags, PolymorphicSignatureT<BasicPrimitivePolymorphicPtr, Signatures>>...>;
 
-  constexpr PrimitivePolymorphicPtr() noexcept = default;
-  constexpr PrimitivePolymorphicPtr(PrimitivePolymorphicPtr const &) noexcept =
+  constexpr BasicPrimitivePolymorphicPtr() noexcept = default;
+  constexpr BasicPrimitivePolymorphicPtr(BasicPrimitivePolymorphicPtr const &) noexcept =
       default;
-  constexpr PrimitivePolymorphicPtr(PrimitivePolymorphicPtr &&) noexcept =
+  constexpr BasicPrimitivePolymorphicPtr(BasicPrimitivePolymorphicPtr &&) noexcept =
       default;
-  constexpr auto operator=(PrimitivePolymorphicPtr const &) noexcept
-      -> PrimitivePolymorphicPtr & = default;
-  constexpr auto operator=(PrimitivePolymorphicPtr &&) noexcept
-      -> PrimitivePolymorphicPtr & = default;
+  constexpr auto operator=(BasicPrimitivePolymorphicPtr const &) noexcept
+      -> BasicPrimitivePolymorphicPtr & = default;
+  constexpr auto operator=(BasicPrimitivePolymorphicPtr &&) noexcept
+      -> BasicPrimitivePolymorphicPtr & = default;
 
   template <typename T, typename = std::enable_if_t<
                             !is_polymorphic_ref_v<std::decay_t<T>> &&
@@ -434,8 +504,8 @@ public:
    * It gets object of any type stores pointer to it and forms a function table.
    *
    */
-  constexpr PrimitivePolymorphicPtr(T &&obj) noexcept
-      : type_index_m{type_id<T>()}, data_p_m{&obj},
+  constexpr BasicPrimitivePolymorphicPtr(T &&obj) noexcept
+      : data_p_m{&obj},
         function_table_m{std::in_place_type_t<decltype(obj)>{}} {}
 
   template <typename T, typename = std::enable_if_t<
@@ -446,8 +516,26 @@ public:
    * Conversion constructor for pointers.
    *
    */
-  constexpr PrimitivePolymorphicPtr(T *obj) noexcept
-      : PrimitivePolymorphicPtr(*obj) {}
+  constexpr BasicPrimitivePolymorphicPtr(T *obj) noexcept
+      : BasicPrimitivePolymorphicPtr(*obj) {}
+
+  template <typename PolymorphicT,
+            std::enable_if_t<
+                (is_polymorphic_ref_v<std::decay_t<PolymorphicT>> ||
+                 is_polymorphic_v<std::decay_t<PolymorphicT>>) &&
+                !is_self<PolymorphicT> &&
+                std::is_constructible_v<
+                    FunctionTableT,
+                    typename std::decay_t<PolymorphicT>::FunctionTableT const
+                        &>,
+                int> = 0>
+  /*!
+   * \brief
+   * Conversion from other PolymorphicPtr or Polymorphic, available if
+   * function table supports it(e.g. InlineVTable).
+   */
+  constexpr BasicPrimitivePolymorphicPtr(PolymorphicT &&rhs) noexcept
+      : data_p_m{rhs.data()}, function_table_m{rhs.functionTable()} {}
 
   template <typename T, typename = std::enable_if_t<
                             !is_polymorphic_ref_v<std::decay_t<T>> &&
@@ -458,8 +546,7 @@ public:
    * It gets object of any type stores pointer to it and forms a function table.
    *
    */
-  constexpr PrimitivePolymorphicPtr &operator=(T &&obj) noexcept {
-    type_index_m = type_id<T>();
+  constexpr BasicPrimitivePolymorphicPtr &operator=(T &&obj) noexcept {
     function_table_m = std::in_place_type_t<decltype(obj)>{};
     data_p_m = &obj;
     return *this;
@@ -473,7 +560,7 @@ public:
    * Conversion assignment for pointers
    *
    */
-  constexpr PrimitivePolymorphicPtr &operator=(T *obj) noexcept {
+  constexpr BasicPrimitivePolymorphicPtr &operator=(T *obj) noexcept {
     *this = *obj;
     return *this;
   }
@@ -491,14 +578,33 @@ public:
   template <typename TagT, typename... Us>
   //! \brief Calls function with given parameters
   constexpr decltype(auto) call(Us &&... parameters) {
-    auto fn_ptr = function_table_m[TagT{}];
-    return fn_ptr(data_p_m, std::forward<Us>(parameters)...);
+    return impl::invokeTrampoline(function_table_m[TagT{}], data_p_m,
+                                  std::forward<Us>(parameters)...);
   }
 
   template <typename TagT, typename... Us>
   constexpr decltype(auto) call(Us &&... parameters) const {
-    return function_table_m[TagT{}](const_cast<void const *>(data_p_m),
-                                    std::forward<Us>(parameters)...);
+    return impl::invokeTrampoline(function_table_m[TagT{}],
+                                  const_cast<void const *>(data_p_m),
+                                  std::forward<Us>(parameters)...);
+  }
+
+  /*!
+   * \brief
+   * Same as call, but if the object is of one of `Likely` types(or TypeList of
+   * them) calls its function directly, see call_likely.hpp.
+   */
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) {
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, data_p_m, std::forward<Us>(parameters)...);
+  }
+
+  template <typename TagT, typename... Likely, typename... Us>
+  decltype(auto) callLikely(Us &&... parameters) const {
+    return impl::CallLikely<TagT, Likely...>::call(
+        function_table_m, const_cast<void const *>(data_p_m),
+        std::forward<Us>(parameters)...);
   }
 
   [[nodiscard]] auto data() noexcept -> PointerT { return data_p_m; }
@@ -515,21 +621,20 @@ public:
     return data_p_m == nullptr;
   }
   void reset() noexcept {
-    type_index_m = type_id<void>();
     data_p_m = nullptr;
     function_table_m.reset();
   }
 
   template <typename T> inline auto isA() const noexcept -> bool {
-    return type_id<T>() == type_index_m;
+    return type_id<T>() == typeIndex();
   }
 
-  inline auto typeIndex() const noexcept -> type_index const & {
-    return type_index_m;
+  //! \brief Returns type_index of the object, it is kept in function table
+  inline auto typeIndex() const noexcept -> type_index {
+    return function_table_m.typeIndex();
   }
 
 private:
-  type_index type_index_m = {};
   PointerT data_p_m = nullptr;
   FunctionTableT function_table_m;
 };
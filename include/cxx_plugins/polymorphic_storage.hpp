@@ -0,0 +1,511 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_storage.hpp
+ * \author  Andrey Ponomarev
+ * \date    12 Oct 2020
+ * \brief
+ * Contains storage policies for UniqueGenericPolymorphic.
+ *
+ * \details
+ * Storage policy decides where the object of Polymorphic is placed.
+ * Every policy provides following interface:
+ * + `is_owning` - if `false` Polymorphic only references the object and never
+ *   calls copy constructor/destructor of it.
+ * + `is_shared` - if `true` copies of Polymorphic share the object, see
+ *   SharedStorage for additional interface.
+ * + `can_store<T>` - if `false` Polymorphic with this policy can't be
+ *   constructed from object of type `T`.
+ * + `allocate(header, resource)` - returns memory for object described by
+ *   `header`. If the object doesn't fit inside of the policy it is allocated
+ *   from `resource`(default memory resource if `resource` is empty).
+ * + `resource(header)` - returns resource the object was allocated from or
+ *   empty pointer if it was not allocated, so copies can use the same one.
+ * + `deallocate(header)` - frees memory of destroyed object.
+ * + `relocateFrom(other, header, relocate)` - takes ownership of the object
+ *   stored in `other`. `relocate(dst, src)` is called for the objects that
+ *   can't be moved by pointer and are not trivially relocatable.
+ * + `isStoredInline(header)` - if `true` the object is placed inside of the
+ *   policy, so moving it requires relocation of the object itself.
+ * + `data(header)` - returns pointer to the stored object.
+ *
+ * `header` is impl::VTableHeader of the stored object. It is taken from the
+ * function table of Polymorphic, so neither size nor alignment of the object
+ * is stored inside of the policy. Empty state is tracked by Polymorphic
+ * itself(by function table) as well.
+ */
+#pragma once
+
+#include "cxx_plugins/memory/memory_common.hpp"
+#include "cxx_plugins/polymorphic_allocator.hpp"
+#include "cxx_plugins/type_traits.hpp"
+#include "cxx_plugins/vtable.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace plugins {
+
+namespace impl {
+/*!
+ * \brief
+ * Allocation information that is placed right before the object allocated
+ * on the heap. Size and alignment of the block are known from VTableHeader.
+ */
+struct HeapBlockHeader {
+  PolymorphicAllocator<std::byte> allocator;
+};
+
+template <typename BlockHeaderT = HeapBlockHeader>
+constexpr auto heapBlockAlignment(std::size_t alignment) noexcept
+    -> std::size_t {
+  return std::max(alignment, alignof(BlockHeaderT));
+}
+
+template <typename BlockHeaderT = HeapBlockHeader>
+constexpr auto heapBlockOffset(std::size_t alignment) noexcept
+    -> std::size_t {
+  return utility::roundLengthToAlignment(
+      sizeof(BlockHeaderT), heapBlockAlignment<BlockHeaderT>(alignment));
+}
+
+template <typename BlockHeaderT = HeapBlockHeader>
+inline auto heapBlockHeader(void *obj_p) noexcept -> BlockHeaderT & {
+  return *std::launder(reinterpret_cast<BlockHeaderT *>(
+      static_cast<std::byte *>(obj_p) - sizeof(BlockHeaderT)));
+}
+
+/*!
+ * \brief Allocates block with space for `BlockHeaderT` and object.
+ * \details
+ * `BlockHeaderT` should be HeapBlockHeader or an aggregate derived from it.
+ * Global default memory resource is looked up only if `resource` is empty.
+ * \return Pointer to the memory for the object.
+ */
+template <typename BlockHeaderT = HeapBlockHeader>
+inline auto allocateHeapBlock(VTableHeader const &header,
+                              MemoryResourcePtr resource) -> void * {
+  auto const alignment = heapBlockAlignment<BlockHeaderT>(header.alignment);
+  auto const offset = heapBlockOffset<BlockHeaderT>(header.alignment);
+
+  PolymorphicAllocator<std::byte> allocator =
+      resource.isEmpty() ? PolymorphicAllocator<std::byte>{}
+                         : PolymorphicAllocator<std::byte>{resource};
+  auto *block_p = static_cast<std::byte *>(
+      allocator.allocate_bytes(offset + header.size, alignment));
+  auto *obj_p = block_p + offset;
+  new (obj_p - sizeof(BlockHeaderT)) BlockHeaderT{{allocator}};
+  return obj_p;
+}
+
+template <typename BlockHeaderT = HeapBlockHeader>
+inline auto heapBlockResource(void const *obj_p) noexcept -> MemoryResourcePtr {
+  return heapBlockHeader<BlockHeaderT>(const_cast<void *>(obj_p))
+      .allocator.resource();
+}
+
+template <typename BlockHeaderT = HeapBlockHeader>
+inline void deallocateHeapBlock(void *obj_p,
+                                VTableHeader const &header) noexcept {
+  auto &block_header = heapBlockHeader<BlockHeaderT>(obj_p);
+  auto const alignment = heapBlockAlignment<BlockHeaderT>(header.alignment);
+  auto const offset = heapBlockOffset<BlockHeaderT>(header.alignment);
+  PolymorphicAllocator<std::byte> allocator = block_header.allocator;
+  block_header.~BlockHeaderT();
+  allocator.deallocate_bytes(static_cast<std::byte *>(obj_p) - offset,
+                             offset + header.size, alignment);
+}
+
+/*!
+ * \brief Moves object from `src_p` to `dst_p` ending lifetime of the source.
+ * \details
+ * Trivially relocatable objects are copied with memcpy(only `header.size`
+ * bytes), for others `relocate(dst_p, src_p)` is called.
+ */
+template <typename Relocate>
+void relocateObject(void *dst_p, void *src_p, VTableHeader const &header,
+                    Relocate &&relocate) noexcept {
+  if (header.is_trivially_relocatable) {
+    std::memcpy(dst_p, src_p, header.size);
+  } else {
+    std::forward<Relocate>(relocate)(dst_p, src_p);
+  }
+}
+} // namespace impl
+
+/*!
+ * \brief
+ * Stores objects only inside of the Polymorphic.
+ * Construction from the type that doesn't fit(by size or alignment) is a
+ * compile time error.
+ */
+template <std::size_t size, std::size_t alignment = alignof(std::max_align_t)>
+class InlineStorage {
+public:
+  static constexpr bool is_owning = true;
+  static constexpr bool is_shared = false;
+  template <typename T>
+  static constexpr bool can_store =
+      sizeof(T) <= size && alignof(T) <= alignment;
+
+  auto allocate(impl::VTableHeader const & /*unused*/,
+                MemoryResourcePtr /*unused*/ = {}) noexcept -> void * {
+    return data_m;
+  }
+  void deallocate(impl::VTableHeader const & /*unused*/) noexcept {}
+  [[nodiscard]] static auto
+  resource(impl::VTableHeader const & /*unused*/) noexcept
+      -> MemoryResourcePtr {
+    return {};
+  }
+  template <typename Relocate>
+  void relocateFrom(InlineStorage &other, impl::VTableHeader const &header,
+                    Relocate &&relocate) noexcept {
+    impl::relocateObject(data_m, other.data_m, header,
+                         std::forward<Relocate>(relocate));
+  }
+
+  static constexpr auto
+  isStoredInline(impl::VTableHeader const & /*unused*/) noexcept -> bool {
+    return true;
+  }
+
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) noexcept
+      -> void * {
+    return data_m;
+  }
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) const noexcept
+      -> void const * {
+    return data_m;
+  }
+
+private:
+  alignas(alignment) char data_m[size];
+};
+
+/*!
+ * \brief
+ * Always allocates objects with PolymorphicAllocator.
+ * Polymorphic itself keeps only a pointer to the object.
+ */
+class HeapStorage {
+public:
+  static constexpr bool is_owning = true;
+  static constexpr bool is_shared = false;
+  template <typename T> static constexpr bool can_store = true;
+
+  auto allocate(impl::VTableHeader const &header,
+                MemoryResourcePtr resource = {}) -> void * {
+    return obj_p_m = impl::allocateHeapBlock(header, resource);
+  }
+  void deallocate(impl::VTableHeader const &header) noexcept {
+    impl::deallocateHeapBlock(obj_p_m, header);
+    obj_p_m = nullptr;
+  }
+  [[nodiscard]] auto resource(impl::VTableHeader const & /*unused*/) const
+      noexcept -> MemoryResourcePtr {
+    return impl::heapBlockResource(obj_p_m);
+  }
+  template <typename Relocate>
+  void relocateFrom(HeapStorage &other, impl::VTableHeader const & /*unused*/,
+                    Relocate && /*unused*/) noexcept {
+    obj_p_m = std::exchange(other.obj_p_m, nullptr);
+  }
+
+  static constexpr auto
+  isStoredInline(impl::VTableHeader const & /*unused*/) noexcept -> bool {
+    return false;
+  }
+
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) noexcept
+      -> void * {
+    return obj_p_m;
+  }
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) const noexcept
+      -> void const * {
+    return obj_p_m;
+  }
+
+private:
+  void *obj_p_m = nullptr;
+};
+
+/*!
+ * \brief
+ * Small buffer optimization.
+ * Objects that fit into the buffer are stored inline, others are allocated
+ * with PolymorphicAllocator and only pointer to them is kept in the buffer.
+ * Whether object is stored inline is decided by its VTableHeader, so the whole
+ * buffer is available for the object.
+ *
+ * \details
+ * Buffer is aligned to `alignment`(but at least to alignment of a pointer).
+ * Objects with bigger alignment(e.g. SIMD types) are allocated on the heap
+ * with their own alignment, so increase `alignment` to keep them inline:
+ * `HybridStorage<64, 32>`.
+ */
+template <std::size_t size, std::size_t alignment = alignof(void *)>
+class HybridStorage {
+  static_assert(size >= sizeof(void *),
+                "HybridStorage buffer is too small to hold fallback pointer");
+
+public:
+  static constexpr bool is_owning = true;
+  static constexpr bool is_shared = false;
+  template <typename T> static constexpr bool can_store = true;
+
+  static constexpr auto isStoredInline(impl::VTableHeader const &header) noexcept
+      -> bool {
+    return header.size <= size && header.alignment <= alignof(HybridStorage);
+  }
+  template <typename T>
+  static constexpr bool is_stored_inline =
+      isStoredInline(impl::makeVTableHeader<T>());
+
+  auto allocate(impl::VTableHeader const &header,
+                MemoryResourcePtr resource = {}) -> void * {
+    if (isStoredInline(header)) {
+      return data_m;
+    }
+    if (header.fallback_allocations != nullptr) {
+      header.fallback_allocations->fetch_add(1, std::memory_order_relaxed);
+    }
+    return fallbackPtr() = impl::allocateHeapBlock(header, resource);
+  }
+  void deallocate(impl::VTableHeader const &header) noexcept {
+    if (!isStoredInline(header)) {
+      impl::deallocateHeapBlock(fallbackPtr(), header);
+    }
+  }
+  [[nodiscard]] auto resource(impl::VTableHeader const &header) const noexcept
+      -> MemoryResourcePtr {
+    if (isStoredInline(header)) {
+      return {};
+    }
+    return impl::heapBlockResource(
+        const_cast<HybridStorage *>(this)->fallbackPtr());
+  }
+  template <typename Relocate>
+  void relocateFrom(HybridStorage &other, impl::VTableHeader const &header,
+                    Relocate &&relocate) noexcept {
+    if (isStoredInline(header)) {
+      impl::relocateObject(data_m, other.data_m, header,
+                           std::forward<Relocate>(relocate));
+    } else {
+      fallbackPtr() = std::exchange(other.fallbackPtr(), nullptr);
+    }
+  }
+
+  [[nodiscard]] auto data(impl::VTableHeader const &header) noexcept
+      -> void * {
+    return isStoredInline(header) ? data_m : fallbackPtr();
+  }
+  [[nodiscard]] auto data(impl::VTableHeader const &header) const noexcept
+      -> void const * {
+    return const_cast<HybridStorage *>(this)->data(header);
+  }
+
+private:
+  auto fallbackPtr() noexcept -> void *& {
+    return *reinterpret_cast<void **>(data_m);
+  }
+
+  alignas(std::max(alignment, alignof(void *))) char data_m[size];
+};
+
+/*!
+ * \brief
+ * Returns how many objects of type `T` didn't fit into HybridStorage buffer
+ * and were allocated on the heap.
+ * \details
+ * Objects are counted only if `CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS` is
+ * non-zero(by default in debug builds) in the library that built the function
+ * table of `T`, otherwise returns 0.
+ * Use it to pick buffer size of Polymorphic, or check PolymorphicFor.
+ */
+template <typename T>
+auto fallbackAllocationCount() noexcept -> std::size_t {
+#if CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS
+  return impl::fallback_allocations<std::remove_cv_t<std::remove_reference_t<T>>>
+      .load(std::memory_order_relaxed);
+#else
+  return 0;
+#endif
+}
+
+/*!
+ * \brief
+ * HybridStorage with buffer big enough(and aligned enough) to store every
+ * type of `TypeList<Ts...>` inline.
+ */
+template <typename TypeListT> struct StorageFor;
+
+template <typename... Ts> struct StorageFor<TypeList<Ts...>> {
+  static_assert(sizeof...(Ts) > 0, "Type list is empty");
+  using Type = HybridStorage<std::max({sizeof(void *), sizeof(Ts)...}),
+                             std::max({alignof(void *), alignof(Ts)...})>;
+  static_assert((Type::template is_stored_inline<Ts> && ...),
+                "Every type of the list should be stored inline");
+};
+
+template <typename TypeListT>
+using StorageForT = typename StorageFor<TypeListT>::Type;
+
+/*!
+ * \brief Reference counter for SharedStorage that can be shared between
+ * threads.
+ */
+class AtomicRefCount {
+public:
+  void increment() noexcept { count_m.fetch_add(1, std::memory_order_relaxed); }
+  //! \brief Returns true if it was the last reference
+  auto decrement() noexcept -> bool {
+    return count_m.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  [[nodiscard]] auto isUnique() const noexcept -> bool {
+    return count_m.load(std::memory_order_acquire) == 1;
+  }
+
+private:
+  std::atomic<std::size_t> count_m{1};
+};
+
+/*!
+ * \brief Reference counter for SharedStorage that is used only by one thread
+ * at a time.
+ */
+class LocalRefCount {
+public:
+  void increment() noexcept { ++count_m; }
+  //! \brief Returns true if it was the last reference
+  auto decrement() noexcept -> bool { return --count_m == 0; }
+  [[nodiscard]] auto isUnique() const noexcept -> bool {
+    return count_m == 1;
+  }
+
+private:
+  std::size_t count_m = 1;
+};
+
+namespace impl {
+template <typename RefCount> struct SharedBlockHeader : HeapBlockHeader {
+  //! \brief Initialized here, allocateHeapBlock sets only the allocator
+  RefCount ref_count{};
+};
+} // namespace impl
+
+/*!
+ * \brief
+ * Allocates objects with PolymorphicAllocator and shares them between copies
+ * of Polymorphic using intrusive reference counter(placed before the object).
+ * \details
+ * Copying of Polymorphic only increments the counter. Object is copied when
+ * non-const function is called for Polymorphic, which shares the object with
+ * others(copy-on-write).
+ * `RefCount` is AtomicRefCount or LocalRefCount.
+ *
+ * Additional interface used by Polymorphic:
+ * + `share(other)` - references the object of `other`.
+ * + `release()` - removes reference, returns true if it was the last one.
+ * + `isUnique()` - returns true if nobody else references the object.
+ */
+template <typename RefCount = AtomicRefCount> class SharedStorage {
+  using BlockHeaderT = impl::SharedBlockHeader<RefCount>;
+
+public:
+  static constexpr bool is_owning = true;
+  static constexpr bool is_shared = true;
+  template <typename T> static constexpr bool can_store = true;
+
+  auto allocate(impl::VTableHeader const &header,
+                MemoryResourcePtr resource = {}) -> void * {
+    return obj_p_m = impl::allocateHeapBlock<BlockHeaderT>(header, resource);
+  }
+  void deallocate(impl::VTableHeader const &header) noexcept {
+    impl::deallocateHeapBlock<BlockHeaderT>(obj_p_m, header);
+    obj_p_m = nullptr;
+  }
+  [[nodiscard]] auto resource(impl::VTableHeader const & /*unused*/) const
+      noexcept -> MemoryResourcePtr {
+    return impl::heapBlockResource<BlockHeaderT>(obj_p_m);
+  }
+  template <typename Relocate>
+  void relocateFrom(SharedStorage &other, impl::VTableHeader const & /*unused*/,
+                    Relocate && /*unused*/) noexcept {
+    obj_p_m = std::exchange(other.obj_p_m, nullptr);
+  }
+
+  static constexpr auto
+  isStoredInline(impl::VTableHeader const & /*unused*/) noexcept -> bool {
+    return false;
+  }
+
+  void share(SharedStorage const &other) noexcept {
+    obj_p_m = other.obj_p_m;
+    refCount().increment();
+  }
+  auto release() noexcept -> bool { return refCount().decrement(); }
+  [[nodiscard]] auto isUnique() const noexcept -> bool {
+    return const_cast<SharedStorage *>(this)->refCount().isUnique();
+  }
+
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) noexcept
+      -> void * {
+    return obj_p_m;
+  }
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) const noexcept
+      -> void const * {
+    return obj_p_m;
+  }
+
+private:
+  auto refCount() noexcept -> RefCount & {
+    return impl::heapBlockHeader<BlockHeaderT>(obj_p_m).ref_count;
+  }
+
+  void *obj_p_m = nullptr;
+};
+
+/*!
+ * \brief
+ * Doesn't own the object. Polymorphic with this policy behaves like
+ * PolymorphicPtr, but keeps interface of Polymorphic.
+ * User is responsible for the lifetime of referenced object.
+ */
+class ReferenceStorage {
+public:
+  static constexpr bool is_owning = false;
+  static constexpr bool is_shared = false;
+  template <typename T> static constexpr bool can_store = true;
+
+  template <typename T> void reference(T *obj_p) noexcept {
+    obj_p_m = const_cast<void *>(static_cast<void const *>(obj_p));
+  }
+
+  static constexpr auto
+  isStoredInline(impl::VTableHeader const & /*unused*/) noexcept -> bool {
+    return false;
+  }
+
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) noexcept
+      -> void * {
+    return obj_p_m;
+  }
+  [[nodiscard]] auto data(impl::VTableHeader const & /*unused*/) const noexcept
+      -> void const * {
+    return obj_p_m;
+  }
+
+private:
+  void *obj_p_m = nullptr;
+};
+
+} // namespace plugins
@@ -166,19 +166,48 @@ struct PolymorphicTagSignature<TaggedSignature<TagT, ValueT>> {
 template <typename TagT>
 using PolymorphicTagSignatureT = typename PolymorphicTagSignature<TagT>::Type;
 
-template <std::size_t size, typename... TaggedSignatures>
+/*!
+ * \brief
+ * Trait that can be specialized to place functions of hot tags first in
+ * function tables.
+ * \details
+ * Slots of VTable and PrimitiveVTable are ordered by priority(higher first),
+ * tags with equal priority keep their declaration order. Hot functions then
+ * share cache lines with each other and with the header of the table instead
+ * of being spread over the table of a wide interface. Tables are still
+ * indexed at compile time, so the order only changes the layout.
+ * ```cpp
+ * template <>
+ * struct plugins::VTableSlotPriority<update> : std::integral_constant<int, 1> {};
+ * ```
+ * Priorities can be generated from a call profile with writeSlotPriorities.
+ * The specialization should be visible before any table with the tag is used.
+ */
+template <typename TagT>
+struct VTableSlotPriority : std::integral_constant<int, 0> {};
+
+template <typename TagT>
+struct VTableSlotPriority<Tag<TagT>> : VTableSlotPriority<TagT> {};
+
+template <typename StoragePolicy, typename... TaggedSignatures>
 class UniqueGenericPolymorphic;
 namespace impl {
 template <typename... TaggedSignatures> class PolymorphicPtr;
-template <typename... TaggedSignatures> class PrimitivePolymorphicPtr;
+template <template <typename...> class VTableT, typename... TaggedSignatures>
+class BasicPrimitivePolymorphicPtr;
+template <typename... TaggedSignatures> class IntrusivePolymorphicPtr;
 } // namespace impl
 
 template <typename T> struct IsPolymorphicRef : public std::false_type {};
 template <typename... TaggedSignatures>
 struct IsPolymorphicRef<impl::PolymorphicPtr<TaggedSignatures...>>
     : public std::true_type {};
+template <template <typename...> class VTableT, typename... TaggedSignatures>
+struct IsPolymorphicRef<
+    impl::BasicPrimitivePolymorphicPtr<VTableT, TaggedSignatures...>>
+    : std::true_type {};
 template <typename... TaggedSignatures>
-struct IsPolymorphicRef<impl::PrimitivePolymorphicPtr<TaggedSignatures...>>
+struct IsPolymorphicRef<impl::IntrusivePolymorphicPtr<TaggedSignatures...>>
     : std::true_type {};
 
 template <typename T>
@@ -186,8 +215,8 @@ static constexpr bool is_polymorphic_ref_v = IsPolymorphicRef<T>::value;
 
 template <typename T> struct IsPolymorphic : public std::false_type {};
 
-template <std::size_t size, typename... TaggedSignatures>
-struct IsPolymorphic<UniqueGenericPolymorphic<size, TaggedSignatures...>>
+template <typename StoragePolicy, typename... TaggedSignatures>
+struct IsPolymorphic<UniqueGenericPolymorphic<StoragePolicy, TaggedSignatures...>>
     : public std::true_type {};
 
 template <typename T>
@@ -210,4 +239,26 @@ template <typename PolymorphicType, typename Signature>
 using PolymorphicSignatureT =
     typename PolymorphicSignature<PolymorphicType, Signature>::Type;
 
+template <typename T>
+/*!
+ * \brief
+ * Trait that allows Polymorphic to move objects of type T with memcpy instead
+ * of calling move constructor and destructor.
+ *
+ * \details
+ * Trivially copyable types are trivially relocatable by default. Types that
+ * don't reference their own storage(like most of std::vector or
+ * std::unique_ptr implementations) can opt in:
+ * ```cpp
+ * template<>
+ * struct plugins::IsTriviallyRelocatable<MyType> : std::true_type {};
+ * ```
+ */
+struct IsTriviallyRelocatable
+    : public std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+static constexpr bool is_trivially_relocatable =
+    IsTriviallyRelocatable<T>::value;
+
 } // namespace CxxPlugins
\ No newline at end of file
@@ -0,0 +1,447 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_vector.hpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Contains PolymorphicVector - container that stores polymorphic objects in
+ * contiguous per-type segments.
+ */
+#pragma once
+
+#include "cxx_plugins/polymorphic_allocator.hpp"
+#include "cxx_plugins/polymorphic_ptr.hpp"
+#include "cxx_plugins/vector.hpp"
+#include "cxx_plugins/vtable.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace plugins {
+
+namespace impl {
+
+template <typename Signature> struct BatchTrampolineType;
+template <typename Signature>
+using BatchTrampolineTypeT = typename BatchTrampolineType<Signature>::Type;
+
+template <typename Return, typename... Args>
+struct BatchTrampolineType<Return(Args...)> {
+  using Type = void (*)(void *, std::size_t, Args...);
+  static constexpr bool has_rvalue_references =
+      (std::is_rvalue_reference_v<Args> || ...);
+};
+
+template <typename Return, typename... Args>
+struct BatchTrampolineType<Return(Args...) const> {
+  using Type = void (*)(void const *, std::size_t, Args...);
+  static constexpr bool has_rvalue_references =
+      (std::is_rvalue_reference_v<Args> || ...);
+};
+
+/*!
+ * \brief
+ * Arguments of batch trampoline are passed to every object, so they can't be
+ * moved. Tags with rvalue references can be stored, but `forEach` rejects
+ * them.
+ */
+template <typename Arg> using BatchArgT = std::remove_reference_t<Arg> &;
+
+template <typename Tag, typename T, typename Signature> struct BatchTrampoline;
+
+template <typename Tag, typename T, typename Return, typename... Args>
+struct BatchTrampoline<Tag, T, Return(Args...)> {
+  static void call(void *first_p, std::size_t count, Args... args) {
+    // never called for rvalue references, see forEach
+    if constexpr (!(std::is_rvalue_reference_v<Args> || ...)) {
+      auto *obj_p = static_cast<T *>(first_p);
+      for (std::size_t i = 0; i < count; ++i) {
+        polymorphicExtend(Tag{}, obj_p[i],
+                          static_cast<BatchArgT<Args>>(args)...);
+      }
+    }
+  }
+};
+
+template <typename Tag, typename T, typename Return, typename... Args>
+struct BatchTrampoline<Tag, T, Return(Args...) const> {
+  static void call(void const *first_p, std::size_t count, Args... args) {
+    // never called for rvalue references, see forEach
+    if constexpr (!(std::is_rvalue_reference_v<Args> || ...)) {
+      auto const *obj_p = static_cast<T const *>(first_p);
+      for (std::size_t i = 0; i < count; ++i) {
+        polymorphicExtend(Tag{}, obj_p[i],
+                          static_cast<BatchArgT<Args>>(args)...);
+      }
+    }
+  }
+};
+
+template <typename T, typename... TaggedSignatures> struct BatchVTableStorage;
+
+/*!
+ * \brief
+ * Same as VTableStorage, but every function calls tag for a range of objects
+ * of type T.
+ */
+template <typename T, typename... Tags, typename... Signatures>
+struct BatchVTableStorage<T, TaggedSignature<Tags, Signatures>...> {
+  static constexpr std::size_t size =
+      sizeof...(Tags) == 0 ? 1 : sizeof...(Tags);
+
+  using FunctionPtrT = FnPtr<void()>;
+
+  static constexpr FunctionArray<
+      size, decltype(&BatchTrampoline<Tags, T, Signatures>::call)...>
+      functions = {{&BatchTrampoline<Tags, T, Signatures>::call...}};
+
+  static constexpr FunctionPtrT const *value = functions.erased;
+};
+
+template <typename T>
+void relocateRange(void *dst_p, void *src_p, std::size_t count) noexcept {
+  auto *typed_dst_p = static_cast<T *>(dst_p);
+  auto *typed_src_p = static_cast<T *>(src_p);
+  for (std::size_t i = 0; i < count; ++i) {
+    new (typed_dst_p + i) T(std::move(typed_src_p[i]));
+    typed_src_p[i].~T();
+  }
+}
+
+template <typename T> void destroyRange(void *first_p, std::size_t count) noexcept {
+  auto *obj_p = static_cast<T *>(first_p);
+  std::destroy(obj_p, obj_p + count);
+}
+
+} // namespace impl
+
+template <typename... TaggedSignatures> class GenericPolymorphicVector;
+
+/*!
+ * \brief
+ * Container for polymorphic objects.
+ * \details
+ * Objects of the same type are stored contiguously in one segment, so
+ * `forEach<Tag>(args...)` makes only one indirect call per type and then
+ * calls `polymorphicExtend` directly in a loop.
+ * Elements are accessed with `PolymorphicPtr<Ts...>` views.
+ * ```cpp
+ * PolymorphicVector<update, draw> objects;
+ * objects.pushBack(Player{});
+ * objects.pushBack(Enemy{});
+ * objects.forEach<update>(delta_time);
+ * for (auto obj : objects) {
+ *   obj.call<draw>();
+ * }
+ * ```
+ * \note Order of elements is not preserved between segments.
+ */
+template <typename... Ts>
+using PolymorphicVector = std::conditional_t<
+    (is_tagged_signature<Ts> && ...), GenericPolymorphicVector<Ts...>,
+    GenericPolymorphicVector<
+        TaggedSignature<Ts, PolymorphicTagSignatureT<Ts>>...>>;
+
+#ifdef DOXYGEN
+template <typename... TaggedSignatures>
+class GenericPolymorphicVector
+#else
+template <typename... Tags, typename... Signatures>
+class GenericPolymorphicVector<TaggedSignature<Tags, Signatures>...>
+#endif
+{
+public:
+  //! \brief View type for the elements
+  using PointerT = impl::PolymorphicPtr<TaggedSignature<Tags, Signatures>...>;
+  using FunctionTableT = typename PointerT::FunctionTableT;
+
+private:
+  template <typename T>
+  using StorageT = VTableStorage<T, TaggedSignature<
+      Tags, PolymorphicSignatureT<PointerT, Signatures>>...>;
+  template <typename T>
+  using BatchStorageT = impl::BatchVTableStorage<
+      T, TaggedSignature<Tags, PolymorphicSignatureT<PointerT, Signatures>>...>;
+
+  struct Segment {
+    //! \brief `StorageT<T>::value`, used to find segment of the type
+    FnPtr<void()> const *key;
+    FunctionTableT function_table;
+    FnPtr<void()> const *batch_table_p;
+    void (*relocate)(void *, void *, std::size_t) noexcept;
+    void (*destroy)(void *, std::size_t) noexcept;
+    std::byte *data_p = nullptr;
+    std::size_t size = 0;
+    std::size_t capacity = 0;
+
+    [[nodiscard]] auto at(std::size_t i) const noexcept -> std::byte * {
+      return data_p + i * function_table.header().size;
+    }
+  };
+
+  using SegmentsT = Vector<Segment>;
+
+public:
+  /*!
+   * \brief Forward iterator over all elements, segment by segment.
+   * \details
+   * Const iterator yields const views, so only const tags can be called
+   * through them(like `T *const`, a copy of the view isn't const).
+   */
+  template <bool is_const> class BasicIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = PointerT;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::conditional_t<is_const, PointerT const, PointerT>;
+
+    constexpr BasicIterator() noexcept = default;
+
+    auto operator*() const noexcept -> reference {
+      auto const &segment = (*segments_p_m)[segment_m];
+      return PointerT(segment.at(index_m), segment.function_table);
+    }
+
+    auto operator++() noexcept -> BasicIterator & {
+      ++index_m;
+      skipFinishedSegments();
+      return *this;
+    }
+    auto operator++(int) noexcept -> BasicIterator {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    auto operator==(BasicIterator const &rhs) const noexcept -> bool {
+      return segment_m == rhs.segment_m && index_m == rhs.index_m;
+    }
+    auto operator!=(BasicIterator const &rhs) const noexcept -> bool {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class GenericPolymorphicVector;
+
+    BasicIterator(SegmentsT const *segments_p, std::size_t segment) noexcept
+        : segments_p_m(segments_p), segment_m(segment) {
+      skipFinishedSegments();
+    }
+
+    void skipFinishedSegments() noexcept {
+      while (segment_m < segments_p_m->size() &&
+             index_m >= (*segments_p_m)[segment_m].size) {
+        ++segment_m;
+        index_m = 0;
+      }
+    }
+
+    SegmentsT const *segments_p_m = nullptr;
+    std::size_t segment_m = 0;
+    std::size_t index_m = 0;
+  };
+
+  using iterator = BasicIterator<false>;
+  using const_iterator = BasicIterator<true>;
+
+  GenericPolymorphicVector() = default;
+  explicit GenericPolymorphicVector(
+      PolymorphicAllocator<std::byte> const &allocator) noexcept
+      : allocator_m(allocator) {}
+  GenericPolymorphicVector(GenericPolymorphicVector const &) = delete;
+  GenericPolymorphicVector(GenericPolymorphicVector &&rhs) noexcept
+      : allocator_m(rhs.allocator_m), segments_m(std::move(rhs.segments_m)),
+        size_m(std::exchange(rhs.size_m, 0)) {
+    rhs.segments_m.clear();
+  }
+  auto operator=(GenericPolymorphicVector const &)
+      -> GenericPolymorphicVector & = delete;
+  auto operator=(GenericPolymorphicVector &&rhs) noexcept
+      -> GenericPolymorphicVector & {
+    if (this == &rhs)
+      return *this;
+    clear();
+    deallocateSegments();
+    allocator_m = rhs.allocator_m;
+    segments_m = std::move(rhs.segments_m);
+    size_m = std::exchange(rhs.size_m, 0);
+    rhs.segments_m.clear();
+    return *this;
+  }
+
+  ~GenericPolymorphicVector() {
+    clear();
+    deallocateSegments();
+  }
+
+  /*!
+   * \brief Copies or moves object into the segment of its type.
+   * \return View to the inserted object. It is invalidated when another object
+   * of the same type is inserted.
+   */
+  template <typename T, typename = std::enable_if_t<
+                            !is_polymorphic_ref_v<std::decay_t<T>> &&
+                            !is_polymorphic_v<std::decay_t<T>>>>
+  auto pushBack(T &&obj) -> PointerT {
+    return emplaceBack(std::in_place_type_t<std::decay_t<T>>{},
+                       std::forward<T>(obj));
+  }
+
+  //! \brief Constructs object of type T in place
+  template <typename T, typename... Args>
+  auto emplaceBack(std::in_place_type_t<T> /*unused*/, Args &&... args)
+      -> PointerT {
+    static_assert(std::is_same_v<T, std::decay_t<T>>,
+                  "PolymorphicVector stores only object types");
+    static_assert(std::is_move_constructible_v<T>,
+                  "Objects of PolymorphicVector should be move constructible");
+    auto &segment = segmentFor<T>();
+    if (segment.size == segment.capacity) {
+      grow(segment, std::max<std::size_t>(segment.capacity * 2, 4));
+    }
+    auto *obj_p = new (segment.at(segment.size)) T(std::forward<Args>(args)...);
+    ++segment.size;
+    ++size_m;
+    return PointerT(obj_p, segment.function_table);
+  }
+
+  //! \brief Reserves space for `count` objects of type T
+  template <typename T> void reserve(std::size_t count) {
+    auto &segment = segmentFor<T>();
+    if (segment.capacity < count) {
+      grow(segment, count);
+    }
+  }
+
+  /*!
+   * \brief Calls TagT for every element.
+   * \details
+   * Makes one indirect call per segment. Arguments are passed to every
+   * element, so they are never moved.
+   */
+  template <typename TagT, typename... Us> void forEach(Us &&... args) {
+    static_assert(!impl::BatchTrampolineType<
+                      SignatureAt<TagT>>::has_rvalue_references,
+                  "PolymorphicVector::forEach passes the same arguments to "
+                  "every element, so tag can't take rvalue references");
+    using FunctionT = impl::BatchTrampolineTypeT<SignatureAt<TagT>>;
+    for (auto &segment : segments_m) {
+      if (segment.size == 0)
+        continue;
+      auto fn_p = reinterpret_cast<FunctionT>(
+          segment.batch_table_p[traits::index_of<TagT, Tags...>]);
+      fn_p(segment.data_p, segment.size, args...);
+    }
+  }
+
+  template <typename TagT, typename... Us> void forEach(Us &&... args) const {
+    static_assert(traits::FunctionTraits<SignatureAt<TagT>>::is_const,
+                  "Only const tags can be called for const PolymorphicVector");
+    static_assert(!impl::BatchTrampolineType<
+                      SignatureAt<TagT>>::has_rvalue_references,
+                  "PolymorphicVector::forEach passes the same arguments to "
+                  "every element, so tag can't take rvalue references");
+    using FunctionT = impl::BatchTrampolineTypeT<SignatureAt<TagT>>;
+    for (auto const &segment : segments_m) {
+      if (segment.size == 0)
+        continue;
+      auto fn_p = reinterpret_cast<FunctionT>(
+          segment.batch_table_p[traits::index_of<TagT, Tags...>]);
+      fn_p(static_cast<void const *>(segment.data_p), segment.size, args...);
+    }
+  }
+
+  [[nodiscard]] auto begin() noexcept -> iterator {
+    return iterator(&segments_m, 0);
+  }
+  [[nodiscard]] auto end() noexcept -> iterator {
+    return iterator(&segments_m, segments_m.size());
+  }
+  [[nodiscard]] auto begin() const noexcept -> const_iterator {
+    return const_iterator(&segments_m, 0);
+  }
+  [[nodiscard]] auto end() const noexcept -> const_iterator {
+    return const_iterator(&segments_m, segments_m.size());
+  }
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t { return size_m; }
+  [[nodiscard]] auto isEmpty() const noexcept -> bool { return size_m == 0; }
+  //! \brief Returns number of different types that were stored in the vector
+  [[nodiscard]] auto segmentCount() const noexcept -> std::size_t {
+    return segments_m.size();
+  }
+
+  //! \brief Destroys all objects, but keeps allocated memory
+  void clear() noexcept {
+    for (auto &segment : segments_m) {
+      segment.destroy(segment.data_p, segment.size);
+      segment.size = 0;
+    }
+    size_m = 0;
+  }
+
+private:
+  template <typename TagT>
+  using SignatureAt =
+      traits::ElementType<traits::index_of<TagT, Tags...>,
+                           PolymorphicSignatureT<PointerT, Signatures>...>;
+
+  template <typename T> auto segmentFor() -> Segment & {
+    auto const *key = StorageT<T>::value;
+    // usually there are only a few types and objects of the same type are
+    // inserted together, so linear search from the end is fast enough
+    auto it = std::find_if(
+        segments_m.rbegin(), segments_m.rend(),
+        [key](Segment const &segment) { return segment.key == key; });
+    if (it != segments_m.rend()) {
+      return *it;
+    }
+    Segment segment{key, FunctionTableT{std::in_place_type_t<T>{}},
+                    BatchStorageT<T>::value, &impl::relocateRange<T>,
+                    &impl::destroyRange<T>};
+    return segments_m.emplace_back(segment);
+  }
+
+  void grow(Segment &segment, std::size_t capacity) {
+    auto const &header = segment.function_table.header();
+    auto *data_p = static_cast<std::byte *>(
+        allocator_m.allocate_bytes(capacity * header.size, header.alignment));
+    if (segment.data_p != nullptr) {
+      if (header.is_trivially_relocatable) {
+        std::memcpy(data_p, segment.data_p, segment.size * header.size);
+      } else {
+        segment.relocate(data_p, segment.data_p, segment.size);
+      }
+      allocator_m.deallocate_bytes(segment.data_p,
+                                   segment.capacity * header.size,
+                                   header.alignment);
+    }
+    segment.data_p = data_p;
+    segment.capacity = capacity;
+  }
+
+  void deallocateSegments() noexcept {
+    for (auto &segment : segments_m) {
+      if (segment.data_p != nullptr) {
+        auto const &header = segment.function_table.header();
+        allocator_m.deallocate_bytes(segment.data_p,
+                                   segment.capacity * header.size,
+                                   header.alignment);
+      }
+    }
+    segments_m.clear();
+  }
+
+  PolymorphicAllocator<std::byte> allocator_m;
+  SegmentsT segments_m;
+  std::size_t size_m = 0;
+};
+
+} // namespace plugins
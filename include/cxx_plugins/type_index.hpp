@@ -15,112 +15,175 @@
 
 #include <boost/type_index/ctti_type_index.hpp>
 
+#include <array>
 #include <cstdint>
-#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace plugins {
 
 namespace impl {
 
-static constexpr std::size_t type_index_static_buffer_size = 64;
-
 using inner_type_index = boost::typeindex::ctti_type_index;
 
+//! \brief FNV-1a hash of `value`
+constexpr auto fnv1a(std::string_view value) noexcept -> std::uint64_t {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (char c : value) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
 struct TypeInfo {
   char const *const type_m;
   std::uint64_t size_m;
+  /*!
+   * \brief
+   * Hash of the normalized name, so it is the same in every library and every
+   * run. Types are compared by it, names are used only for diagnostics.
+   */
+  std::uint64_t id_m;
 
-  explicit operator std::string_view() const {
+  constexpr explicit operator std::string_view() const {
     return std::string_view(type_m, size_m);
   }
 };
 
-template <typename T>
-inline auto typeInfoConstruct() noexcept -> const TypeInfo & {
+/*!
+ * \brief
+ * Returns TypeInfo with the given name that is shared by every library of the
+ * process.
+ * \details
+ * The first call for a name copies it into the registry of `cxx_plugins`
+ * library, so returned info stays valid even if the library that registered
+ * it is unloaded. Thread safe.
+ */
+auto internTypeInfo(std::string_view name) -> TypeInfo const &;
+
+//! \brief Returns interned info with the name of `info`
+inline auto internTypeInfo(TypeInfo const &info) -> TypeInfo const & {
+  return internTypeInfo(static_cast<std::string_view>(info));
+}
 
-  constexpr auto pretty_name = [](const char *raw_name, std::size_t len,
-                                  std::pmr::memory_resource *resource) {
-    std::pmr::string out(resource);
-    while (raw_name[len - 1] == ' ') {
-      --len; // MSVC sometimes adds whitespaces
+//! \brief Function whose signature contains the name of `T`
+template <typename T> struct TypeNameProbe {
+  static constexpr auto signature() noexcept -> char const * {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return __FUNCSIG__;
+#else
+    return __PRETTY_FUNCTION__;
+#endif
+  }
+};
+
+// Position of the type in the signature is found with a known type
+static constexpr std::string_view type_name_probe =
+    TypeNameProbe<double>::signature();
+static constexpr std::size_t type_name_prefix_size =
+    type_name_probe.rfind("double");
+static constexpr std::size_t type_name_suffix_size =
+    type_name_probe.size() - type_name_prefix_size -
+    std::string_view("double").size();
+
+constexpr auto isIdentifierChar(char c) noexcept -> bool {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+/*!
+ * \brief
+ * Copies `name` to `out_p` without `struct `/`class `/`enum `/`union `
+ * keywords(MSVC adds them) and trailing whitespaces.
+ * \details
+ * If `out_p` is nullptr nothing is written.
+ * \returns size of normalized name
+ */
+constexpr auto normalizeTypeName(std::string_view name, char *out_p) noexcept
+    -> std::size_t {
+  constexpr std::string_view keywords[] = {"struct ", "class ", "enum ",
+                                           "union "};
+  while (!name.empty() && name.back() == ' ') {
+    name.remove_suffix(1);
+  }
+  std::size_t size = 0;
+  std::size_t i = 0;
+  while (i < name.size()) {
+    if (i == 0 || !isIdentifierChar(name[i - 1])) {
+      bool skipped = false;
+      for (auto keyword : keywords) {
+        if (name.substr(i, keyword.size()) == keyword) {
+          i += keyword.size();
+          skipped = true;
+          break;
+        }
+      }
+      if (skipped) {
+        continue;
+      }
     }
-    return std::pmr::string(raw_name, len);
-  };
-  boost::typeindex::ctti_type_index::type_id<void>().pretty_name();
-
-  constexpr auto replace_all = [](std::pmr::string &input,
-                                  std::pmr::string const &substr,
-                                  std::pmr::string const &with) {
-    auto pos = input.find(substr);
-    while (pos != std::pmr::string::npos) {
-      input.replace(pos, substr.size(), with);
-      pos = input.find(substr);
+    if (out_p != nullptr) {
+      out_p[size] = name[i];
     }
-  };
-
-  constexpr auto format = [replace_all](std::pmr::string const &str) {
-    std::pmr::string out = str;
-    replace_all(out, "struct ", "");
-    replace_all(out, "class ", "");
-    return out;
-  };
-
-  static std::byte buffer[type_index_static_buffer_size];
-  static std::pmr::monotonic_buffer_resource resource(std::data(buffer),
-                                                      std::size(buffer));
-
-  static const std::pmr::string type =
-      format(pretty_name(inner_type_index::type_id<T>().raw_name(),
-                         strlen(inner_type_index::type_id<T>().raw_name() +
-                         boost::typeindex::detail::ctti_skip_size_at_end),
-                         &resource));
-  static const TypeInfo info{type.c_str(), type.size()};
-
-  return info;
+    ++size;
+    ++i;
+  }
+  return size;
+}
+
+/*!
+ * \brief
+ * Normalized name of `T`(with cv and reference qualifiers) that is computed at
+ * compile time.
+ */
+template <typename T> struct TypeName {
+private:
+  static constexpr std::string_view raw_name = [] {
+    std::string_view signature = TypeNameProbe<T>::signature();
+    signature.remove_prefix(type_name_prefix_size);
+    signature.remove_suffix(type_name_suffix_size);
+    return signature;
+  }();
+
+  static constexpr std::size_t size = normalizeTypeName(raw_name, nullptr);
+
+  // null terminated, so it can be used as `char const*`
+  static constexpr std::array<char, size + 1> storage = [] {
+    std::array<char, size + 1> result = {};
+    normalizeTypeName(raw_name, result.data());
+    return result;
+  }();
+
+public:
+  static constexpr std::string_view value{storage.data(), size};
+};
+
+template <typename T> static constexpr std::string_view type_name_v =
+    TypeName<T>::value;
+
+/*!
+ * \brief
+ * TypeInfo of `T` that is constant initialized, so using it never needs
+ * initialization guards.
+ * \details
+ * Every library has its own info, so infos are compared by id if addresses
+ * differ. The info lives only as long as the library that uses it, registries
+ * that keep types after that store internTypeInfo of it.
+ */
+template <typename T>
+inline constexpr TypeInfo type_info_v = {
+    type_name_v<T>.data(), type_name_v<T>.size(), fnv1a(type_name_v<T>)};
+
+template <typename T>
+constexpr auto typeInfoConstruct() noexcept -> const TypeInfo & {
+  return type_info_v<std::remove_cv_t<std::remove_reference_t<T>>>;
 }
 
 template <typename T>
-inline auto typeInfoConstructWithCVR() noexcept -> const TypeInfo & {
-  constexpr auto pretty_name = [](const char *raw_name, std::size_t len,
-                                  std::pmr::memory_resource *resource) {
-    std::pmr::string out(resource);
-    while (raw_name[len - 1] == ' ') {
-      --len; // MSVC sometimes adds whitespaces
-    }
-    return std::pmr::string(raw_name, len);
-  };
-  boost::typeindex::ctti_type_index::type_id<void>().pretty_name();
-
-  constexpr auto replace_all = [](std::pmr::string &input,
-                                  std::pmr::string const &substr,
-                                  std::pmr::string const &with) {
-    auto pos = input.find(substr);
-    while (pos != std::pmr::string::npos) {
-      input.replace(pos, substr.size(), with);
-      pos = input.find(substr);
-    }
-  };
-
-  constexpr auto format = [replace_all](std::pmr::string const &str) {
-    std::pmr::string out = str;
-    replace_all(out, "struct ", "");
-    replace_all(out, "class ", "");
-    return out;
-  };
-
-  static std::byte buffer[type_index_static_buffer_size];
-  static std::pmr::monotonic_buffer_resource resource(std::data(buffer),
-                                                      std::size(buffer));
-
-  static const std::pmr::string type =
-      format(pretty_name(inner_type_index::type_id_with_cvr<T>().raw_name(),
-                         strlen(inner_type_index::type_id<T>().raw_name() +
-                                boost::typeindex::detail::ctti_skip_size_at_end),
-                         &resource));
-  static const TypeInfo info{type.c_str(), type.size()};
-
-  return info;
+constexpr auto typeInfoConstructWithCVR() noexcept -> const TypeInfo & {
+  return type_info_v<T>;
 }
 } // namespace impl
 
@@ -144,8 +207,33 @@ public:
   [[nodiscard]] inline auto name() const noexcept -> const char* {
     return data_m->type_m;
   }
-  [[nodiscard]] inline auto pretty_name() const noexcept -> std::string {
-    return std::string(data_m->type_m, data_m->size_m);
+  //! \brief Returns name without copying it(names are never freed)
+  [[nodiscard]] constexpr auto pretty_name() const noexcept
+      -> std::string_view {
+    return std::string_view(data_m->type_m, data_m->size_m);
+  }
+  //! \brief Returns 64-bit id of the type that is stable across libraries
+  [[nodiscard]] constexpr auto id() const noexcept -> std::uint64_t {
+    return data_m->id_m;
+  }
+  /*!
+   * \brief Compares types by id(address of TypeInfo is checked first).
+   * \details
+   * Infos of the same type from different libraries are different objects,
+   * but they have equal ids. Ids are 64-bit hashes of names, so collisions
+   * aren't checked.
+   */
+  [[nodiscard]] inline auto equal(type_index const &rhs) const noexcept
+      -> bool {
+    return data_m == rhs.data_m || data_m->id_m == rhs.data_m->id_m;
+  }
+  //! \brief Orders types by id, which is consistent with equal
+  [[nodiscard]] inline auto before(type_index const &rhs) const noexcept
+      -> bool {
+    return data_m->id_m < rhs.data_m->id_m;
+  }
+  [[nodiscard]] inline auto hash_code() const noexcept -> std::size_t {
+    return static_cast<std::size_t>(data_m->id_m);
   }
   template <typename T> static inline auto type_id() noexcept -> type_index {
     return type_index(impl::typeInfoConstruct<T>());
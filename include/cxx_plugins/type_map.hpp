@@ -0,0 +1,506 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    type_map.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains TypeMap and StaticTypeMap - maps from types to values for
+ * registries(service locators, per type pools, factories).
+ *
+ * \details
+ * Both are keyed by 64-bit type ids, so keys are the same in every plugin and
+ * no names are hashed or compared:
+ * ```cpp
+ * TypeMap<Factory> factories;
+ * factories.tryEmplace<Circle>(&makeCircle);
+ * if (auto *factory_p = factories.find(type)) { ... }
+ * ```
+ */
+#pragma once
+
+#include "cxx_plugins/definitions.hpp"
+#include "cxx_plugins/polymorphic_allocator.hpp"
+#include "cxx_plugins/type_index.hpp"
+#include "cxx_plugins/vector.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace plugins {
+
+namespace impl {
+/*!
+ * \brief
+ * Eight control bytes of TypeMap that are matched at once, as bytes of one
+ * 64-bit word.
+ * \details
+ * Full slots keep 7 low bits of the id(high bit is 0), empty and deleted
+ * slots have the high bit set.
+ */
+class ControlGroup {
+public:
+  static constexpr std::size_t width = 8;
+  static constexpr std::uint8_t empty = 0x80;
+  static constexpr std::uint8_t deleted = 0xFE;
+
+  explicit ControlGroup(std::uint8_t const *control_p) noexcept {
+    std::memcpy(&bytes_m, control_p, width);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    bytes_m = __builtin_bswap64(bytes_m);
+#endif
+  }
+
+  /*!
+   * \brief Returns high bits of bytes that are equal to `value`.
+   * \details
+   * Bytes after a match can be reported falsely, so every match is checked
+   * by the caller. The lowest match is always right.
+   */
+  [[nodiscard]] auto match(std::uint8_t value) const noexcept
+      -> std::uint64_t {
+    auto const bytes = bytes_m ^ (low_bits * value);
+    return (bytes - low_bits) & ~bytes & high_bits;
+  }
+
+  [[nodiscard]] auto matchEmpty() const noexcept -> std::uint64_t {
+    // bit 1 distinguishes empty from deleted
+    return bytes_m & ~(bytes_m << 6U) & high_bits;
+  }
+
+  [[nodiscard]] auto matchEmptyOrDeleted() const noexcept -> std::uint64_t {
+    return bytes_m & high_bits;
+  }
+
+  //! \brief Returns index of the byte of the lowest match in `mask`
+  static auto lowestIndex(std::uint64_t mask) noexcept -> std::size_t {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward64(&index, mask);
+    return index / 8;
+#else
+    return static_cast<std::size_t>(__builtin_ctzll(mask)) / 8;
+#endif
+  }
+
+private:
+  static constexpr std::uint64_t low_bits = 0x0101010101010101ULL;
+  static constexpr std::uint64_t high_bits = 0x8080808080808080ULL;
+
+  std::uint64_t bytes_m = 0;
+};
+
+/*!
+ * \brief
+ * Returns index of the type that is the same in every library, indices are
+ * assigned in order of first use. Thread safe.
+ */
+auto denseTypeIndex(TypeInfo const &info) -> std::size_t;
+
+template <typename T> auto denseTypeIndex() -> std::size_t {
+  static std::size_t const index = denseTypeIndex(typeInfoConstruct<T>());
+  return index;
+}
+} // namespace impl
+
+/*!
+ * \brief
+ * Flat hash map from types to values, replacement of
+ * `UnorderedMap<type_index, V>`.
+ * \details
+ * Open addressing without nodes: control bytes, keys and values are kept in
+ * separate arrays, and control bytes are probed in groups of 8 at once with
+ * word-wide bit operations. Ids are already hashes, so they aren't hashed
+ * again: 7 bits are stored in the control byte, the rest selects the first
+ * group. Load factor is at most 7/8.
+ *
+ * Values are constructed with the allocator(uses-allocator construction), so
+ * containers of `cxx_plugins` inside of values use it as well. Insertion and
+ * erasure invalidate pointers to values.
+ */
+template <typename V> class TypeMap {
+public:
+  TypeMap() = default;
+  explicit TypeMap(PolymorphicAllocator<std::byte> const &allocator) noexcept
+      : allocator_m(allocator) {}
+  TypeMap(TypeMap const &) = delete;
+  TypeMap(TypeMap &&rhs) noexcept
+      : allocator_m(rhs.allocator_m),
+        control_p_m(std::exchange(rhs.control_p_m, nullptr)),
+        keys_p_m(std::exchange(rhs.keys_p_m, nullptr)),
+        values_p_m(std::exchange(rhs.values_p_m, nullptr)),
+        capacity_m(std::exchange(rhs.capacity_m, 0)),
+        size_m(std::exchange(rhs.size_m, 0)),
+        growth_left_m(std::exchange(rhs.growth_left_m, 0)) {}
+  auto operator=(TypeMap const &) -> TypeMap & = delete;
+  //! \brief Takes storage of `rhs` if allocators are equal, moves values otherwise
+  auto operator=(TypeMap &&rhs) -> TypeMap & {
+    if (this == &rhs)
+      return *this;
+    clear();
+    if (allocator_m == rhs.allocator_m) {
+      deallocate();
+      control_p_m = std::exchange(rhs.control_p_m, nullptr);
+      keys_p_m = std::exchange(rhs.keys_p_m, nullptr);
+      values_p_m = std::exchange(rhs.values_p_m, nullptr);
+      capacity_m = std::exchange(rhs.capacity_m, 0);
+      size_m = std::exchange(rhs.size_m, 0);
+      growth_left_m = std::exchange(rhs.growth_left_m, 0);
+    } else {
+      reserve(rhs.size());
+      rhs.forEach([this](type_index type, V &value) {
+        tryEmplace(type, std::move(value));
+      });
+      rhs.clear();
+    }
+    return *this;
+  }
+
+  ~TypeMap() {
+    clear();
+    deallocate();
+  }
+
+  //! \brief Returns value of the type or nullptr
+  [[nodiscard]] auto find(type_index type) noexcept -> V * {
+    auto const slot = findSlot(type.id());
+    return slot == npos ? nullptr : values_p_m + slot;
+  }
+  [[nodiscard]] auto find(type_index type) const noexcept -> V const * {
+    auto const slot = findSlot(type.id());
+    return slot == npos ? nullptr : values_p_m + slot;
+  }
+  template <typename T> [[nodiscard]] auto find() noexcept -> V * {
+    return find(type_id<T>());
+  }
+  template <typename T>
+  [[nodiscard]] auto find() const noexcept -> V const * {
+    return find(type_id<T>());
+  }
+
+  [[nodiscard]] auto contains(type_index type) const noexcept -> bool {
+    return findSlot(type.id()) != npos;
+  }
+  template <typename T>
+  [[nodiscard]] auto contains() const noexcept -> bool {
+    return contains(type_id<T>());
+  }
+
+  /*!
+   * \brief Constructs value of the type from `args` if there is none.
+   * \returns Value of the type and whether it was inserted
+   */
+  template <typename... Args>
+  auto tryEmplace(type_index type, Args &&... args) -> std::pair<V *, bool> {
+    auto const id = type.id();
+    auto slot = findSlot(id);
+    if (slot != npos) {
+      return {values_p_m + slot, false};
+    }
+    // info of the library that inserted the value can be unloaded before it
+    auto const *info_p = &impl::internTypeInfo(type.type_info());
+    if (growth_left_m == 0) {
+      // a table with many deleted slots is cleaned up without growing
+      rehash(size_m + 1 > capacity_m * 7 / 16 ? nextCapacity(capacity_m)
+                                              : capacity_m);
+    }
+    slot = findFreeSlot(id);
+    allocator_m.construct(values_p_m + slot, std::forward<Args>(args)...);
+    if (control_p_m[slot] == impl::ControlGroup::empty) {
+      --growth_left_m;
+    }
+    control_p_m[slot] = controlByte(id);
+    keys_p_m[slot] = Key{id, info_p};
+    ++size_m;
+    return {values_p_m + slot, true};
+  }
+  template <typename T, typename... Args>
+  auto tryEmplace(Args &&... args) -> std::pair<V *, bool> {
+    return tryEmplace(type_id<T>(), std::forward<Args>(args)...);
+  }
+
+  //! \brief Removes value of the type, returns false if there was none
+  auto erase(type_index type) noexcept -> bool {
+    auto const slot = findSlot(type.id());
+    if (slot == npos) {
+      return false;
+    }
+    values_p_m[slot].~V();
+    // probes stop at groups with empty slots, so such slot can become empty
+    auto const group = slot - slot % impl::ControlGroup::width;
+    if (impl::ControlGroup(control_p_m + group).matchEmpty() != 0) {
+      control_p_m[slot] = impl::ControlGroup::empty;
+      ++growth_left_m;
+    } else {
+      control_p_m[slot] = impl::ControlGroup::deleted;
+    }
+    --size_m;
+    return true;
+  }
+  template <typename T> auto erase() noexcept -> bool {
+    return erase(type_id<T>());
+  }
+
+  //! \brief Calls `function(type_index, V &)` for every value
+  template <typename Function> void forEach(Function &&function) {
+    for (std::size_t slot = 0; slot < capacity_m; ++slot) {
+      if (isFull(slot)) {
+        function(type_index(*keys_p_m[slot].info_p), values_p_m[slot]);
+      }
+    }
+  }
+  template <typename Function> void forEach(Function &&function) const {
+    for (std::size_t slot = 0; slot < capacity_m; ++slot) {
+      if (isFull(slot)) {
+        function(type_index(*keys_p_m[slot].info_p),
+                 static_cast<V const &>(values_p_m[slot]));
+      }
+    }
+  }
+
+  //! \brief Makes space for `count` values, so they are inserted without rehash
+  void reserve(std::size_t count) {
+    auto capacity = capacity_m;
+    while (count > capacity * 7 / 8) {
+      capacity = nextCapacity(capacity);
+    }
+    if (capacity != capacity_m) {
+      rehash(capacity);
+    }
+  }
+
+  void clear() noexcept {
+    for (std::size_t slot = 0; slot < capacity_m; ++slot) {
+      if (isFull(slot)) {
+        values_p_m[slot].~V();
+      }
+      control_p_m[slot] = impl::ControlGroup::empty;
+    }
+    size_m = 0;
+    growth_left_m = capacity_m * 7 / 8;
+  }
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t { return size_m; }
+  [[nodiscard]] auto isEmpty() const noexcept -> bool { return size_m == 0; }
+  [[nodiscard]] auto capacity() const noexcept -> std::size_t {
+    return capacity_m;
+  }
+
+private:
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+  //! \brief Returned by visitors of probe to check the next group
+  static constexpr std::size_t keep_probing = npos - 1;
+  static constexpr std::size_t id_control_bits = 7;
+
+  /*!
+   * \brief Id is copied from the info, so probing doesn't dereference it.
+   * \details Info is interned, so it outlives libraries that inserted types.
+   */
+  struct Key {
+    std::uint64_t id;
+    impl::TypeInfo const *info_p;
+  };
+
+  static constexpr auto controlByte(std::uint64_t id) noexcept
+      -> std::uint8_t {
+    return static_cast<std::uint8_t>(id & 0x7FU);
+  }
+
+  static constexpr auto nextCapacity(std::size_t capacity) noexcept
+      -> std::size_t {
+    return capacity == 0 ? impl::ControlGroup::width : capacity * 2;
+  }
+
+  [[nodiscard]] auto isFull(std::size_t slot) const noexcept -> bool {
+    return (control_p_m[slot] & 0x80U) == 0;
+  }
+
+  [[nodiscard]] auto firstGroup(std::uint64_t id) const noexcept
+      -> std::size_t {
+    auto const group_count = capacity_m / impl::ControlGroup::width;
+    return static_cast<std::size_t>(id >> id_control_bits) & (group_count - 1);
+  }
+
+  //! \brief Probes groups quadratically(by group), visits every group
+  template <typename Visitor>
+  auto probe(std::uint64_t id, Visitor &&visitor) const noexcept
+      -> std::size_t {
+    auto const group_mask = capacity_m / impl::ControlGroup::width - 1;
+    auto group = firstGroup(id);
+    for (std::size_t step = 1;; ++step) {
+      auto const first_slot = group * impl::ControlGroup::width;
+      auto const result =
+          visitor(impl::ControlGroup(control_p_m + first_slot), first_slot);
+      if (result != keep_probing) {
+        return result;
+      }
+      group = (group + step) & group_mask;
+    }
+  }
+
+  [[nodiscard]] auto findSlot(std::uint64_t id) const noexcept
+      -> std::size_t {
+    if (capacity_m == 0) {
+      return npos;
+    }
+    auto const control = controlByte(id);
+    return probe(id, [this, id, control](impl::ControlGroup const &group,
+                                        std::size_t first_slot) {
+      for (auto mask = group.match(control); mask != 0; mask &= mask - 1) {
+        auto const slot =
+            first_slot + impl::ControlGroup::lowestIndex(mask);
+        if (keys_p_m[slot].id == id) {
+          return slot;
+        }
+      }
+      return group.matchEmpty() != 0 ? npos : keep_probing;
+    });
+  }
+
+  [[nodiscard]] auto findFreeSlot(std::uint64_t id) const noexcept
+      -> std::size_t {
+    return probe(id, [](impl::ControlGroup const &group,
+                        std::size_t first_slot) {
+      auto const mask = group.matchEmptyOrDeleted();
+      return mask != 0 ? first_slot + impl::ControlGroup::lowestIndex(mask)
+                       : keep_probing;
+    });
+  }
+
+  void rehash(std::size_t capacity) {
+    TypeMap result(allocator_m);
+    result.allocate(capacity);
+    for (std::size_t slot = 0; slot < capacity_m; ++slot) {
+      if (!isFull(slot))
+        continue;
+      auto const id = keys_p_m[slot].id;
+      auto const new_slot = result.findFreeSlot(id);
+      result.allocator_m.construct(result.values_p_m + new_slot,
+                                   std::move(values_p_m[slot]));
+      result.control_p_m[new_slot] = controlByte(id);
+      result.keys_p_m[new_slot] = keys_p_m[slot];
+      ++result.size_m;
+      --result.growth_left_m;
+    }
+    *this = std::move(result);
+  }
+
+  void allocate(std::size_t capacity) {
+    control_p_m = allocator_m.allocate_object<std::uint8_t>(capacity);
+    keys_p_m = allocator_m.allocate_object<Key>(capacity);
+    values_p_m = allocator_m.allocate_object<V>(capacity);
+    std::memset(control_p_m, impl::ControlGroup::empty, capacity);
+    capacity_m = capacity;
+    growth_left_m = capacity * 7 / 8;
+  }
+
+  void deallocate() noexcept {
+    if (capacity_m == 0)
+      return;
+    allocator_m.deallocate_object(control_p_m, capacity_m);
+    allocator_m.deallocate_object(keys_p_m, capacity_m);
+    allocator_m.deallocate_object(values_p_m, capacity_m);
+    control_p_m = nullptr;
+    keys_p_m = nullptr;
+    values_p_m = nullptr;
+    capacity_m = 0;
+    growth_left_m = 0;
+  }
+
+  PolymorphicAllocator<std::byte> allocator_m;
+  std::uint8_t *control_p_m = nullptr;
+  Key *keys_p_m = nullptr;
+  V *values_p_m = nullptr;
+  std::size_t capacity_m = 0;
+  std::size_t size_m = 0;
+  //! \brief Number of empty slots that can be filled before rehash
+  std::size_t growth_left_m = 0;
+};
+
+/*!
+ * \brief
+ * Map from types to values where every type has a fixed index, so lookup is
+ * indexing of an array.
+ * \details
+ * Index of `T` is assigned on its first use by any StaticTypeMap of the
+ * process(and is the same in every plugin), so the map is as large as the
+ * largest index of its types. Prefer it when a few maps share the same types,
+ * TypeMap otherwise. Types can be only known statically.
+ */
+template <typename V> class StaticTypeMap {
+public:
+  StaticTypeMap() = default;
+  explicit StaticTypeMap(
+      PolymorphicAllocator<std::byte> const &allocator) noexcept
+      : values_m(allocator) {}
+
+  //! \brief Returns value of the type or nullptr
+  template <typename T> [[nodiscard]] auto find() -> V * {
+    auto const index = impl::denseTypeIndex<T>();
+    return index < values_m.size() && values_m[index].has_value()
+               ? &*values_m[index]
+               : nullptr;
+  }
+  template <typename T> [[nodiscard]] auto find() const -> V const * {
+    auto const index = impl::denseTypeIndex<T>();
+    return index < values_m.size() && values_m[index].has_value()
+               ? &*values_m[index]
+               : nullptr;
+  }
+
+  template <typename T> [[nodiscard]] auto contains() const -> bool {
+    return find<T>() != nullptr;
+  }
+
+  //! \brief Constructs value of `T` from `args` if there is none
+  template <typename T, typename... Args>
+  auto tryEmplace(Args &&... args) -> std::pair<V *, bool> {
+    auto const index = impl::denseTypeIndex<T>();
+    if (index >= values_m.size()) {
+      values_m.resize(index + 1);
+    }
+    auto &value = values_m[index];
+    if (value.has_value()) {
+      return {&*value, false};
+    }
+    value.emplace(std::forward<Args>(args)...);
+    ++size_m;
+    return {&*value, true};
+  }
+
+  template <typename T> auto erase() -> bool {
+    auto const index = impl::denseTypeIndex<T>();
+    if (index >= values_m.size() || !values_m[index].has_value()) {
+      return false;
+    }
+    values_m[index].reset();
+    --size_m;
+    return true;
+  }
+
+  void clear() noexcept {
+    values_m.clear();
+    size_m = 0;
+  }
+
+  [[nodiscard]] auto size() const noexcept -> std::size_t { return size_m; }
+  [[nodiscard]] auto isEmpty() const noexcept -> bool { return size_m == 0; }
+
+private:
+  Vector<std::optional<V>> values_m;
+  std::size_t size_m = 0;
+};
+
+} // namespace plugins
@@ -16,6 +16,11 @@
 #include <type_traits>
 #include <utility>
 
+namespace plugins {
+//! \brief Closed list of types, e.g. for PolymorphicFor
+template <typename... Ts> struct TypeList {};
+} // namespace plugins
+
 //! \brief Contains helper functions/classes
 namespace plugins::traits {
 
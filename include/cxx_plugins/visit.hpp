@@ -0,0 +1,164 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    visit.hpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains visit - dispatch on the dynamic type of Polymorphic or
+ * PolymorphicPtr over a closed set of types.
+ *
+ * \details
+ * Instead of a chain of casts:
+ * ```cpp
+ * if (auto *circle_p = polymorphicCast<Circle>(shape)) {
+ *   ...
+ * } else if (auto *box_p = polymorphicCast<Box>(shape)) {
+ *   ...
+ * }
+ * ```
+ * the type is found with one lookup and the visitor is called through a jump
+ * table:
+ * ```cpp
+ * visit<TypeList<Circle, Box>>(shape, Overloaded{
+ *     [](Circle &circle) { ... },
+ *     [](Box &box) { ... },
+ *     [](UnknownType unknown) { ... }});
+ * ```
+ */
+#pragma once
+
+#include "cxx_plugins/dynamic_call.hpp"
+#include "cxx_plugins/type_index.hpp"
+#include "cxx_plugins/type_traits.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace plugins {
+
+//! \brief Combines callables into one overloaded callable(for visit)
+template <typename... Callables> struct Overloaded : Callables... {
+  using Callables::operator()...;
+};
+template <typename... Callables>
+Overloaded(Callables...) -> Overloaded<Callables...>;
+
+/*!
+ * \brief
+ * Argument of the visitor for objects whose type isn't in the list(and for
+ * empty objects, their type is `void`).
+ */
+struct UnknownType {
+  type_index type;
+};
+
+namespace impl {
+//! \brief Perfect hash from ids of `Ts` to their indices
+template <typename... Ts> class TypeIdHash {
+public:
+  static constexpr std::size_t count = sizeof...(Ts);
+  //! \brief Returned for unknown ids
+  static constexpr std::size_t npos = count;
+
+  [[nodiscard]] static constexpr auto find(std::uint64_t id) noexcept
+      -> std::size_t {
+    auto const index = PerfectHash<TypeIdHash>::find(id);
+    return index < count && keys[index] == id ? index : npos;
+  }
+
+  static constexpr std::array<std::uint64_t, count == 0 ? 1 : count> keys = {
+      typeInfoConstruct<Ts>().id_m...};
+
+private:
+  static constexpr auto hasUniqueIds() noexcept -> bool {
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t j = i + 1; j < count; ++j) {
+        if (keys[i] == keys[j])
+          return false;
+      }
+    }
+    return true;
+  }
+  static_assert(hasUniqueIds(), "Types of visit should be unique");
+};
+
+template <typename T, typename ObjectPtrT>
+using VisitedObjectT =
+    std::conditional_t<std::is_const_v<std::remove_pointer_t<ObjectPtrT>>,
+                       T const, T>;
+
+template <typename Visitor, typename ObjectPtrT, typename... Ts>
+struct VisitDispatch {
+  static_assert(std::is_invocable_v<Visitor, UnknownType>,
+                "Visitor should handle UnknownType");
+  using Return = std::invoke_result_t<Visitor, UnknownType>;
+  static_assert(
+      (std::is_same_v<Return, std::invoke_result_t<
+                                  Visitor, VisitedObjectT<Ts, ObjectPtrT> &>> &&
+       ...),
+      "Visitor should return the same type for every type");
+
+  /*!
+   * \brief Calls visitor for the type with `index` or for UnknownType.
+   * \details
+   * After inlining comparisons become one switch, so the compiler can use a
+   * jump table and inline the visitor for every type.
+   */
+  template <typename T, typename... Rest>
+  static auto visitAt(std::size_t index, Visitor &&visitor, ObjectPtrT obj_p,
+                      type_index type) -> Return {
+    if (index == sizeof...(Ts) - sizeof...(Rest) - 1) {
+      return std::invoke(
+          std::forward<Visitor>(visitor),
+          *static_cast<VisitedObjectT<T, ObjectPtrT> *>(obj_p));
+    }
+    if constexpr (sizeof...(Rest) != 0) {
+      return visitAt<Rest...>(index, std::forward<Visitor>(visitor), obj_p,
+                              type);
+    } else {
+      return std::invoke(std::forward<Visitor>(visitor), UnknownType{type});
+    }
+  }
+};
+
+template <typename... Ts, typename PolymorphicT, typename Visitor>
+decltype(auto) visit(TypeList<Ts...> /*unused*/, PolymorphicT &&poly,
+                     Visitor &&visitor) {
+  using ObjectPtrT = decltype(poly.data());
+  auto const type = poly.typeIndex();
+  if constexpr (sizeof...(Ts) == 0) {
+    return std::invoke(std::forward<Visitor>(visitor), UnknownType{type});
+  } else {
+    return VisitDispatch<Visitor, ObjectPtrT, Ts...>::template visitAt<Ts...>(
+        TypeIdHash<Ts...>::find(type.id()), std::forward<Visitor>(visitor),
+        poly.data(), type);
+  }
+}
+} // namespace impl
+
+/*!
+ * \brief
+ * Calls `visitor` with the object of `poly` cast to its dynamic type if it
+ * is one of the types of `TypeListT`, or with UnknownType otherwise.
+ * \details
+ * Objects are passed as `T &`(`T const &` if `poly` gives only const access)
+ * and the visitor should return the same type for every alternative, as with
+ * `std::visit`. Types are found by their ids, so objects created by plugins
+ * are recognized as well. Cost is one hash lookup and one jump(through a
+ * jump table if the compiler chooses so) regardless of the number of types.
+ */
+template <typename TypeListT, typename PolymorphicT, typename Visitor>
+decltype(auto) visit(PolymorphicT &&poly, Visitor &&visitor) {
+  return impl::visit(TypeListT{}, std::forward<PolymorphicT>(poly),
+                     std::forward<Visitor>(visitor));
+}
+
+} // namespace plugins
@@ -17,14 +17,23 @@
 #pragma once
 
 #include "cxx_plugins/definitions.hpp"
+#include "cxx_plugins/dynamic_call.hpp"
 #include "cxx_plugins/function_traits.hpp"
 #include "cxx_plugins/function_cast.hpp"
+#include "cxx_plugins/function_proxy.hpp"
+#include "cxx_plugins/instrumentation.hpp"
 #include "cxx_plugins/polymorphic_traits.hpp"
+#include "cxx_plugins/type_index.hpp"
 #include "cxx_plugins/type_traits.hpp"
 #include "sequence/conversion.hpp"
 #include "sequence/map.hpp"
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
 #include <limits>
+#include <memory>
 
 namespace plugins {
 
@@ -37,12 +46,12 @@ using PolymorphicTrampolineTypeT =
 
 template <typename Return, typename... Args>
 struct PolymorphicTrampolineType<Return(Args...)> {
-  using Type = Return (*)(void *, Args...);
+  using Type = Return (*)(void *, TrampolineArgT<Args>...);
 };
 
 template <typename Return, typename... Args>
 struct PolymorphicTrampolineType<Return(Args...) const> {
-  using Type = Return (*)(void const *, Args...);
+  using Type = Return (*)(void const *, TrampolineArgT<Args>...);
 };
 
 template <typename Tag, typename T, typename Signature>
@@ -51,7 +60,7 @@ struct PolymorphicTrampoline;
 template <typename Tag, typename T, typename Return, typename... Args>
 struct PolymorphicTrampoline<Tag, T, Return(Args...)> {
 
-  static constexpr Return call(void *obj_p, Args... args) {
+  static constexpr Return call(void *obj_p, TrampolineArgT<Args>... args) {
     static_assert(!std::is_rvalue_reference_v<T>,
                   "T can't be rvalue reference");
     using underlying_t = std::remove_reference_t<T>;
@@ -64,20 +73,21 @@ struct PolymorphicTrampoline<Tag, T, Return(Args...)> {
       if constexpr (std::is_reference_v<T>) {
         return polymorphicExtend(
             Tag{}, static_cast<T>(*static_cast<underlying_t *>(obj_p)),
-            std::forward<Args>(args)...);
+            std::forward<TrampolineArgT<Args>>(args)...);
       } else {
         return polymorphicExtend(Tag{}, *static_cast<underlying_t *>(obj_p),
-                                 std::forward<Args>(args)...);
+                                 std::forward<TrampolineArgT<Args>>(args)...);
       }
     }
   }
 
-  static constexpr Return (*value)(void *, Args... args) = &call;
+  static constexpr Return (*value)(void *, TrampolineArgT<Args>...) = &call;
 };
 
 template <typename Tag, typename T, typename Return, typename... Args>
 struct PolymorphicTrampoline<Tag, T, Return(Args...) const> {
-  static constexpr Return call(void const *obj_p, Args... args) {
+  static constexpr Return call(void const *obj_p,
+                               TrampolineArgT<Args>... args) {
     static_assert(!std::is_rvalue_reference_v<T>,
                   "Ta can't be rvalue reference");
     using underlying_t = std::remove_reference_t<T> const;
@@ -90,38 +100,442 @@ struct PolymorphicTrampoline<Tag, T, Return(Args...) const> {
       return polymorphicExtend(
           Tag{},
           static_cast<reference_type>(*static_cast<underlying_t *>(obj_p)),
-          std::forward<Args>(args)...);
+          std::forward<TrampolineArgT<Args>>(args)...);
     } else {
       return polymorphicExtend(Tag{}, *static_cast<underlying_t *>(obj_p),
-                               std::forward<Args>(args)...);
+                               std::forward<TrampolineArgT<Args>>(args)...);
     }
   }
-  static constexpr Return (*value)(void const *, Args... args) = &call;
+  static constexpr Return (*value)(void const *,
+                                   TrampolineArgT<Args>...) = &call;
 };
 
 template <typename Tag, typename T, typename Signature>
 static constexpr auto polymorphic_trampoline_v =
     PolymorphicTrampoline<Tag, T, Signature>::value;
 
+#if CXX_PLUGINS_INSTRUMENT
+template <typename Interface, typename Tag, typename T, typename Signature>
+struct InstrumentedTrampoline;
+
+/*!
+ * \brief
+ * Counts calls(see instrumentation.hpp) and calls PolymorphicTrampoline.
+ */
+template <typename Interface, typename Tag, typename T, typename Return,
+          typename... Args>
+struct InstrumentedTrampoline<Interface, Tag, T, Return(Args...)> {
+  static Return call(void *obj_p, TrampolineArgT<Args>... args) {
+    auto &counter = callCounter(site_id);
+    increment(counter.count);
+#if CXX_PLUGINS_INSTRUMENT_LATENCY
+    CallTimer timer(counter);
+#endif
+    return PolymorphicTrampoline<Tag, T, Return(Args...)>::call(
+        obj_p, std::forward<TrampolineArgT<Args>>(args)...);
+  }
+
+  static inline std::uint32_t const site_id =
+      registerCallSite(typeInfoConstruct<Interface>(),
+                       typeInfoConstruct<Tag>(), typeInfoConstruct<T>());
+};
+
+template <typename Interface, typename Tag, typename T, typename Return,
+          typename... Args>
+struct InstrumentedTrampoline<Interface, Tag, T, Return(Args...) const> {
+  static Return call(void const *obj_p, TrampolineArgT<Args>... args) {
+    auto &counter = callCounter(site_id);
+    increment(counter.count);
+#if CXX_PLUGINS_INSTRUMENT_LATENCY
+    CallTimer timer(counter);
+#endif
+    return PolymorphicTrampoline<Tag, T, Return(Args...) const>::call(
+        obj_p, std::forward<TrampolineArgT<Args>>(args)...);
+  }
+
+  static inline std::uint32_t const site_id =
+      registerCallSite(typeInfoConstruct<Interface>(),
+                       typeInfoConstruct<Tag>(), typeInfoConstruct<T>());
+};
+
+/*!
+ * \brief
+ * Function that is stored in tables of `Interface`: instrumented trampoline
+ * if `CXX_PLUGINS_INSTRUMENT` is enabled, polymorphic_trampoline_v otherwise.
+ */
+template <typename Interface, typename Tag, typename T, typename Signature>
+static constexpr auto table_trampoline_v =
+    &InstrumentedTrampoline<Interface, Tag, T, Signature>::call;
+#else
+template <typename Interface, typename Tag, typename T, typename Signature>
+static constexpr auto table_trampoline_v =
+    polymorphic_trampoline_v<Tag, T, Signature>;
+#endif
+
+/*!
+ * \brief
+ * Information about the type that is stored right before function pointers of
+ * VTableStorage. It is shared by all objects of the same type, so objects
+ * don't need to store it.
+ */
+struct VTableHeader {
+  //! \brief TypeInfo of the type(without cv and reference qualifiers)
+  TypeInfo const *type_info;
+  //! \brief Calls destructor of the object, nullptr if it isn't destructible
+  void (*destroy)(void *obj_p) noexcept;
+  std::size_t size;
+  std::size_t alignment;
+  bool is_trivially_relocatable;
+  /*!
+   * \brief
+   * Number of objects of the type that were allocated by HybridStorage,
+   * nullptr if the library that built the table doesn't count them.
+   * \details
+   * Always present, so libraries built with and without
+   * `CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS` agree on the layout.
+   */
+  std::atomic<std::size_t> *fallback_allocations;
+};
+
+template <typename T>
+inline std::atomic<std::size_t> fallback_allocations{0};
+
+template <typename T>
+constexpr auto fallbackAllocationsPtr() noexcept
+    -> std::atomic<std::size_t> * {
+#if CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS
+  return &fallback_allocations<T>;
+#else
+  return nullptr;
+#endif
+}
+
+template <typename T> void destroyObject(void *obj_p) noexcept {
+  auto *typed_obj_p = static_cast<T *>(obj_p);
+  if constexpr (std::is_array_v<T>) {
+    std::destroy(std::begin(*typed_obj_p), std::end(*typed_obj_p));
+  } else {
+    typed_obj_p->~T();
+  }
+}
+
+template <typename T>
+constexpr auto makeVTableHeader() noexcept -> VTableHeader {
+  using underlying_t = std::remove_cv_t<std::remove_reference_t<T>>;
+  if constexpr (std::is_object_v<underlying_t>) {
+    void (*destroy)(void *) noexcept = nullptr;
+    if constexpr (std::is_destructible_v<underlying_t>) {
+      destroy = &destroyObject<underlying_t>;
+    }
+    return {&typeInfoConstruct<underlying_t>(),
+            destroy,
+            sizeof(underlying_t),
+            alignof(underlying_t),
+            is_trivially_relocatable<underlying_t>,
+            fallbackAllocationsPtr<underlying_t>()};
+  } else {
+    return {&typeInfoConstruct<underlying_t>(), nullptr, 0, 0, false,
+            fallbackAllocationsPtr<underlying_t>()};
+  }
+}
+
+/*!
+ * \brief
+ * Function pointers of different types that are laid out as an array.
+ * \details
+ * Unlike array of FnPtr<void()> it is initialized without reinterpret_cast, so
+ * tables that contain it are constant initialized.
+ */
+template <typename... Functions> struct FunctionList {};
+template <typename Function> struct FunctionList<Function> {
+  Function first;
+};
+template <typename Function, typename... Functions>
+struct FunctionList<Function, Functions...> {
+  Function first;
+  FunctionList<Functions...> rest;
+};
+
+/*!
+ * \brief
+ * Functions that are initialized with their own types(`typed`) and read as
+ * FnPtr<void()>(`erased`).
+ */
+template <std::size_t size, typename... Functions> union FunctionArray {
+  static_assert(sizeof...(Functions) == 0 ||
+                    sizeof(FunctionList<Functions...>) ==
+                        sizeof(FnPtr<void()>[size]),
+                "Function pointers should be laid out as an array");
+
+  FunctionList<Functions...> typed;
+  FnPtr<void()> erased[size];
+};
+
+/*!
+ * \brief
+ * Order of functions in tables of an interface with `Tags`: sorted by
+ * VTableSlotPriority(hot tags first), stable for equal priorities.
+ * \details
+ * `tag_at[slot]` is the index of the tag(in `Tags...`) stored at `slot`,
+ * `slot_of[index]` is the inverse mapping.
+ */
+template <typename... Tags> struct SlotOrder {
+  static constexpr std::size_t size = sizeof...(Tags) == 0 ? 1 : sizeof...(Tags);
+
+  static constexpr std::array<std::size_t, size> tag_at = [] {
+    constexpr int priorities[] = {VTableSlotPriority<Tags>::value..., 0};
+    std::array<std::size_t, size> result = {};
+    for (std::size_t i = 0; i < size; ++i) {
+      result[i] = i;
+    }
+    // insertion sort is stable
+    for (std::size_t i = 1; i < sizeof...(Tags); ++i) {
+      auto const current = result[i];
+      auto j = i;
+      for (; j > 0 && priorities[result[j - 1]] < priorities[current]; --j) {
+        result[j] = result[j - 1];
+      }
+      result[j] = current;
+    }
+    return result;
+  }();
+
+  static constexpr std::array<std::size_t, size> slot_of = [] {
+    std::array<std::size_t, size> result = {};
+    for (std::size_t slot = 0; slot < size; ++slot) {
+      result[tag_at[slot]] = slot;
+    }
+    return result;
+  }();
+
+  //! \brief Slot of the function for `TagT`
+  template <typename TagT>
+  static constexpr std::size_t slot = slot_of[traits::index_of<TagT, Tags...>];
+};
+
+/*!
+ * \brief
+ * Permutation for impl::internVTable that creates table of interface with
+ * `Tags` from table of interface with `OtherTags`.
+ */
+template <typename TagList, typename OtherTagList> struct SlotRemapping;
+
+template <typename... Tags, typename... OtherTags>
+struct SlotRemapping<TypeList<Tags...>, TypeList<OtherTags...>> {
+  using OrderT = SlotOrder<Tags...>;
+  using OtherOrderT = SlotOrder<OtherTags...>;
+
+  static constexpr std::array<std::uint8_t, OrderT::size> permutation = [] {
+    constexpr std::size_t other_index[] = {
+        traits::index_of<Tags, OtherTags...>..., 0};
+    std::array<std::uint8_t, OrderT::size> result = {};
+    for (std::size_t slot = 0; slot < sizeof...(Tags); ++slot) {
+      result[slot] = static_cast<std::uint8_t>(
+          OtherOrderT::slot_of[other_index[OrderT::tag_at[slot]]]);
+    }
+    return result;
+  }();
+
+  //! \brief True if the other table starts with functions of `Tags`
+  static constexpr bool is_prefix = [] {
+    for (std::size_t slot = 0; slot < sizeof...(Tags); ++slot) {
+      if (permutation[slot] != slot)
+        return false;
+    }
+    return true;
+  }();
+};
+
+inline auto vtableHeader(FnPtr<void()> const *table_p) noexcept
+    -> VTableHeader const & {
+  return *(reinterpret_cast<VTableHeader const *>(table_p) - 1);
+}
+
+inline auto isSameVTableHeader(VTableHeader const &lhs,
+                               VTableHeader const &rhs) noexcept -> bool {
+  return lhs.type_info == rhs.type_info && lhs.destroy == rhs.destroy &&
+         lhs.size == rhs.size && lhs.alignment == rhs.alignment &&
+         lhs.is_trivially_relocatable == rhs.is_trivially_relocatable &&
+         lhs.fallback_allocations == rhs.fallback_allocations;
+}
+
+/*!
+ * \brief
+ * Returns true if `remapped_p` has the header of `table_p` and functions
+ * `table_p[permutation_p[i]]` for `i` in `[0, size)`.
+ */
+inline auto isRemappedVTable(FnPtr<void()> const *remapped_p,
+                             FnPtr<void()> const *table_p,
+                             std::uint8_t const *permutation_p,
+                             std::size_t size) noexcept -> bool {
+  if (!isSameVTableHeader(vtableHeader(remapped_p), vtableHeader(table_p)))
+    return false;
+  for (std::size_t i = 0; i < size; ++i) {
+    if (remapped_p[i] != table_p[permutation_p[i]])
+      return false;
+  }
+  return true;
+}
+
+/*!
+ * \brief
+ * Returns function table(with VTableHeader before it) that contains
+ * functions `table_p[permutation_p[i]]` for `i` in `[0, size)`.
+ * \details
+ * Tables are kept by ids of the type and of both interfaces and live till the
+ * end of the program. A kept table is returned only if it is still the
+ * remapping of `table_p`(see isRemappedVTable), so a library loaded at the
+ * address of an unloaded one never gets functions of the old one: a new table
+ * is created instead(a few words per reload). Lookups take a shared lock,
+ * only creation of a table is exclusive. Thread safe.
+ */
+auto internVTable(FnPtr<void()> const *table_p,
+                  std::uint8_t const *permutation_p, std::size_t size,
+                  std::uint64_t source_interface_id,
+                  std::uint64_t target_interface_id) -> FnPtr<void()> const *;
+
+/*!
+ * \brief
+ * Returns table of functions of `interface` for `type` that is shared by every
+ * library of the process: the first `table_p` registered for the pair.
+ * \details
+ * Types and interfaces are identified by their names. Types without a unique
+ * name(from anonymous namespaces or lambdas) are not shared, `table_p` is
+ * returned for them. Thread safe.
+ */
+auto internTypeTable(TypeInfo const &type, TypeInfo const &interface,
+                     FnPtr<void()> const *table_p) -> FnPtr<void()> const *;
+
 } // namespace impl
 
 template <typename Signature>
 using PolymorphicTrampolineT =
     typename impl::PolymorphicTrampolineType<Signature>::type;
 
-template <typename T, typename... TaggedValues> struct VTableStorage;
+namespace impl {
+template <typename T, typename... TaggedValues> struct VTableStorageImpl;
+
+/*!
+ * \brief Functions of the interface for `T` in the order of SlotOrder.
+ */
+template <typename T, typename Interface, typename Slots> struct SlotFunctions;
+
+template <typename T, typename... Tags, typename... Signatures,
+          std::size_t... Slots>
+struct SlotFunctions<T, TypeList<TaggedSignature<Tags, Signatures>...>,
+                     std::index_sequence<Slots...>> {
+  using InterfaceT = TypeList<TaggedSignature<Tags, Signatures>...>;
+  using OrderT = SlotOrder<Tags...>;
+
+  template <std::size_t slot>
+  using TagAt = traits::ElementType<OrderT::tag_at[slot], Tags...>;
+  template <std::size_t slot>
+  using SignatureAt = traits::ElementType<OrderT::tag_at[slot], Signatures...>;
+
+  using Type = FunctionArray<OrderT::size,
+                             PolymorphicTrampolineTypeT<SignatureAt<Slots>>...>;
+
+  static constexpr Type value = {
+      {table_trampoline_v<InterfaceT, TagAt<Slots>, T, SignatureAt<Slots>>...}};
+};
 
 template <typename T, typename... Tags, typename... Signatures>
-struct VTableStorage<T, TaggedSignature<Tags, Signatures>...> {
+struct VTableStorageImpl<T, TaggedSignature<Tags, Signatures>...> {
   static constexpr std::size_t size =
       sizeof...(Tags) == 0 ? 1 : sizeof...(Tags);
 
   using FunctionPtrT = FnPtr<void()>;
+  using FunctionsT =
+      SlotFunctions<T, TypeList<TaggedSignature<Tags, Signatures>...>,
+                    std::make_index_sequence<sizeof...(Tags)>>;
+
+  struct Layout {
+    impl::VTableHeader header;
+    typename FunctionsT::Type functions;
+  };
+  static_assert(offsetof(Layout, functions) == sizeof(impl::VTableHeader),
+                "Header should be placed right before function pointers");
+
+  /*!
+   * \brief
+   * Constant initialized, so no code runs when a library is loaded.
+   * Functions are in the order of impl::SlotOrder.
+   */
+  static constexpr Layout layout = {impl::makeVTableHeader<T>(),
+                                    FunctionsT::value};
 
-  static inline const FunctionPtrT value[size] = {
-      reinterpret_cast<FunctionPtrT>(
-          impl::polymorphic_trampoline_v<Tags, T, Signatures>)...};
+  static constexpr FunctionPtrT const *value = layout.functions.erased;
+
+  /*!
+   * \brief
+   * Returns the table that is used by VTable constructors: `value` or, if
+   * `CXX_PLUGINS_SHARED_VTABLES` is enabled, the table shared by all
+   * libraries.
+   */
+  static auto table() noexcept -> FunctionPtrT const * {
+#if CXX_PLUGINS_SHARED_VTABLES
+    static FunctionPtrT const *const shared_p = internTypeTable(
+        typeInfoConstructWithCVR<T>(),
+        typeInfoConstruct<TypeList<TaggedSignature<Tags, Signatures>...>>(),
+        value);
+    return shared_p;
+#else
+    return value;
+#endif
+  }
 };
+} // namespace impl
+
+template <typename T, typename... TaggedValues>
+struct VTableStorage : impl::VTableStorageImpl<T, TaggedValues...> {};
+
+/*!
+ * \brief
+ * Functions for lvalue reference behave exactly as for the type itself, so
+ * they share the table(and it can be compared with the table of the type).
+ */
+template <typename T, typename... TaggedValues>
+struct VTableStorage<T &, TaggedValues...> : VTableStorage<T, TaggedValues...> {};
+
+namespace impl {
+/*!
+ * \brief
+ * Returns true if `header` belongs to a table of type `T`(with any cv and
+ * reference qualifiers).
+ * \details
+ * Headers are copied into remapped tables, so tables converted from tables of
+ * `T` are recognized as well. One load, ids are compared only if tables can
+ * come from another library.
+ */
+template <typename T>
+auto isHeaderOf(VTableHeader const &header) noexcept -> bool {
+#if CXX_PLUGINS_SHARED_VTABLES
+  return header.type_info->id_m == typeInfoConstruct<T>().id_m;
+#else
+  return header.type_info == &typeInfoConstruct<T>();
+#endif
+}
+
+/*!
+ * \brief
+ * Returns true if `table_p` is the table of type `T`(or `T const` if every
+ * function is const, because pointers to const objects use it).
+ */
+template <typename T, typename... Tags, typename... Signatures>
+auto isTableOf(FnPtr<void()> const *table_p,
+               TypeList<TaggedSignature<Tags, Signatures>...>
+               /*unused*/) noexcept -> bool {
+  using StorageT = VTableStorage<T, TaggedSignature<Tags, Signatures>...>;
+  if constexpr ((traits::FunctionTraits<Signatures>::is_const && ...) &&
+                !std::is_const_v<T>) {
+    using ConstStorageT =
+        VTableStorage<T const, TaggedSignature<Tags, Signatures>...>;
+    return table_p == StorageT::table() || table_p == ConstStorageT::table();
+  } else {
+    return table_p == StorageT::table();
+  }
+}
+} // namespace impl
 
 template <typename... TaggedValues> struct VTable;
 
@@ -157,11 +571,21 @@ public:
 
   void reset() noexcept { function_table_p_m = nullptr; }
 
+  //! \brief Returns information about the type stored in the table
+  auto header() const noexcept -> impl::VTableHeader const & {
+    cxxPluginsAssert(!isEmpty(), "Trying to get header of empty VTable");
+    return impl::vtableHeader(function_table_p_m);
+  }
+
+  //! \brief Returns type_index of the stored type(`void` if table is empty)
+  auto typeIndex() const noexcept -> type_index {
+    return isEmpty() ? type_id<void>() : type_index(*header().type_info);
+  }
+
   template <typename T>
   constexpr explicit VTable(std::in_place_type_t<T> /*unused*/) noexcept
       : function_table_p_m{VTableStorage<
-            T, TaggedSignature<Tags, Signatures>...>::value},
-        permutations_m{Sequence::AsStdArray<DefaultSequenceT>::value} {}
+            T, TaggedSignature<Tags, Signatures>...>::table()} {}
 
   template <
       typename... OtherTags, typename... OtherSignatures,
@@ -180,9 +604,7 @@ public:
       std::enable_if_t<other_constraints, int> = 0>
   constexpr VTable(VTable<TaggedSignature<OtherTags, OtherSignatures>...> const
                        &rhs) noexcept
-      : function_table_p_m{rhs.function_table_p_m},
-        permutations_m{Sequence::AsStdArray<std::integer_sequence<
-            std::uint8_t, traits::index_of<Tags, OtherTags...>...>>::value} {}
+      : function_table_p_m{remapTable<OtherTags...>(rhs.function_table_p_m)} {}
 
   template <
       typename... OtherTags, typename... OtherSignatures,
@@ -238,9 +660,7 @@ public:
       std::enable_if_t<other_constraints, int> = 0>
   constexpr VTable(VTable<TaggedSignature<OtherTags, OtherSignatures>...> const
                        &rhs) noexcept
-      : function_table_p_m{rhs.function_table_p_m},
-        permutations_m{Sequence::AsStdArray<std::integer_sequence<
-            std::uint8_t, traits::index_of<Tags, OtherTags...>...>>::value} {}
+      : function_table_p_m{remapTable<OtherTags...>(rhs.function_table_p_m)} {}
 
   template <
       typename... OtherTags, typename... OtherSignatures,
@@ -282,8 +702,7 @@ public:
   template <typename T>
   constexpr VTable &operator=(std::in_place_type_t<T> /*unused*/) noexcept {
     function_table_p_m =
-        VTableStorage<T, TaggedSignature<Tags, Signatures>...>::value;
-    permutations_m = Sequence::AsStdArray<DefaultSequenceT>::value;
+        VTableStorage<T, TaggedSignature<Tags, Signatures>...>::table();
 
     return *this;
   }
@@ -309,9 +728,7 @@ public:
          ...),
         "Every tag from `this` should have the same function signature as in "
         "rhs");
-    function_table_p_m = rhs.function_table_p_m;
-    permutations_m = Sequence::AsStdArray<std::integer_sequence<
-        std::uint8_t, traits::index_of<Tags, OtherTags...>...>>::value;
+    function_table_p_m = remapTable<OtherTags...>(rhs.function_table_p_m);
     return *this;
   }
 
@@ -324,21 +741,112 @@ public:
     using tag_t = std::decay_t<TagT>;
     static_assert(traits::is_in_the_pack_v<tag_t, Tags...>,
                   "Tag should be in the pack");
-    constexpr auto index = traits::index_of<tag_t, Tags...>;
+    constexpr auto index = impl::SlotOrder<Tags...>::template slot<tag_t>;
     return reinterpret_cast<FunctionTypeAt<tag_t> const>(
-        function_table_p_m[permutations_m[index]]);
+        function_table_p_m[index]);
+  }
+
+  //! \brief Returns true if the table was created for type `T`
+  template <typename T> auto isTableOf() const noexcept -> bool {
+    return impl::isTableOf<T>(
+        function_table_p_m,
+        TypeList<TaggedSignature<Tags, Signatures>...>{});
+  }
+
+  static constexpr std::size_t npos = impl::TagNameHash<Tags...>::npos;
+
+  /*!
+   * \brief
+   * Returns slot of the function of the tag with `name`(see TagName) or npos.
+   * \details Names are found with a perfect hash built at compile time.
+   */
+  static constexpr auto slotOf(std::string_view name) noexcept
+      -> std::size_t {
+    auto const index = impl::TagNameHash<Tags...>::find(name);
+    return index == npos ? npos : impl::SlotOrder<Tags...>::slot_of[index];
+  }
+
+  /*!
+   * \brief
+   * Calls function of the tag with `name` for the object at `obj_p` with type
+   * erased arguments, see dynamic_call.hpp.
+   * \details
+   * If the function returns a value it is assigned to `result`(unless it is
+   * empty). Throws DynamicCallError if there is no such tag or arguments(or
+   * result) don't match its signature.
+   */
+  void callByName(std::string_view name, void *obj_p, DynamicArguments args,
+                  DynamicArgument result = {}) const {
+    invokeByName(name, obj_p, false, args, result);
+  }
+
+  //! \brief Same as callByName, but only const functions can be called
+  void callByName(std::string_view name, void const *obj_p,
+                  DynamicArguments args, DynamicArgument result = {}) const {
+    invokeByName(name, obj_p, true, args, result);
   }
 
 private:
   template <typename TagT>
-  static constexpr unsigned index = traits::index_of<TagT, Tags...>;
+  static constexpr unsigned index =
+      impl::SlotOrder<Tags...>::template slot<TagT>;
 
-  using DefaultSequenceT = std::make_integer_sequence<uint8_t, sizeof...(Tags)>;
-  static constexpr std::size_t perm_size =
-      sizeof...(Tags) == 0 ? 1 : sizeof...(Tags);
+  static constexpr impl::DynamicInvokerT dynamic_invokers[] = {
+      &impl::DynamicInvoker<Signatures>::invoke..., nullptr};
+
+  void invokeByName(std::string_view name, void const *obj_p,
+                    bool is_const_object, DynamicArguments args,
+                    DynamicArgument result) const {
+    cxxPluginsAssert(!isEmpty(), "Trying to call function of empty VTable");
+    using NameHashT = impl::TagNameHash<Tags...>;
+    auto const index = NameHashT::find(name);
+    if (index == npos) {
+      impl::throwDynamicCallError(name, "interface has no such tag");
+    }
+    dynamic_invokers[index](
+        function_table_p_m[impl::SlotOrder<Tags...>::slot_of[index]], obj_p,
+        is_const_object, NameHashT::names[index], args, result);
+  }
+
+  /*!
+   * \brief
+   * Returns table with functions of `this` interface for the type of table
+   * with `OtherTags`.
+   * \details
+   * If functions of `this` are the first functions of the other table(in the
+   * same order) the table itself is used. Otherwise remapped table is taken
+   * from impl::internVTable(last one is cached per thread), so calls never
+   * go through permutation. The cached table is checked against the source
+   * table(a few loads from the same cache lines), so it is never stale if a
+   * library is unloaded and another one is loaded at the same address.
+   */
+  template <typename... OtherTags>
+  static auto remapTable(FunctionTablePtrT table_p) noexcept
+      -> FunctionTablePtrT {
+    using RemappingT =
+        impl::SlotRemapping<TypeList<Tags...>, TypeList<OtherTags...>>;
+    if constexpr (RemappingT::is_prefix) {
+      return table_p;
+    } else {
+      if (table_p == nullptr)
+        return nullptr;
+      constexpr auto const &permutation = RemappingT::permutation;
+      thread_local FunctionTablePtrT last_source_p = nullptr;
+      thread_local FunctionTablePtrT last_result_p = nullptr;
+      if (table_p != last_source_p ||
+          !impl::isRemappedVTable(last_result_p, table_p, permutation.data(),
+                                  permutation.size())) {
+        last_result_p = impl::internVTable(
+            table_p, permutation.data(), permutation.size(),
+            impl::typeInfoConstruct<TypeList<OtherTags...>>().id_m,
+            impl::typeInfoConstruct<TypeList<Tags...>>().id_m);
+        last_source_p = table_p;
+      }
+      return last_result_p;
+    }
+  }
 
   FunctionTablePtrT function_table_p_m = nullptr;
-  std::array<std::uint8_t, sizeof...(Tags)> permutations_m = {};
 };
 
 template <typename... TaggedSignatures> struct PrimitiveVTable;
@@ -346,8 +854,8 @@ template <typename... TaggedSignatures> struct PrimitiveVTable;
 template <typename... Tags, typename... Signatures>
 /*!
  * \brief
- * SimpleVtable is the same thing as VTable, but it doesn't allow upcasting,
- * because it doesn't have permutation tables.
+ * PrimitiveVTable is the same thing as VTable, but it doesn't allow upcasting,
+ * so it never needs remapped(interned) tables.
  */
 struct PrimitiveVTable<TaggedSignature<Tags, Signatures>...> {
 public:
@@ -378,17 +886,28 @@ public:
 
   void reset() noexcept { function_table_p_m = nullptr; }
 
+  //! \brief Returns information about the type stored in the table
+  auto header() const noexcept -> impl::VTableHeader const & {
+    cxxPluginsAssert(!isEmpty(), "Trying to get header of empty VTable");
+    return impl::vtableHeader(function_table_p_m);
+  }
+
+  //! \brief Returns type_index of the stored type(`void` if table is empty)
+  auto typeIndex() const noexcept -> type_index {
+    return isEmpty() ? type_id<void>() : type_index(*header().type_info);
+  }
+
   template <typename T>
   constexpr explicit PrimitiveVTable(
       std::in_place_type_t<T> /*unused*/) noexcept
       : function_table_p_m{
-            VTableStorage<T, TaggedSignature<Tags, Signatures>...>::value} {}
+            VTableStorage<T, TaggedSignature<Tags, Signatures>...>::table()} {}
 
   template <typename T>
   constexpr PrimitiveVTable &
   operator=(std::in_place_type_t<T> /*unused*/) noexcept {
     function_table_p_m =
-        VTableStorage<T, TaggedSignature<Tags, Signatures>...>::value;
+        VTableStorage<T, TaggedSignature<Tags, Signatures>...>::table();
     return *this;
   }
 
@@ -401,20 +920,152 @@ public:
     using tag_t = std::decay_t<TagT>;
     static_assert(traits::is_in_the_pack_v<tag_t, Tags...>,
                   "Tag should be in the pack");
-    constexpr auto index = traits::index_of<tag_t, Tags...>;
+    constexpr auto index = impl::SlotOrder<Tags...>::template slot<tag_t>;
     return reinterpret_cast<FunctionTypeAt<tag_t> const>(
         function_table_p_m[index]);
   }
 
+  //! \brief Returns true if the table was created for type `T`
+  template <typename T> auto isTableOf() const noexcept -> bool {
+    return impl::isTableOf<T>(
+        function_table_p_m,
+        TypeList<TaggedSignature<Tags, Signatures>...>{});
+  }
+
 private:
   template <typename TagT>
-  static constexpr unsigned index = traits::index_of<TagT, Tags...>;
-
-  using DefaultSequenceT = std::make_integer_sequence<uint8_t, sizeof...(Tags)>;
-  static constexpr std::size_t perm_size =
-      sizeof...(Tags) == 0 ? 1 : sizeof...(Tags);
+  static constexpr unsigned index =
+      impl::SlotOrder<Tags...>::template slot<TagT>;
 
   FunctionTablePtrT function_table_p_m = nullptr;
 };
 
+template <typename... TaggedSignatures> struct InlineVTable;
+
+template <typename T> struct IsVTable : std::false_type {};
+template <typename... TaggedSignatures>
+struct IsVTable<VTable<TaggedSignatures...>> : std::true_type {};
+template <typename... TaggedSignatures>
+struct IsVTable<PrimitiveVTable<TaggedSignatures...>> : std::true_type {};
+template <typename... TaggedSignatures>
+struct IsVTable<InlineVTable<TaggedSignatures...>> : std::true_type {};
+
+template <typename T> static constexpr bool is_vtable_v = IsVTable<T>::value;
+
+/*!
+ * \brief
+ * Same as PrimitiveVTable, but function pointers are stored inside of the
+ * table itself, so calling a function costs one load less.
+ * \details
+ * Only a pointer to VTableHeader of the type is kept besides of functions, so
+ * the table is `sizeof(void*) * (sizeof...(Tags) + 1)` bytes. It pays off only
+ * for interfaces with a few functions, see CompactVTable.
+ * Can be constructed from any table that has all functions of this one(in any
+ * order).
+ */
+template <typename... Tags, typename... Signatures>
+struct InlineVTable<TaggedSignature<Tags, Signatures>...> {
+public:
+  template <typename TagT>
+  using FunctionTypeAt =
+      traits::ElementType<traits::index_of<TagT, Tags...>,
+                           impl::PolymorphicTrampolineTypeT<Signatures>...>;
+
+  static_assert(traits::are_unique_v<Tags...>, "All tags should be unique");
+
+  constexpr InlineVTable() noexcept = default;
+  constexpr InlineVTable(InlineVTable const &) noexcept = default;
+  constexpr InlineVTable(InlineVTable &&) noexcept = default;
+  constexpr InlineVTable &operator=(InlineVTable const &) noexcept = default;
+  constexpr InlineVTable &operator=(InlineVTable &&) noexcept = default;
+
+  constexpr bool isEmpty() const noexcept { return header_p_m == nullptr; }
+
+  void reset() noexcept {
+    header_p_m = nullptr;
+    functions_m = {};
+  }
+
+  //! \brief Returns information about the type stored in the table
+  auto header() const noexcept -> impl::VTableHeader const & {
+    cxxPluginsAssert(!isEmpty(), "Trying to get header of empty VTable");
+    return *header_p_m;
+  }
+
+  //! \brief Returns type_index of the stored type(`void` if table is empty)
+  auto typeIndex() const noexcept -> type_index {
+    return isEmpty() ? type_id<void>() : type_index(*header().type_info);
+  }
+
+  template <typename T>
+  constexpr explicit InlineVTable(std::in_place_type_t<T> /*unused*/) noexcept
+      : header_p_m{&impl::vtableHeader(StorageT<T>::table())},
+        functions_m{reinterpret_cast<FunctionPtrT>(
+            impl::table_trampoline_v<
+                TypeList<TaggedSignature<Tags, Signatures>...>, Tags, T,
+                Signatures>)...} {}
+
+  template <typename TableT, typename = std::enable_if_t<
+                                 is_vtable_v<TableT> &&
+                                 !std::is_same_v<TableT, InlineVTable>>>
+  constexpr InlineVTable(TableT const &rhs) noexcept {
+    if (rhs.isEmpty())
+      return;
+    header_p_m = &rhs.header();
+    functions_m = {reinterpret_cast<FunctionPtrT>(rhs[Tags{}])...};
+  }
+
+  template <typename T>
+  constexpr InlineVTable &operator=(std::in_place_type_t<T> tag) noexcept {
+    return *this = InlineVTable(tag);
+  }
+
+  template <typename TagT>
+  inline auto operator[](TagT && /*unused*/) const noexcept
+      -> FunctionTypeAt<std::decay_t<TagT>> {
+
+    cxxPluginsAssert(!isEmpty(), "Trying to get function for empty VTable");
+
+    using tag_t = std::decay_t<TagT>;
+    static_assert(traits::is_in_the_pack_v<tag_t, Tags...>,
+                  "Tag should be in the pack");
+    return reinterpret_cast<FunctionTypeAt<tag_t> const>(
+        functions_m[index<tag_t>]);
+  }
+
+  /*!
+   * \brief Returns true if the functions are of type `T`.
+   * \details Tables converted from tables of `T` are recognized as well.
+   */
+  template <typename T> auto isTableOf() const noexcept -> bool {
+    return !isEmpty() && impl::isHeaderOf<T>(*header_p_m);
+  }
+
+private:
+  using FunctionPtrT = FnPtr<void()>;
+
+  template <typename T>
+  using StorageT = VTableStorage<T, TaggedSignature<Tags, Signatures>...>;
+
+  template <typename TagT>
+  static constexpr unsigned index = traits::index_of<TagT, Tags...>;
+
+  impl::VTableHeader const *header_p_m = nullptr;
+  std::array<FunctionPtrT, sizeof...(Tags)> functions_m = {};
+};
+
+//! \brief Largest number of functions for which CompactVTable is inline
+static constexpr std::size_t inline_vtable_max_size = 3;
+
+/*!
+ * \brief
+ * InlineVTable for interfaces with up to `inline_vtable_max_size` functions,
+ * PrimitiveVTable for bigger ones.
+ */
+template <typename... TaggedSignatures>
+using CompactVTable =
+    std::conditional_t<sizeof...(TaggedSignatures) <= inline_vtable_max_size,
+                       InlineVTable<TaggedSignatures...>,
+                       PrimitiveVTable<TaggedSignatures...>>;
+
 } // namespace CxxPlugins
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_likely.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains registry of callLikely profiles and generation of hot types header.
+ */
+#include "cxx_plugins/call_likely.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace plugins {
+
+namespace impl {
+namespace {
+struct CallSiteProfiles {
+  std::mutex mutex;
+  CallSiteProfile *first_p = nullptr;
+};
+
+auto callSiteProfiles() -> CallSiteProfiles & {
+  // Never destroyed: profiles are function local statics, which can be
+  // destroyed after statics of this translation unit.
+  static auto *profiles_p = new CallSiteProfiles;
+  return *profiles_p;
+}
+
+auto typeName(TypeInfoPtrT type_info) -> std::string {
+  return std::string(type_index(*type_info).pretty_name());
+}
+
+auto identifierFrom(std::string const &name) -> std::string {
+  std::string result;
+  for (auto c : name) {
+    bool const is_identifier_char =
+        (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') || c == '_';
+    if (is_identifier_char) {
+      result += c;
+    } else if (!result.empty() && result.back() != '_') {
+      result += '_';
+    }
+  }
+  while (!result.empty() && result.back() == '_') {
+    result.pop_back();
+  }
+  return result;
+}
+} // namespace
+
+CallSiteProfile::CallSiteProfile(TypeInfoPtrT tag_info,
+                                 TypeInfoPtrT likely_info) noexcept
+    : tag_info_m(tag_info), likely_info_m(likely_info) {
+  auto &profiles = callSiteProfiles();
+  std::scoped_lock lock(profiles.mutex);
+  next_m = profiles.first_p;
+  profiles.first_p = this;
+}
+
+CallSiteProfile::~CallSiteProfile() {
+  auto &profiles = callSiteProfiles();
+  std::scoped_lock lock(profiles.mutex);
+  for (auto **link_p = &profiles.first_p; *link_p != nullptr;
+       link_p = &(*link_p)->next_m) {
+    if (*link_p == this) {
+      *link_p = next_m;
+      break;
+    }
+  }
+}
+} // namespace impl
+
+void writeHotTypes(std::ostream &out, std::size_t max_types,
+                   double min_share) {
+  using impl::CallSiteProfile;
+  out << "// Generated by plugins::writeHotTypes\n"
+         "#pragma once\n\n"
+         "#include <cxx_plugins/type_traits.hpp>\n";
+
+  std::map<std::string, int> used_names;
+  auto &profiles = impl::callSiteProfiles();
+  std::scoped_lock lock(profiles.mutex);
+  for (auto *site_p = profiles.first_p; site_p != nullptr;
+       site_p = site_p->next_m) {
+    std::vector<std::pair<std::uint64_t, impl::TypeInfoPtrT>> counts;
+    std::uint64_t total = site_p->other_count_m.load();
+    for (auto const &entry : site_p->entries_m) {
+      auto type_info = entry.type_info.load();
+      if (type_info != nullptr) {
+        counts.emplace_back(entry.count.load(), type_info);
+        total += counts.back().first;
+      }
+    }
+    if (total == 0)
+      continue;
+    std::sort(counts.begin(), counts.end(),
+              [](auto const &lhs, auto const &rhs) {
+                return lhs.first > rhs.first;
+              });
+
+    auto const tag_name = impl::typeName(site_p->tag_info_m);
+    out << "\n// " << tag_name << ", called with "
+        << impl::typeName(site_p->likely_info_m) << ": " << total
+        << " calls\n";
+    std::vector<std::string> hot_types;
+    for (auto const &[count, type_info] : counts) {
+      auto const share = static_cast<double>(count) / total;
+      auto const name = impl::typeName(type_info);
+      out << "//   " << name << ": " << count << " (" << share * 100
+          << "%)\n";
+      bool const can_be_named = name.find("anonymous") == std::string::npos;
+      if (hot_types.size() < max_types && share >= min_share && can_be_named) {
+        hot_types.push_back(name);
+      }
+    }
+
+    auto alias = impl::identifierFrom(tag_name) + "_hot_types";
+    if (auto const index = used_names[alias]++; index != 0) {
+      alias += "_" + std::to_string(index);
+    }
+    out << "using " << alias << " = plugins::TypeList<";
+    for (std::size_t i = 0; i < hot_types.size(); ++i) {
+      out << (i == 0 ? "" : ", ") << hot_types[i];
+    }
+    out << ">;\n";
+  }
+}
+
+} // namespace plugins
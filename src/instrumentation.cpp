@@ -0,0 +1,203 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    instrumentation.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains registry of instrumented call sites and thread counters.
+ */
+#include "cxx_plugins/instrumentation.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace plugins {
+
+namespace impl {
+namespace {
+//! \brief Infos are interned, so sites outlive libraries that registered them
+struct CallSite {
+  TypeInfo const *interface_p;
+  TypeInfo const *tag_p;
+  TypeInfo const *type_p;
+};
+
+struct CallRegistry {
+  std::mutex mutex;
+  std::vector<CallSite> sites;
+  std::vector<std::unique_ptr<ThreadCallCounters>> counters;
+  //! \brief Counters of finished threads
+  std::vector<ThreadCallCounters *> free_counters;
+};
+
+auto callRegistry() -> CallRegistry & {
+  // Never destroyed: calls can be made during destruction of statics
+  static auto *registry_p = new CallRegistry;
+  return *registry_p;
+}
+
+//! \brief Returns counters of the thread to the registry when it finishes
+struct ThreadCountersOwner {
+  ~ThreadCountersOwner() {
+    if (counters_p == nullptr)
+      return;
+    auto &registry = callRegistry();
+    std::scoped_lock lock(registry.mutex);
+    registry.free_counters.push_back(counters_p);
+  }
+
+  ThreadCallCounters *counters_p = nullptr;
+};
+
+thread_local ThreadCountersOwner thread_counters_owner;
+} // namespace
+
+auto ThreadCallCounters::allocateChunk(std::size_t index) noexcept -> Chunk * {
+  cxxPluginsAssert(index < max_chunks, "Too many instrumented call sites");
+  auto *chunk_p = new Chunk();
+  chunks_m[index].store(chunk_p, std::memory_order_release);
+  return chunk_p;
+}
+
+auto registerCallSite(TypeInfo const &interface, TypeInfo const &tag,
+                      TypeInfo const &type) noexcept -> std::uint32_t {
+  CallSite const site{&internTypeInfo(interface), &internTypeInfo(tag),
+                      &internTypeInfo(type)};
+  auto &registry = callRegistry();
+  std::scoped_lock lock(registry.mutex);
+  registry.sites.push_back(site);
+  return static_cast<std::uint32_t>(registry.sites.size() - 1);
+}
+
+auto acquireThreadCallCounters() noexcept -> ThreadCallCounters & {
+  auto &owner = thread_counters_owner;
+  if (owner.counters_p != nullptr) {
+    return *owner.counters_p;
+  }
+  auto &registry = callRegistry();
+  std::scoped_lock lock(registry.mutex);
+  if (!registry.free_counters.empty()) {
+    owner.counters_p = registry.free_counters.back();
+    registry.free_counters.pop_back();
+  } else {
+    registry.counters.push_back(std::make_unique<ThreadCallCounters>());
+    owner.counters_p = registry.counters.back().get();
+  }
+  return *owner.counters_p;
+}
+} // namespace impl
+
+auto collectCallStatistics() -> std::vector<CallStatistics> {
+  using impl::ThreadCallCounters;
+  auto &registry = impl::callRegistry();
+  std::scoped_lock lock(registry.mutex);
+
+  // Sites of T and T const(or from different plugins) are merged
+  std::map<std::tuple<type_index, type_index, type_index>, CallStatistics>
+      merged;
+  for (std::size_t id = 0; id < registry.sites.size(); ++id) {
+    auto const &site = registry.sites[id];
+    CallStatistics statistics{type_index(*site.interface_p),
+                              type_index(*site.tag_p),
+                              type_index(*site.type_p)};
+    for (auto const &counters_p : registry.counters) {
+      auto const *chunk_p =
+          counters_p->chunks_m[id / ThreadCallCounters::chunk_size].load(
+              std::memory_order_acquire);
+      if (chunk_p == nullptr)
+        continue;
+      auto const &counter =
+          chunk_p->counters[id % ThreadCallCounters::chunk_size];
+      statistics.count += counter.count.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i < call_latency_bucket_count; ++i) {
+        statistics.latency[i] +=
+            counter.latency[i].load(std::memory_order_relaxed);
+      }
+    }
+    if (statistics.count == 0)
+      continue;
+    auto key = std::tuple(statistics.interface, statistics.tag, statistics.type);
+    auto [it, inserted] = merged.try_emplace(key, statistics);
+    if (!inserted) {
+      it->second.count += statistics.count;
+      for (std::size_t i = 0; i < call_latency_bucket_count; ++i) {
+        it->second.latency[i] += statistics.latency[i];
+      }
+    }
+  }
+
+  std::vector<CallStatistics> result;
+  result.reserve(merged.size());
+  for (auto &[key, statistics] : merged) {
+    result.push_back(statistics);
+  }
+  std::stable_sort(result.begin(), result.end(),
+                   [](auto const &lhs, auto const &rhs) {
+                     return lhs.count > rhs.count;
+                   });
+  return result;
+}
+
+void writeCallStatistics(std::ostream &out) {
+  auto const statistics = collectCallStatistics();
+  out << "calls\ttag\ttype\tinterface\n";
+  for (auto const &entry : statistics) {
+    out << entry.count << '\t' << entry.tag.pretty_name() << '\t'
+        << entry.type.pretty_name() << '\t' << entry.interface.pretty_name()
+        << '\n';
+    bool const has_latency =
+        std::any_of(entry.latency.begin(), entry.latency.end(),
+                    [](auto count) { return count != 0; });
+    if (!has_latency)
+      continue;
+    out << "\tlatency(ns):";
+    for (std::size_t i = 0; i < call_latency_bucket_count; ++i) {
+      if (entry.latency[i] != 0) {
+        out << " [" << (std::uint64_t{1} << i) << ", "
+            << (std::uint64_t{1} << (i + 1)) << "): " << entry.latency[i];
+      }
+    }
+    out << '\n';
+  }
+}
+
+void writeSlotPriorities(std::ostream &out) {
+  std::map<type_index, std::uint64_t> tag_counts;
+  for (auto const &entry : collectCallStatistics()) {
+    tag_counts[entry.tag] += entry.count;
+  }
+  std::vector<std::pair<type_index, std::uint64_t>> tags(tag_counts.begin(),
+                                                         tag_counts.end());
+  std::stable_sort(tags.begin(), tags.end(),
+                   [](auto const &lhs, auto const &rhs) {
+                     return lhs.second > rhs.second;
+                   });
+
+  out << "// Generated by plugins::writeSlotPriorities\n"
+         "#pragma once\n\n"
+         "#include <cxx_plugins/polymorphic_traits.hpp>\n";
+  auto priority = tags.size();
+  for (auto const &[tag, count] : tags) {
+    auto const name = tag.pretty_name();
+    if (name.find("anonymous") == std::string_view::npos) {
+      out << "\n// " << count << " calls\n"
+          << "template <>\nstruct plugins::VTableSlotPriority<" << name
+          << ">\n    : std::integral_constant<int, " << priority << "> {};\n";
+    }
+    --priority;
+  }
+}
+
+} // namespace plugins
@@ -16,34 +16,35 @@
 
 namespace plugins {
 
+namespace {
+/*
+ * Message of the inner error goes first: if nested message is truncated, outer
+ * context is lost, but the cause is kept.
+ */
+constexpr char const *nested_error_format = "{}\n  while parsing {}";
+} // namespace
 
 void impl::parsingLippincott(std::string_view type_description) {
   try {
     throw;
   } catch (TypeMismatch const &type_mismatch) {
-    throw TypeMismatch(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, type_mismatch.what()));
+    throw TypeMismatch(nested_error_format, type_mismatch.what(),
+                       type_description);
   } catch (ArraySizeMismatch const &array_size_mismatch) {
-    throw ArraySizeMismatch(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, array_size_mismatch.what()));
+    throw ArraySizeMismatch(nested_error_format, array_size_mismatch.what(),
+                            type_description);
   } catch (ObjectSizeMismatch const &object_size_mismatch) {
-    throw ObjectSizeMismatch(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, object_size_mismatch.what()));
+    throw ObjectSizeMismatch(nested_error_format, object_size_mismatch.what(),
+                             type_description);
   } catch (ObjectMemberMissing const &object_member_missing) {
-    throw ObjectMemberMissing(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, object_member_missing.what()));
+    throw ObjectMemberMissing(nested_error_format,
+                              object_member_missing.what(), type_description);
   } catch (ParsingError const &parsing_error) {
-    throw ParsingError(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, parsing_error.what()));
+    throw ParsingError(nested_error_format, parsing_error.what(),
+                       type_description);
   } catch (std::runtime_error const &re) {
-    throw std::runtime_error(
-        fmt::format("Exception thrown during parsing {}, message\n: {}",
-                    type_description, re.what()));
+    // ParsingError is a std::runtime_error, but its message doesn't allocate
+    throw ParsingError(nested_error_format, re.what(), type_description);
   } catch (...) {
     throw;
   }
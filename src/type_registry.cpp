@@ -0,0 +1,105 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    type_registry.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains process wide registry of type infos, function tables and indices
+ * of StaticTypeMap, so they are identical in every plugin.
+ */
+#include "cxx_plugins/type_index.hpp"
+#include "cxx_plugins/type_map.hpp"
+#include "cxx_plugins/vtable.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace plugins::impl {
+
+namespace {
+//! \brief Name owned by the registry and info that points to it
+struct InternedTypeInfo {
+  explicit InternedTypeInfo(std::string_view name)
+      : name_m(name), info_m{name_m.c_str(), name_m.size(), fnv1a(name)} {}
+
+  std::string const name_m;
+  TypeInfo const info_m;
+};
+
+struct TypeRegistry {
+  std::mutex mutex;
+  // keys point to names of infos, which never move
+  std::unordered_map<std::string_view, std::unique_ptr<InternedTypeInfo>>
+      infos;
+  //! \brief Tables by ids of the type and the interface
+  std::map<std::pair<std::uint64_t, std::uint64_t>, FnPtr<void()> const *>
+      tables;
+  //! \brief Indices of StaticTypeMap by type ids
+  std::unordered_map<std::uint64_t, std::size_t> dense_indices;
+};
+
+auto typeRegistry() -> TypeRegistry & {
+  // Never destroyed: type infos are used during static initialization and
+  // destruction of plugins.
+  static auto *registry_p = new TypeRegistry;
+  return *registry_p;
+}
+
+auto hasUniqueName(TypeInfo const &info) -> bool {
+  // GCC/Clang and MSVC spellings of unnamed entities
+  constexpr std::string_view unnamed_markers[] = {
+      "(anonymous namespace)", "{anonymous}", "`anonymous namespace'",
+      "<lambda", "{lambda",
+      "<unnamed", "{unnamed", "<anonymous"};
+  auto const name = static_cast<std::string_view>(info);
+  for (auto marker : unnamed_markers) {
+    if (name.find(marker) != std::string_view::npos) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+auto internTypeInfo(std::string_view name) -> TypeInfo const & {
+  auto &registry = typeRegistry();
+  std::scoped_lock lock(registry.mutex);
+  auto it = registry.infos.find(name);
+  if (it == registry.infos.end()) {
+    auto interned_p = std::make_unique<InternedTypeInfo>(name);
+    auto key = std::string_view(interned_p->name_m);
+    it = registry.infos.emplace(key, std::move(interned_p)).first;
+  }
+  return it->second->info_m;
+}
+
+auto internTypeTable(TypeInfo const &type, TypeInfo const &interface,
+                     FnPtr<void()> const *table_p) -> FnPtr<void()> const * {
+  if (!hasUniqueName(type) || !hasUniqueName(interface)) {
+    return table_p;
+  }
+  // ids are equal in every library
+  auto const key = std::pair(type.id_m, interface.id_m);
+  auto &registry = typeRegistry();
+  std::scoped_lock lock(registry.mutex);
+  return registry.tables.try_emplace(key, table_p).first->second;
+}
+
+auto denseTypeIndex(TypeInfo const &info) -> std::size_t {
+  auto &registry = typeRegistry();
+  std::scoped_lock lock(registry.mutex);
+  auto const index = registry.dense_indices.size();
+  return registry.dense_indices.try_emplace(info.id_m, index).first->second;
+}
+
+} // namespace plugins::impl
@@ -0,0 +1,109 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    vtable.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains storage of remapped function tables used for upcasting of VTable.
+ */
+#include "cxx_plugins/vtable.hpp"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <vector>
+
+namespace plugins::impl {
+
+namespace {
+using FunctionPtrT = FnPtr<void()>;
+//! \brief Ids of the type, of the source interface and of the target one
+using KeyT = std::tuple<std::uint64_t, std::uint64_t, std::uint64_t>;
+
+//! \brief Header and functions of remapped table in one allocation
+struct InternedTable {
+  explicit InternedTable(std::size_t size)
+      : functions_p(std::make_unique<FunctionPtrT[]>(size + header_slots)) {}
+
+  auto header() noexcept -> VTableHeader * {
+    return reinterpret_cast<VTableHeader *>(functions_p.get());
+  }
+  auto functions() noexcept -> FunctionPtrT * {
+    return functions_p.get() + header_slots;
+  }
+
+  static constexpr std::size_t header_slots =
+      (sizeof(VTableHeader) + sizeof(FunctionPtrT) - 1) / sizeof(FunctionPtrT);
+  static_assert(header_slots * sizeof(FunctionPtrT) == sizeof(VTableHeader),
+                "Functions should follow VTableHeader without padding");
+
+  std::unique_ptr<FunctionPtrT[]> functions_p;
+};
+
+/*!
+ * \brief
+ * Remapped tables for every key, more than one table per key is kept only if
+ * library of the type was reloaded(functions have changed).
+ */
+struct InternedTables {
+  std::shared_mutex mutex;
+  std::map<KeyT, std::vector<InternedTable>> tables;
+};
+
+auto internedTables() -> InternedTables & {
+  // Never destroyed: upcasts can happen during static initialization and
+  // destruction of other translation units.
+  static auto *tables_p = new InternedTables;
+  return *tables_p;
+}
+
+auto findTable(std::vector<InternedTable> &tables, FunctionPtrT const *table_p,
+               std::uint8_t const *permutation_p, std::size_t size) noexcept
+    -> FunctionPtrT const * {
+  for (auto &table : tables) {
+    if (isRemappedVTable(table.functions(), table_p, permutation_p, size))
+      return table.functions();
+  }
+  return nullptr;
+}
+} // namespace
+
+auto internVTable(FunctionPtrT const *table_p,
+                  std::uint8_t const *permutation_p, std::size_t size,
+                  std::uint64_t source_interface_id,
+                  std::uint64_t target_interface_id) -> FunctionPtrT const * {
+  auto const *type_info_p = vtableHeader(table_p).type_info;
+  KeyT const key{type_info_p == nullptr ? 0 : type_info_p->id_m,
+                 source_interface_id, target_interface_id};
+  auto &interned = internedTables();
+  {
+    std::shared_lock lock(interned.mutex);
+    auto it = interned.tables.find(key);
+    if (it != interned.tables.end()) {
+      if (auto const *result_p =
+              findTable(it->second, table_p, permutation_p, size))
+        return result_p;
+    }
+  }
+
+  std::scoped_lock lock(interned.mutex);
+  auto &tables = interned.tables[key];
+  // table could be created by other thread after shared lock was released
+  if (auto const *result_p = findTable(tables, table_p, permutation_p, size))
+    return result_p;
+  auto &table = tables.emplace_back(size);
+  new (table.header()) VTableHeader(vtableHeader(table_p));
+  for (std::size_t i = 0; i < size; ++i) {
+    table.functions()[i] = table_p[permutation_p[i]];
+  }
+  return table.functions();
+}
+
+} // namespace plugins::impl
@@ -0,0 +1,107 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_all_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Contains tests for callAll and CallSchedule
+ */
+
+#include <cxx_plugins/call_all.hpp>
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+struct record {};
+struct id {};
+
+std::vector<int> call_log;
+
+template <int type_id> struct Recorder {
+  void record(int offset) { call_log.push_back(type_id + offset); }
+  int calls_m = 0;
+};
+
+template <typename T>
+void polymorphicExtend(record /*unused*/, T &obj, int offset) {
+  obj.record(offset);
+  ++obj.calls_m;
+}
+template <typename T> auto polymorphicExtend(id /*unused*/, T const &obj) -> int {
+  return obj.calls_m;
+}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<record> {
+  using Type = void(int);
+};
+template <> struct plugins::PolymorphicTagSignature<id> {
+  using Type = int() const;
+};
+
+TEST(CallAll, GroupsCallsByFunction) {
+  using namespace plugins;
+  std::vector<Polymorphic<record, id>> objects;
+  for (int i = 0; i < 30; ++i) {
+    switch (i % 3) {
+    case 0:
+      objects.emplace_back(Recorder<0>{});
+      break;
+    case 1:
+      objects.emplace_back(Recorder<10>{});
+      break;
+    default:
+      objects.emplace_back(Recorder<20>{});
+      break;
+    }
+  }
+  objects.emplace_back();
+
+  call_log.clear();
+  callAll<record>(objects, 1);
+  ASSERT_EQ(call_log.size(), 30);
+  std::size_t runs = 1;
+  for (std::size_t i = 1; i < call_log.size(); ++i) {
+    runs += call_log[i] != call_log[i - 1] ? 1 : 0;
+  }
+  EXPECT_EQ(runs, 3);
+
+  for (auto const &obj : objects) {
+    if (!obj.isEmpty()) {
+      EXPECT_EQ(obj.call<id>(), 1);
+    }
+  }
+}
+
+TEST(CallAll, CachedSchedule) {
+  using namespace plugins;
+  Recorder<0> first;
+  Recorder<1> second;
+  Recorder<0> third;
+  std::vector<PolymorphicPtr<record, id>> ptrs = {&first, &second, &third};
+
+  auto schedule = makeCallSchedule<record>(ptrs);
+  EXPECT_EQ(schedule.size(), 3);
+  EXPECT_EQ(schedule.runCount(), 2);
+
+  call_log.clear();
+  schedule(0);
+  schedule(0);
+  EXPECT_EQ(call_log.size(), 6);
+  EXPECT_EQ(first.calls_m, 2);
+  EXPECT_EQ(second.calls_m, 2);
+  EXPECT_EQ(third.calls_m, 2);
+
+  std::vector<PolymorphicPtr<id>> const const_ptrs = {&first, &second};
+  auto const_schedule = makeCallSchedule<id>(const_ptrs);
+  EXPECT_EQ(const_schedule.runCount(), 2);
+  const_schedule();
+}
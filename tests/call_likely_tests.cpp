@@ -0,0 +1,147 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    call_likely_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for callLikely and profiling of hot types
+ */
+
+#define CXX_PLUGINS_PROFILE_CALL_LIKELY 1
+#include <cxx_plugins/polymorphic.hpp>
+#include <cxx_plugins/polymorphic_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace call_likely_tests {
+struct scale {};
+struct get {};
+
+template <int factor> struct Scaler {
+  void scale(int value) { value_m += value * factor; }
+  int value_m = 0;
+};
+
+template <typename T>
+void polymorphicExtend(scale /*unused*/, T &obj, int value) {
+  obj.scale(value);
+}
+template <typename T> auto polymorphicExtend(get /*unused*/, T const &obj) {
+  return obj.value_m;
+}
+} // namespace call_likely_tests
+
+template <> struct plugins::PolymorphicTagSignature<call_likely_tests::scale> {
+  using Type = void(int);
+};
+template <> struct plugins::PolymorphicTagSignature<call_likely_tests::get> {
+  using Type = int() const;
+};
+
+TEST(CallLikely, HitsAndMisses) {
+  using namespace plugins;
+  using namespace call_likely_tests;
+  Polymorphic<scale, get> likely{Scaler<1>{}};
+  Polymorphic<scale, get> unlikely{Scaler<3>{}};
+  EXPECT_TRUE(likely.functionTable().isTableOf<Scaler<1>>());
+  EXPECT_FALSE(unlikely.functionTable().isTableOf<Scaler<1>>());
+
+  likely.callLikely<scale, Scaler<1>, Scaler<2>>(2);
+  unlikely.callLikely<scale, Scaler<1>, Scaler<2>>(2);
+  EXPECT_EQ((likely.callLikely<get, Scaler<1>>()), 2);
+  EXPECT_EQ((std::as_const(unlikely).callLikely<get, Scaler<1>>()), 6);
+
+  Scaler<2> obj;
+  PolymorphicPtr<scale, get> ptr{&obj};
+  EXPECT_TRUE(ptr.functionTable().isTableOf<Scaler<2>>());
+  ptr.callLikely<scale, TypeList<Scaler<1>, Scaler<2>>>(1);
+  EXPECT_EQ(obj.value_m, 2);
+
+  Scaler<2> const &const_obj = obj;
+  PolymorphicPtr<get> const_ptr{&const_obj};
+  EXPECT_TRUE(const_ptr.functionTable().isTableOf<Scaler<2>>());
+  EXPECT_EQ((const_ptr.callLikely<get, Scaler<2>>()), 2);
+
+  InlinePolymorphicPtr<scale, get> inline_ptr{ptr};
+  EXPECT_TRUE(inline_ptr.functionTable().isTableOf<Scaler<2>>());
+  inline_ptr.callLikely<scale, Scaler<2>>(1);
+  EXPECT_EQ(obj.value_m, 4);
+}
+
+TEST(CallLikely, HitsOnConvertedPointers) {
+  using namespace plugins;
+  using namespace call_likely_tests;
+  Polymorphic<scale, get> poly{Scaler<1>{}};
+  PolymorphicPtr<scale, get> ptr = poly;
+  PolymorphicPtr<get, scale> reordered = ptr;
+  // remapped table is another table, but it has the header of the type
+  EXPECT_FALSE(reordered.functionTable().isTableOf<Scaler<1>>());
+  EXPECT_TRUE(impl::isHeaderOf<Scaler<1>>(ptr.functionTable().header()));
+  EXPECT_TRUE(
+      impl::isHeaderOf<Scaler<1>>(reordered.functionTable().header()));
+  EXPECT_FALSE(
+      impl::isHeaderOf<Scaler<2>>(reordered.functionTable().header()));
+
+  ptr.callLikely<scale, Scaler<1>>(2);
+  reordered.callLikely<scale, Scaler<2>, Scaler<1>>(3);
+  EXPECT_EQ((std::as_const(reordered).callLikely<get, Scaler<1>>()), 5);
+  EXPECT_EQ((poly.callLikely<get, Scaler<1>>()), 5);
+}
+
+TEST(CallLikely, HotTypesProfile) {
+  using namespace plugins;
+  using namespace call_likely_tests;
+  Polymorphic<scale, get> objects[] = {Scaler<4>{}, Scaler<4>{}, Scaler<4>{},
+                                       Scaler<5>{}, Scaler<5>{}, Scaler<6>{}};
+  for (int i = 0; i < 10; ++i) {
+    for (auto &object : objects) {
+      object.callLikely<scale>(1);
+    }
+  }
+
+  std::stringstream header;
+  writeHotTypes(header, 2, 0.2);
+  auto const text = header.str();
+  EXPECT_NE(text.find("call_likely_tests::scale, called with "
+                      "plugins::TypeList<>: 60 calls"),
+            std::string::npos)
+      << text;
+  EXPECT_NE(text.find("using call_likely_tests_scale_hot_types = "
+                      "plugins::TypeList<call_likely_tests::Scaler<4>, "
+                      "call_likely_tests::Scaler<5>>;"),
+            std::string::npos)
+      << text;
+}
+
+TEST(CallLikely, DestroyedProfilesAreNotWritten) {
+  using namespace plugins;
+  using namespace call_likely_tests;
+  {
+    // as if the profile was a static of a plugin that was unloaded
+    impl::CallSiteProfile profile(&impl::typeInfoConstruct<get>(),
+                                  &impl::typeInfoConstruct<TypeList<>>());
+    profile.record(&impl::typeInfoConstruct<Scaler<7>>());
+    // types are kept as interned infos, not infos of their libraries
+    auto const &interned =
+        impl::internTypeInfo(impl::typeInfoConstruct<Scaler<7>>());
+    profile.record(&interned);
+    EXPECT_EQ(profile.entries_m[interned.id_m % profile.capacity]
+                  .type_info.load(),
+              &interned);
+    EXPECT_EQ(profile.entries_m[interned.id_m % profile.capacity].count.load(),
+              2);
+    std::stringstream header;
+    writeHotTypes(header);
+    EXPECT_NE(header.str().find("Scaler<7>"), std::string::npos);
+  }
+  std::stringstream header;
+  writeHotTypes(header);
+  EXPECT_EQ(header.str().find("Scaler<7>"), std::string::npos);
+}
@@ -0,0 +1,29 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    emplace_inline_non_movable.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Shouldn't compile: emplace of a non-movable type into InlineStorage.
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+
+namespace {
+struct NonMovable {
+  NonMovable() = default;
+  NonMovable(NonMovable &&) = delete;
+  ~NonMovable() {} // not trivially copyable, so not trivially relocatable
+};
+} // namespace
+
+void emplaceInlineNonMovable();
+void emplaceInlineNonMovable() {
+  plugins::BasicUniquePolymorphic<plugins::InlineStorage<16>> poly;
+  poly.emplace(std::in_place_type_t<NonMovable>{});
+}
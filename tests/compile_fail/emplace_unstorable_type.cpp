@@ -0,0 +1,27 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    emplace_unstorable_type.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Shouldn't compile: emplace of a type that doesn't fit into InlineStorage.
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+
+namespace {
+struct Big {
+  char data_m[128] = {};
+};
+} // namespace
+
+void emplaceUnstorableType();
+void emplaceUnstorableType() {
+  plugins::BasicPolymorphic<plugins::InlineStorage<16>> poly;
+  poly.emplace(std::in_place_type_t<Big>{});
+}
@@ -0,0 +1,40 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    for_each_rvalue_reference.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Shouldn't compile: forEach with a tag that takes an rvalue reference.
+ */
+
+#include <cxx_plugins/polymorphic_vector.hpp>
+
+#include <string>
+
+namespace {
+struct consume {};
+
+struct Consumer {
+  std::string value_m;
+};
+
+void polymorphicExtend(consume /*unused*/, Consumer &obj, std::string &&value) {
+  obj.value_m = std::move(value);
+}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<consume> {
+  using Type = void(std::string &&);
+};
+
+void forEachRvalueReference();
+void forEachRvalueReference() {
+  plugins::PolymorphicVector<consume> objects;
+  objects.pushBack(Consumer{});
+  objects.forEach<consume>(std::string("moved"));
+}
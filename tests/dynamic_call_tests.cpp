@@ -0,0 +1,179 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    dynamic_call_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for calls by tag name(dynamic_call.hpp)
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+#include <cxx_plugins/polymorphic_ptr.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace scripting {
+struct increase {};
+struct rename {};
+struct value {};
+struct label {};
+
+template <std::size_t I> struct numbered {};
+} // namespace scripting
+
+namespace {
+struct Counter {
+  int value_m = 0;
+  std::string name_m;
+};
+
+void polymorphicExtend(scripting::increase /*unused*/, Counter &counter,
+                       int delta) {
+  counter.value_m += delta;
+}
+void polymorphicExtend(scripting::rename /*unused*/, Counter &counter,
+                       std::string name) {
+  counter.name_m = std::move(name);
+}
+auto polymorphicExtend(scripting::value /*unused*/, Counter const &counter)
+    -> int {
+  return counter.value_m;
+}
+auto polymorphicExtend(scripting::label /*unused*/, Counter const &counter)
+    -> std::string const & {
+  return counter.name_m;
+}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<scripting::increase> {
+  using Type = void(int);
+};
+template <> struct plugins::PolymorphicTagSignature<scripting::rename> {
+  using Type = void(std::string);
+};
+template <> struct plugins::PolymorphicTagSignature<scripting::value> {
+  using Type = int() const;
+};
+template <> struct plugins::PolymorphicTagSignature<scripting::label> {
+  using Type = std::string const &() const;
+};
+template <>
+struct plugins::VTableSlotPriority<scripting::value>
+    : std::integral_constant<int, 1> {};
+
+template <> struct plugins::TagName<scripting::label> {
+  static constexpr std::string_view value = "get_label";
+};
+
+using CounterPtr =
+    plugins::PolymorphicPtr<plugins::Tag<scripting::increase>,
+                            plugins::Tag<scripting::rename>,
+                            plugins::Tag<scripting::value>,
+                            plugins::Tag<scripting::label>>;
+
+TEST(DynamicCall, TagNames) {
+  using namespace plugins;
+  static_assert(tag_name_v<scripting::increase> == "increase");
+  static_assert(tag_name_v<Tag<scripting::increase>> == "increase");
+  static_assert(tag_name_v<Tag<scripting::label>> == "get_label");
+  static_assert(tag_name_v<scripting::numbered<3>> == "numbered<3>");
+  static_assert(impl::unqualifiedTypeName("a::b<c::d>") == "b<c::d>");
+
+  using HashT = impl::TagNameHash<scripting::increase, scripting::rename,
+                                  scripting::value>;
+  static_assert(HashT::find("increase") == 0);
+  static_assert(HashT::find("rename") == 1);
+  static_assert(HashT::find("value") == 2);
+  static_assert(HashT::find("values") == HashT::npos);
+  static_assert(HashT::find("") == HashT::npos);
+  static_assert(impl::TagNameHash<>::find("value") == HashT::npos);
+
+  // value has higher priority, so it is the first slot
+  static_assert(CounterPtr::FunctionTableT::slotOf("value") == 0);
+  static_assert(CounterPtr::FunctionTableT::slotOf("increase") == 1);
+  static_assert(CounterPtr::hasTag("get_label"));
+  static_assert(!CounterPtr::hasTag("label"));
+}
+
+template <std::size_t... I>
+void expectAllNumberedTagsFound(std::index_sequence<I...> /*unused*/) {
+  using namespace plugins;
+  using HashT = impl::TagNameHash<scripting::numbered<I>...>;
+  for (std::size_t i = 0; i < sizeof...(I); ++i) {
+    auto const name = "numbered<" + std::to_string(i) + ">";
+    EXPECT_EQ(HashT::find(name), i);
+  }
+  EXPECT_EQ(HashT::find("numbered<" + std::to_string(sizeof...(I)) + ">"),
+            HashT::npos);
+}
+
+TEST(DynamicCall, PerfectHashOfManyTags) {
+  expectAllNumberedTagsFound(std::make_index_sequence<1>{});
+  expectAllNumberedTagsFound(std::make_index_sequence<17>{});
+  expectAllNumberedTagsFound(std::make_index_sequence<100>{});
+}
+
+TEST(DynamicCall, CallsByName) {
+  using namespace plugins;
+  Counter counter;
+  CounterPtr ptr{&counter};
+
+  int delta = 5;
+  ptr.callByName("increase", {delta});
+  EXPECT_EQ(counter.value_m, 5);
+
+  int value = 0;
+  ptr.callByName("value", {}, value);
+  EXPECT_EQ(value, 5);
+  // results can be ignored
+  ptr.callByName("value");
+
+  // parameters taken by value get a copy
+  std::string name = "counter";
+  ptr.callByName("rename", {name});
+  EXPECT_EQ(counter.name_m, "counter");
+  EXPECT_EQ(name, "counter");
+
+  std::string label;
+  ptr.callByName("get_label", {}, label);
+  EXPECT_EQ(label, "counter");
+
+  // arguments from a runtime container
+  std::vector<DynamicArgument> arguments = {DynamicArgument(delta)};
+  ptr.callByName("increase", arguments);
+  EXPECT_EQ(counter.value_m, 10);
+
+  CounterPtr const const_ptr = ptr;
+  const_ptr.callByName("value", {}, value);
+  EXPECT_EQ(value, 10);
+}
+
+TEST(DynamicCall, MismatchesThrow) {
+  using namespace plugins;
+  Counter counter;
+  CounterPtr ptr{&counter};
+
+  int delta = 1;
+  long wrong_delta = 1;
+  int const const_delta = 2;
+  EXPECT_THROW(ptr.callByName("decrease", {delta}), DynamicCallError);
+  EXPECT_THROW(ptr.callByName("increase"), DynamicCallError);
+  EXPECT_THROW(ptr.callByName("increase", {delta, delta}), DynamicCallError);
+  EXPECT_THROW(ptr.callByName("increase", {wrong_delta}), DynamicCallError);
+  EXPECT_THROW(ptr.callByName("value", {}, wrong_delta), DynamicCallError);
+  // const arguments can be copied
+  ptr.callByName("increase", {const_delta});
+  EXPECT_EQ(counter.value_m, 2);
+
+  CounterPtr const const_ptr = ptr;
+  EXPECT_THROW(const_ptr.callByName("increase", {delta}), DynamicCallError);
+  EXPECT_EQ(counter.value_m, 2);
+}
@@ -0,0 +1,140 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    instrumentation_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for call statistics(CXX_PLUGINS_INSTRUMENT)
+ */
+
+#include <cxx_plugins/instrumentation.hpp>
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+struct instrumented_step {};
+struct instrumented_value {};
+
+struct Walker {
+  int position_m = 0;
+};
+struct Runner {
+  int position_m = 0;
+};
+
+template <typename T> void polymorphicExtend(instrumented_step, T &obj) {
+  ++obj.position_m;
+}
+template <typename T>
+auto polymorphicExtend(instrumented_value, T const &obj) -> int {
+  return obj.position_m;
+}
+
+auto countOf(plugins::type_index tag, plugins::type_index type)
+    -> std::uint64_t {
+  std::uint64_t result = 0;
+  for (auto const &statistics : plugins::collectCallStatistics()) {
+    if (statistics.tag == tag && statistics.type == type) {
+      result += statistics.count;
+    }
+  }
+  return result;
+}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<instrumented_step> {
+  using Type = void();
+};
+template <> struct plugins::PolymorphicTagSignature<instrumented_value> {
+  using Type = int() const;
+};
+
+//! \brief Has a unique name, so its priority can be written
+struct profiled_step {};
+
+template <> struct plugins::PolymorphicTagSignature<profiled_step> {
+  using Type = void();
+};
+
+template <typename T> void polymorphicExtend(profiled_step, T &obj) {
+  obj.position_m += 2;
+}
+
+TEST(Instrumentation, CountsCallsPerTagAndType) {
+  using namespace plugins;
+  using PolymorphicT = Polymorphic<Tag<instrumented_step>,
+                                   Tag<instrumented_value>>;
+  PolymorphicT walker = Walker{};
+  PolymorphicT runner = Runner{};
+
+  auto const step = type_id<Tag<instrumented_step>>();
+  auto const walker_steps = countOf(step, type_id<Walker>());
+
+  for (int i = 0; i < 3; ++i) {
+    walker.call<Tag<instrumented_step>>();
+  }
+  // counters of other threads are merged as well
+  std::thread([&runner] {
+    runner.call<Tag<instrumented_step>>();
+  }).join();
+  EXPECT_EQ(walker.call<Tag<instrumented_value>>(), 3);
+
+#if CXX_PLUGINS_INSTRUMENT
+  EXPECT_EQ(countOf(step, type_id<Walker>()) - walker_steps, 3);
+  EXPECT_GE(countOf(step, type_id<Runner>()), 1);
+
+  std::stringstream out;
+  writeCallStatistics(out);
+  EXPECT_NE(out.str().find("Walker"), std::string::npos);
+#else
+  EXPECT_EQ(walker_steps, 0);
+  EXPECT_TRUE(collectCallStatistics().empty());
+#endif
+}
+
+TEST(Instrumentation, WritesSlotPrioritiesOfCalledTags) {
+  using namespace plugins;
+  Polymorphic<Tag<instrumented_step>, Tag<profiled_step>> walker = Walker{};
+  walker.call<Tag<profiled_step>>();
+  walker.call<Tag<instrumented_step>>();
+
+  std::stringstream out;
+  writeSlotPriorities(out);
+  EXPECT_NE(out.str().find("#pragma once"), std::string::npos);
+  // tags from anonymous namespaces can't be specialized
+  EXPECT_EQ(out.str().find("instrumented_step"), std::string::npos);
+#if CXX_PLUGINS_INSTRUMENT
+  auto const priority_pos = out.str().find("VTableSlotPriority<");
+  EXPECT_NE(priority_pos, std::string::npos);
+  EXPECT_NE(out.str().find("profiled_step", priority_pos), std::string::npos);
+#else
+  EXPECT_EQ(out.str().find("VTableSlotPriority"), std::string::npos);
+#endif
+}
+
+TEST(Instrumentation, SitesOutliveInfosOfTheirLibraries) {
+  using namespace plugins;
+  // info of a plugin, its name is overwritten as if the plugin was unloaded
+  std::string name = "unloaded_plugin::Type";
+  impl::TypeInfo const info{name.c_str(), name.size(), impl::fnv1a(name)};
+  auto const site_id = impl::registerCallSite(info, info, info);
+  impl::increment(impl::callCounter(site_id).count);
+  name.assign(name.size(), '?');
+
+  std::stringstream out;
+  writeCallStatistics(out);
+  EXPECT_NE(out.str().find("unloaded_plugin::Type\tunloaded_plugin::Type"),
+            std::string::npos)
+      << out.str();
+}
@@ -0,0 +1,154 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    intrusive_polymorphic_ptr_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for IntrusivePolymorphicPtr
+ */
+
+#include <cxx_plugins/intrusive_polymorphic_ptr.hpp>
+#include <cxx_plugins/visit.hpp>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+
+namespace {
+struct add {};
+struct stringify {};
+
+struct Counter {
+  explicit Counter(int value, int *destroyed_p = nullptr)
+      : value_m(value), destroyed_p_m(destroyed_p) {}
+  Counter(Counter const &) = delete;
+  ~Counter() {
+    if (destroyed_p_m != nullptr)
+      ++*destroyed_p_m;
+  }
+  void add(int i) { value_m += i; }
+  [[nodiscard]] auto stringify() const -> std::string {
+    return std::to_string(value_m);
+  }
+
+  int value_m;
+  int *destroyed_p_m;
+};
+
+struct alignas(64) Aligned {
+  void add(int i) { value_m += i; }
+  [[nodiscard]] auto stringify() const -> std::string {
+    return "aligned " + std::to_string(value_m);
+  }
+
+  int value_m = 0;
+};
+
+template <typename T> void polymorphicExtend(add /*unused*/, T &obj, int i) {
+  obj.add(i);
+}
+template <typename T>
+auto polymorphicExtend(stringify /*unused*/, T const &obj) -> std::string {
+  return obj.stringify();
+}
+
+//! \brief Counts allocated bytes, memory is taken from new_delete_resource
+class CountingResource : public std::pmr::memory_resource {
+public:
+  std::size_t allocated_m = 0;
+  std::size_t deallocated_m = 0;
+
+private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void * override {
+    allocated_m += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    deallocated_m += bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  auto do_is_equal(std::pmr::memory_resource const &rhs) const noexcept
+      -> bool override {
+    return this == &rhs;
+  }
+};
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<add> {
+  using Type = void(int);
+};
+template <> struct plugins::PolymorphicTagSignature<stringify> {
+  using Type = std::string() const;
+};
+
+TEST(IntrusivePolymorphicPtr, CallsThroughHeaderOfObject) {
+  using namespace plugins;
+  using PtrT = IntrusivePolymorphicPtr<add, stringify>;
+  static_assert(sizeof(PtrT) == sizeof(void *));
+  static_assert(is_polymorphic_ref_v<PtrT>);
+
+  CountingResource resource;
+  int destroyed = 0;
+  auto ptr = PtrT::make<Counter>(&resource, 1, &destroyed);
+  auto aligned = PtrT::make<Aligned>(&resource);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned.data()) % 64, 0);
+
+  ptr.call<add>(2);
+  ptr[add{}](3);
+  aligned.call<add>(4);
+  EXPECT_EQ(ptr.call<stringify>(), "6");
+  EXPECT_EQ(std::as_const(aligned).call<stringify>(), "aligned 4");
+  EXPECT_TRUE(ptr.isA<Counter>());
+  EXPECT_EQ(aligned.typeIndex(), type_id<Aligned>());
+  EXPECT_EQ(polymorphicCast<Counter>(ptr)->value_m, 6);
+  EXPECT_EQ(polymorphicCast<Counter>(aligned), nullptr);
+
+  auto copy = ptr;
+  EXPECT_EQ(copy, ptr);
+  EXPECT_NE(copy, aligned);
+
+  ptr.destroy(&resource);
+  aligned.destroy(&resource);
+  EXPECT_TRUE(ptr.isEmpty());
+  EXPECT_EQ(ptr.typeIndex(), type_id<void>());
+  EXPECT_EQ(destroyed, 1);
+  EXPECT_EQ(resource.allocated_m, resource.deallocated_m);
+}
+
+TEST(IntrusivePolymorphicPtr, ConvertsToPolymorphicPtr) {
+  using namespace plugins;
+  CountingResource resource;
+  auto ptr = IntrusivePolymorphicPtr<add, stringify>::make<Counter>(&resource,
+                                                                    1);
+
+  PolymorphicPtr<add, stringify> fat = ptr;
+  fat.call<add>(1);
+  EXPECT_EQ(ptr.call<stringify>(), "2");
+  EXPECT_EQ(fat.data(), ptr.data());
+
+  // upcasts go through PolymorphicPtr
+  PolymorphicPtr<stringify, add> reordered = fat;
+  PolymorphicPtr<stringify> narrow = fat;
+  reordered.call<add>(1);
+  EXPECT_EQ(narrow.call<stringify>(), "3");
+  InlinePolymorphicPtr<add> inline_ptr = ptr;
+  inline_ptr.call<add>(1);
+  EXPECT_EQ(ptr.call<stringify>(), "4");
+
+  auto describe = Overloaded{
+      [](Counter const &counter) { return counter.value_m; },
+      [](UnknownType /*unused*/) { return -1; }};
+  EXPECT_EQ(visit<TypeList<Counter>>(ptr, describe), 4);
+
+  ptr.destroy(&resource);
+  EXPECT_TRUE(ptr.toPolymorphicPtr().isEmpty());
+  EXPECT_EQ(resource.allocated_m, resource.deallocated_m);
+}
@@ -0,0 +1,140 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    multi_vtable_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for MultiVTable
+ */
+
+#include <cxx_plugins/multi_vtable.hpp>
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+struct collide {};
+struct merge {};
+struct name {};
+struct touch {};
+
+struct Circle {
+  int radius_m = 1;
+};
+struct Box {
+  int side_m = 2;
+};
+struct Plane {};
+
+auto polymorphicExtend(collide /*unused*/, Circle const &lhs, Circle const &rhs,
+                       int scale) -> std::string {
+  return "circle-circle " + std::to_string((lhs.radius_m + rhs.radius_m) * scale);
+}
+auto polymorphicExtend(collide /*unused*/, Circle const &lhs, Box const &rhs,
+                       int scale) -> std::string {
+  return "circle-box " + std::to_string((lhs.radius_m + rhs.side_m) * scale);
+}
+
+void polymorphicExtend(merge /*unused*/, Box &lhs, Circle &rhs) {
+  lhs.side_m += rhs.radius_m;
+  rhs.radius_m = 0;
+}
+
+template <typename T> auto polymorphicExtend(name /*unused*/, T const &) -> int {
+  return 0;
+}
+
+template <typename T> void polymorphicExtend(touch /*unused*/, T &) {}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<name> {
+  using Type = int() const;
+};
+template <> struct plugins::PolymorphicTagSignature<touch> {
+  using Type = void();
+};
+
+TEST(MultiVTable, DispatchesOnBothTypes) {
+  using namespace plugins;
+  using PolymorphicT = Polymorphic<Tag<name>>;
+  MultiVTable<collide, std::string(int) const> collisions(
+      TypeList<Circle, Box, Plane>{});
+  EXPECT_EQ(collisions.typeCount(), 2);
+
+  PolymorphicT circle = Circle{3};
+  PolymorphicT box = Box{4};
+  PolymorphicT plane = Plane{};
+  EXPECT_EQ(collisions(circle, circle, 2), "circle-circle 12");
+  EXPECT_EQ(collisions(circle, box, 1), "circle-box 7");
+  EXPECT_FALSE(collisions.contains(box, circle));
+  EXPECT_FALSE(collisions.contains(circle, plane));
+  EXPECT_FALSE(collisions.contains(circle, PolymorphicT{}));
+
+  collisions.addSymmetric<Circle, Box>();
+  EXPECT_EQ(collisions(box, circle, 1), "circle-box 7");
+
+  // pointers with another interface work as well
+  PolymorphicPtr<Tag<name>> circle_ptr = circle;
+  EXPECT_EQ(collisions(circle_ptr, box, 1), "circle-box 7");
+}
+
+TEST(MultiVTable, NonConstFunctions) {
+  using namespace plugins;
+  MultiVTable<merge, void()> merges;
+  merges.add<Box, Circle>();
+
+  Box box;
+  Circle circle{5};
+  PolymorphicPtr<Tag<touch>> box_ptr(&box);
+  PolymorphicPtr<Tag<touch>> circle_ptr(&circle);
+  merges(box_ptr, circle_ptr);
+  EXPECT_EQ(box.side_m, 7);
+  EXPECT_EQ(circle.radius_m, 0);
+  EXPECT_FALSE(merges.contains(circle_ptr, box_ptr));
+}
+
+namespace {
+//! \brief Object whose type info is another object, as in another plugin
+struct ForeignObject {
+  struct Table {
+    auto header() const noexcept -> plugins::impl::VTableHeader const & {
+      return header_m;
+    }
+    plugins::impl::VTableHeader header_m;
+  };
+
+  auto isEmpty() const noexcept -> bool { return false; }
+  auto functionTable() const noexcept -> Table const & { return table_m; }
+  auto data() const noexcept -> void const * { return obj_p; }
+
+  Table table_m;
+  void const *obj_p;
+};
+} // namespace
+
+TEST(MultiVTable, TypesFromOtherLibraries) {
+  using namespace plugins;
+  MultiVTable<collide, std::string(int) const> collisions(
+      TypeList<Circle, Box>{});
+
+  auto const &circle_info = impl::internTypeInfo(
+      static_cast<std::string_view>(impl::typeInfoConstruct<Circle>()));
+  ASSERT_NE(&circle_info, &impl::typeInfoConstruct<Circle>());
+
+  Circle circle{2};
+  VTable<TaggedSignature<name, int() const>> table(std::in_place_type<Circle>);
+  ForeignObject foreign{{table.header()}, &circle};
+  foreign.table_m.header_m.type_info = &circle_info;
+
+  Box box{3};
+  PolymorphicPtr<Tag<name>> box_ptr(&box);
+  EXPECT_EQ(collisions(foreign, box_ptr, 1), "circle-box 5");
+  EXPECT_FALSE(collisions.contains(box_ptr, foreign));
+}
@@ -422,4 +422,33 @@
 //
 //  parse(doc, result);
 //  EXPECT_EQ(result, expected);
-//}
\ No newline at end of file
+//}
+
+#include <cxx_plugins/parser.hpp>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+TEST(ParserTests, NestedErrorsKeepRootCause) {
+  using namespace plugins;
+  // long names of allocator aware containers fill the message quickly
+  using InnerT = std::vector<int, std::pmr::polymorphic_allocator<int>>;
+  using OuterT = std::vector<InnerT, std::pmr::polymorphic_allocator<InnerT>>;
+  using MapT = std::map<std::string, std::vector<OuterT>>;
+  rapidjson::Document document;
+  document.Parse(R"({"first": [[[1, 2], [3, "four"]]]})");
+
+  MapT result;
+  try {
+    parse(document, result);
+    FAIL() << "TypeMismatch wasn't thrown";
+  } catch (TypeMismatch const &error) {
+    std::string_view const message = error.what();
+    EXPECT_EQ(message.rfind("Failed to get type 'int'", 0), 0) << message;
+    EXPECT_NE(message.find("at index 1"), std::string_view::npos) << message;
+  }
+}
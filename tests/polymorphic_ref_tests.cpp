@@ -12,6 +12,7 @@
  * $BRIEF$
  */
 
+#include <cxx_plugins/polymorphic.hpp>
 #include <cxx_plugins/polymorphic_allocator.hpp>
 #include <cxx_plugins/polymorphic_ptr.hpp>
 #include <gtest/gtest.h>
@@ -19,6 +20,7 @@
 struct add {};
 struct multiply {};
 struct stringify {};
+struct subtract {};
 
 template <> struct plugins::PolymorphicTagSignature<add> {
   using Type = void(int);
@@ -29,6 +31,9 @@ template <> struct plugins::PolymorphicTagSignature<multiply> {
 template <> struct plugins::PolymorphicTagSignature<stringify> {
   using Type = std::string() const;
 };
+template <> struct plugins::PolymorphicTagSignature<subtract> {
+  using Type = void(int);
+};
 
 template <typename T>
 constexpr void polymorphicExtend(add /*unused*/, T &obj, int val) {
@@ -46,9 +51,15 @@ inline auto polymorphicExtend(stringify /*unused*/, T const &obj)
   return obj.stringify();
 }
 
+template <typename T>
+constexpr void polymorphicExtend(subtract /*unused*/, T &obj, int val) {
+  obj.subtract(val);
+}
+
 struct foo {
   void add(int i) { i_m += i; }
   void multiply(int i) { i_m *= i; }
+  void subtract(int i) { i_m -= i; }
   [[nodiscard]] auto stringify() const -> std::string {
     return std::to_string(i_m);
   }
@@ -164,4 +175,102 @@ TEST(PolymorphicRef, Reorder) {
   EXPECT_EQ(obj0.i_m, 20);
   ref1.call<add>(20);
   EXPECT_EQ(obj0.i_m, 40);
-}
\ No newline at end of file
+}
+
+TEST(PolymorphicRef, InlineFunctionTable) {
+  using namespace plugins;
+  foo obj0;
+  InlinePolymorphicPtr<add, multiply, stringify> inline_ptr(&obj0);
+  static_assert(std::is_same_v<
+                decltype(inline_ptr)::FunctionTableT,
+                InlineVTable<TaggedSignature<add, void(int)>,
+                             TaggedSignature<multiply, void(int)>,
+                             TaggedSignature<stringify, std::string() const>>>);
+  EXPECT_EQ(sizeof(inline_ptr), 5 * sizeof(void *));
+  EXPECT_TRUE(inline_ptr.isA<foo>());
+
+  inline_ptr.call<add>(3);
+  inline_ptr[multiply{}](2);
+  EXPECT_EQ(obj0.i_m, 6);
+  EXPECT_EQ(inline_ptr.call<stringify>(), "6");
+
+  // Conversion from table with more functions in different order
+  PolymorphicPtr<stringify, multiply, add> ptr(&obj0);
+  InlinePolymorphicPtr<add, stringify> narrow_ptr(ptr);
+  EXPECT_EQ(narrow_ptr.typeIndex(), type_id<foo>());
+  narrow_ptr.call<add>(1);
+  EXPECT_EQ(narrow_ptr.call<stringify>(), "7");
+
+  InlinePolymorphicPtr<add> empty;
+  EXPECT_TRUE(empty.isEmpty());
+  EXPECT_EQ(empty.typeIndex(), type_id<void>());
+}
+
+TEST(PolymorphicRef, CompactFunctionTableForBigInterfaces) {
+  using namespace plugins;
+  using BigInterfacePtr =
+      InlinePolymorphicPtr<add, multiply, stringify, subtract>;
+  EXPECT_EQ(sizeof(BigInterfacePtr), 2 * sizeof(void *));
+
+  foo obj0;
+  BigInterfacePtr big_ptr(&obj0);
+  EXPECT_TRUE(big_ptr.isA<foo>());
+  EXPECT_FALSE(big_ptr.isA<int>());
+  EXPECT_EQ(big_ptr.typeIndex(), type_id<foo>());
+
+  big_ptr.call<add>(5);
+  big_ptr[multiply{}](3);
+  big_ptr.call<subtract>(1);
+  EXPECT_EQ(obj0.i_m, 14);
+  EXPECT_EQ(big_ptr.call<stringify>(), "14");
+}
+
+TEST(PolymorphicRef, UpcastingWithoutPermutations) {
+  using namespace plugins;
+  foo obj0;
+  foo obj1;
+  PolymorphicPtr<add, multiply, stringify> wide0(&obj0);
+  PolymorphicPtr<add, multiply, stringify> wide1(&obj1);
+  EXPECT_EQ(sizeof(wide0), 2 * sizeof(void *));
+
+  // prefix of the interface reuses the table
+  PolymorphicPtr<add, multiply> prefix(wide0);
+  EXPECT_EQ(&prefix.functionTable().header(), &wide0.functionTable().header());
+
+  // other subsets use interned table, shared by all objects of the type
+  PolymorphicPtr<stringify, add> reordered0(wide0);
+  PolymorphicPtr<stringify, add> reordered1(wide1);
+  EXPECT_NE(&reordered0.functionTable().header(),
+            &wide0.functionTable().header());
+  EXPECT_EQ(&reordered0.functionTable().header(),
+            &reordered1.functionTable().header());
+  EXPECT_TRUE(reordered0.isA<foo>());
+
+  reordered0.call<add>(5);
+  reordered1 = wide0;
+  EXPECT_EQ(reordered1.call<stringify>(), "5");
+
+  PolymorphicPtr<add, stringify> empty_source;
+  PolymorphicPtr<stringify, add> empty(empty_source);
+  EXPECT_TRUE(empty.isEmpty());
+}
+
+TEST(PolymorphicRef, UpcastingFromPolymorphicWithoutPermutations) {
+  using namespace plugins;
+  Polymorphic<add, multiply, stringify> poly{foo{}};
+
+  // internal functions of Polymorphic follow the functions of the tags
+  PolymorphicPtr<add, multiply, stringify> same(poly);
+  EXPECT_EQ(&same.functionTable().header(), &poly.functionTable().header());
+  PolymorphicPtr<add, multiply> prefix(poly);
+  EXPECT_EQ(&prefix.functionTable().header(), &poly.functionTable().header());
+  UniquePolymorphic<add, multiply> unique{foo{}};
+  PolymorphicPtr<add> unique_prefix(unique);
+  EXPECT_EQ(&unique_prefix.functionTable().header(),
+            &unique.functionTable().header());
+
+  same.call<add>(2);
+  prefix.call<multiply>(3);
+  EXPECT_EQ(poly.call<stringify>(), "6");
+  EXPECT_TRUE(same.isA<foo>());
+}
@@ -0,0 +1,555 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_storage_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    12 Oct 2020
+ * \brief
+ * Contains tests for storage policies of Polymorphic
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+
+#include <gtest/gtest.h>
+
+#include <memory_resource>
+#include <stdexcept>
+
+namespace {
+struct increment {};
+struct value {};
+
+struct Counter {
+  Counter() noexcept { ++alive; }
+  Counter(Counter const &other) noexcept : i_m(other.i_m) { ++alive; }
+  Counter(Counter &&other) noexcept : i_m(other.i_m) { ++alive; }
+  ~Counter() { --alive; }
+
+  int i_m = 0;
+  static int alive;
+};
+int Counter::alive = 0;
+
+struct BigCounter : Counter {
+  char padding_m[256] = {};
+};
+
+struct alignas(32) AlignedCounter : Counter {
+  float lanes_m[8] = {};
+};
+
+struct SelfReferencing {
+  SelfReferencing() noexcept = default;
+  SelfReferencing(SelfReferencing const &other) noexcept : i_m(other.i_m) {}
+  SelfReferencing(SelfReferencing &&other) noexcept : i_m(other.i_m) {}
+
+  int i_m = 0;
+  SelfReferencing *self_m = this;
+};
+
+struct Relocatable : Counter {
+  Relocatable() noexcept = default;
+  Relocatable(Relocatable const &other) noexcept = default;
+  Relocatable(Relocatable &&other) noexcept : Counter(std::move(other)) {
+    ++moves;
+  }
+
+  static int moves;
+};
+int Relocatable::moves = 0;
+
+template <typename T> void polymorphicExtend(increment /*unused*/, T &obj) {
+  ++obj.i_m;
+}
+template <typename T>
+auto polymorphicExtend(value /*unused*/, T const &obj) -> int {
+  return obj.i_m;
+}
+
+class CountingResource : public std::pmr::memory_resource {
+public:
+  int allocations = 0;
+  int deallocations = 0;
+
+private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment)
+      -> void * override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  auto do_is_equal(std::pmr::memory_resource const &other) const noexcept
+      -> bool override {
+    return this == &other;
+  }
+};
+} // namespace
+
+template <>
+struct plugins::IsTriviallyRelocatable<Relocatable> : std::true_type {};
+
+template <> struct plugins::PolymorphicTagSignature<increment> {
+  using Type = void();
+};
+template <> struct plugins::PolymorphicTagSignature<value> {
+  using Type = int() const;
+};
+
+template <typename StoragePolicy>
+using CounterPolymorphic =
+    plugins::BasicPolymorphic<StoragePolicy, increment, value>;
+
+template <typename StoragePolicy> class PolymorphicStorage : public testing::Test {};
+
+using OwningPolicies =
+    testing::Types<plugins::InlineStorage<sizeof(BigCounter)>,
+                   plugins::HeapStorage, plugins::HybridStorage<64>,
+                   plugins::HybridStorage<sizeof(void *)>,
+                   plugins::HybridStorage<512>>;
+TYPED_TEST_SUITE(PolymorphicStorage, OwningPolicies);
+
+TYPED_TEST(PolymorphicStorage, Lifetime) {
+  using PolymorphicT = CounterPolymorphic<TypeParam>;
+  ASSERT_EQ(Counter::alive, 0);
+  {
+    PolymorphicT small{Counter{}};
+    PolymorphicT big{BigCounter{}};
+    EXPECT_EQ(Counter::alive, 2);
+
+    small.template call<increment>();
+    big.template call<increment>();
+    big.template call<increment>();
+
+    PolymorphicT small_copy = small;
+    PolymorphicT big_copy = big;
+    EXPECT_EQ(Counter::alive, 4);
+    EXPECT_EQ(small_copy.template call<value>(), 1);
+    EXPECT_EQ(big_copy.template call<value>(), 2);
+
+    PolymorphicT moved = std::move(big);
+    EXPECT_TRUE(big.isEmpty());
+    EXPECT_EQ(moved.template call<value>(), 2);
+    EXPECT_EQ(Counter::alive, 4);
+
+    small_copy = moved;
+    EXPECT_EQ(small_copy.template call<value>(), 2);
+    EXPECT_EQ(Counter::alive, 4);
+
+    moved.reset();
+    EXPECT_TRUE(moved.isEmpty());
+    EXPECT_EQ(moved.data(), nullptr);
+    EXPECT_EQ(Counter::alive, 3);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, Layout) {
+  using namespace plugins;
+  static_assert(sizeof(HeapStorage) == sizeof(void *));
+  static_assert(sizeof(ReferenceStorage) == sizeof(void *));
+  static_assert(InlineStorage<16>::can_store<int>);
+  static_assert(!InlineStorage<16>::can_store<BigCounter>);
+  static_assert(HybridStorage<64>::is_stored_inline<Counter>);
+  static_assert(!HybridStorage<64>::is_stored_inline<BigCounter>);
+  static_assert(HybridStorage<64>::is_stored_inline<char[64]>);
+  static_assert(HybridStorage<512>::is_stored_inline<BigCounter>);
+  static_assert(sizeof(HybridStorage<sizeof(void *)>) == sizeof(void *));
+
+  CounterPolymorphic<InlineStorage<sizeof(BigCounter)>> inline_poly{
+      BigCounter{}};
+  EXPECT_EQ(inline_poly.data(), static_cast<void *>(&inline_poly));
+
+  CounterPolymorphic<HeapStorage> heap_poly{Counter{}};
+  EXPECT_NE(heap_poly.data(), static_cast<void *>(&heap_poly));
+}
+
+TEST(PolymorphicStorage, EmplaceThrowsOnlyIfPolicyAllocates) {
+  using namespace plugins;
+  struct Throwing : Counter {
+    explicit Throwing(bool should_throw) {
+      if (should_throw)
+        throw std::runtime_error("constructor");
+    }
+  };
+  using InlineT = CounterPolymorphic<InlineStorage<16>>;
+  using HeapT = CounterPolymorphic<HeapStorage>;
+  static_assert(noexcept(std::declval<InlineT &>().emplace(
+      std::in_place_type_t<Counter>{})));
+  static_assert(!noexcept(std::declval<HeapT &>().emplace(
+      std::in_place_type_t<Counter>{})));
+  static_assert(!noexcept(std::declval<InlineT &>().emplace(
+      std::in_place_type_t<Throwing>{}, true)));
+
+  CountingResource resource;
+  HeapT poly{Counter{}};
+  EXPECT_THROW(poly.emplace(std::allocator_arg, &resource,
+                            std::in_place_type_t<Throwing>{}, true),
+               std::runtime_error);
+  EXPECT_TRUE(poly.isEmpty());
+  EXPECT_EQ(resource.allocations, resource.deallocations);
+  EXPECT_EQ(Counter::alive, 0);
+  poly.emplace(std::in_place_type_t<Throwing>{}, false);
+  EXPECT_TRUE(poly.isA<Throwing>());
+}
+
+TEST(PolymorphicStorage, NonMovableTypesAreAllocated) {
+  using namespace plugins;
+  struct NonMovable : Counter {
+    NonMovable() noexcept = default;
+    NonMovable(NonMovable &&) = delete;
+  };
+  using PolymorphicT =
+      BasicUniquePolymorphic<HeapStorage, increment, value>;
+  {
+    PolymorphicT poly;
+    poly.emplace(std::in_place_type_t<NonMovable>{});
+    poly.call<increment>();
+    auto const *obj_p = poly.data();
+    PolymorphicT moved = std::move(poly);
+    EXPECT_EQ(moved.data(), obj_p);
+    EXPECT_EQ(moved.call<value>(), 1);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, LargeInlineBuffer) {
+  using namespace plugins;
+  struct HugeCounter : Counter {
+    char padding_m[4000] = {};
+  };
+  using PolymorphicT = CounterPolymorphic<HybridStorage<4096>>;
+  static_assert(PolymorphicT::StoragePolicyT::is_stored_inline<HugeCounter>);
+  {
+    PolymorphicT poly{HugeCounter{}};
+    EXPECT_EQ(poly.data(), static_cast<void *>(&poly));
+    poly.call<increment>();
+
+    PolymorphicT copy = poly;
+    PolymorphicT moved = std::move(poly);
+    EXPECT_EQ(moved.data(), static_cast<void *>(&moved));
+    EXPECT_EQ(moved.call<value>(), 1);
+    EXPECT_EQ(copy.call<value>(), 1);
+    EXPECT_EQ(Counter::alive, 2);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, OverAlignedTypes) {
+  using namespace plugins;
+  auto is_aligned = [](void const *ptr) {
+    return reinterpret_cast<std::uintptr_t>(ptr) % alignof(AlignedCounter) ==
+           0;
+  };
+  static_assert(!HybridStorage<64>::is_stored_inline<AlignedCounter>);
+  static_assert(HybridStorage<64, 32>::is_stored_inline<AlignedCounter>);
+  static_assert(!InlineStorage<64>::can_store<AlignedCounter>);
+  static_assert(InlineStorage<64, 32>::can_store<AlignedCounter>);
+  {
+    CounterPolymorphic<HybridStorage<64>> fallback{AlignedCounter{}};
+    EXPECT_NE(fallback.data(), static_cast<void *>(&fallback));
+    EXPECT_TRUE(is_aligned(fallback.data()));
+
+    CounterPolymorphic<HybridStorage<64, 32>> hybrid{AlignedCounter{}};
+    EXPECT_EQ(hybrid.data(), static_cast<void *>(&hybrid));
+    EXPECT_TRUE(is_aligned(hybrid.data()));
+
+    CounterPolymorphic<InlineStorage<64, 32>> inline_poly{AlignedCounter{}};
+    EXPECT_TRUE(is_aligned(inline_poly.data()));
+
+    auto copy = hybrid;
+    auto moved = std::move(copy);
+    EXPECT_TRUE(is_aligned(moved.data()));
+    EXPECT_EQ(Counter::alive, 4);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, RelocationOfSelfReferencingType) {
+  using namespace plugins;
+  using PolymorphicT = CounterPolymorphic<HybridStorage<64>>;
+  static_assert(!is_trivially_relocatable<SelfReferencing>);
+
+  PolymorphicT poly{SelfReferencing{}};
+  poly.call<increment>();
+  EXPECT_FALSE(poly.isTriviallyRelocatable());
+
+  PolymorphicT moved = std::move(poly);
+  auto *obj_p = static_cast<SelfReferencing *>(moved.data());
+  EXPECT_EQ(obj_p->self_m, obj_p);
+  EXPECT_EQ(moved.call<value>(), 1);
+
+  PolymorphicT assigned;
+  assigned = std::move(moved);
+  obj_p = static_cast<SelfReferencing *>(assigned.data());
+  EXPECT_EQ(obj_p->self_m, obj_p);
+}
+
+TEST(PolymorphicStorage, TriviallyRelocatableOptIn) {
+  using namespace plugins;
+  using PolymorphicT = CounterPolymorphic<HybridStorage<64>>;
+  static_assert(is_trivially_relocatable<Relocatable>);
+  Relocatable::moves = 0;
+  {
+    PolymorphicT poly{Relocatable{}};
+    auto const moves_after_construction = Relocatable::moves;
+    EXPECT_TRUE(poly.isTriviallyRelocatable());
+
+    PolymorphicT moved = std::move(poly);
+    EXPECT_EQ(Relocatable::moves, moves_after_construction);
+    EXPECT_EQ(Counter::alive, 1);
+    EXPECT_EQ(moved.call<value>(), 0);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, UninitializedRelocate) {
+  using namespace plugins;
+  using PolymorphicT = CounterPolymorphic<HybridStorage<64>>;
+  constexpr std::size_t count = 4;
+  using Buffer =
+      std::aligned_storage_t<sizeof(PolymorphicT), alignof(PolymorphicT)>;
+
+  auto test = [](auto make) {
+    Buffer src[count];
+    Buffer dst[count];
+    auto *src_p = reinterpret_cast<PolymorphicT *>(src);
+    auto *dst_p = reinterpret_cast<PolymorphicT *>(dst);
+    for (std::size_t i = 0; i < count; ++i) {
+      new (src_p + i) PolymorphicT(make());
+      for (std::size_t j = 0; j < i; ++j) {
+        src_p[i].template call<increment>();
+      }
+    }
+    EXPECT_EQ(uninitializedRelocate(src_p, src_p + count, dst_p),
+              dst_p + count);
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(dst_p[i].template call<value>(), static_cast<int>(i));
+      dst_p[i].~PolymorphicT();
+    }
+  };
+
+  test([] { return Relocatable{}; });
+  EXPECT_EQ(Counter::alive, 0);
+  test([] { return SelfReferencing{}; });
+  test([] { return BigCounter{}; });
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, Reference) {
+  using namespace plugins;
+  Counter counter;
+  {
+    CounterPolymorphic<ReferenceStorage> ref{counter};
+    EXPECT_EQ(ref.data(), &counter);
+    ref.call<increment>();
+
+    auto copy = ref;
+    copy.call<increment>();
+    EXPECT_EQ(Counter::alive, 1);
+  }
+  EXPECT_EQ(counter.i_m, 2);
+  EXPECT_EQ(Counter::alive, 1);
+}
+
+TEST(PolymorphicStorage, ConversionToPolymorphicPtr) {
+  using namespace plugins;
+  CounterPolymorphic<HeapStorage> poly{Counter{}};
+  PolymorphicPtr<increment> ptr = poly;
+  ptr.call<increment>();
+  EXPECT_EQ(poly.call<value>(), 1);
+}
+
+template <typename StoragePolicy>
+class SharedPolymorphicStorage : public testing::Test {};
+
+using SharedPolicies =
+    testing::Types<plugins::SharedStorage<plugins::AtomicRefCount>,
+                   plugins::SharedStorage<plugins::LocalRefCount>>;
+TYPED_TEST_SUITE(SharedPolymorphicStorage, SharedPolicies);
+
+TYPED_TEST(SharedPolymorphicStorage, CopyOnWrite) {
+  using PolymorphicT = CounterPolymorphic<TypeParam>;
+  ASSERT_EQ(Counter::alive, 0);
+  {
+    PolymorphicT original{BigCounter{}};
+    PolymorphicT copy = original;
+    PolymorphicT const &const_copy = copy;
+    EXPECT_EQ(Counter::alive, 1);
+    EXPECT_EQ(const_copy.data(), std::as_const(original).data());
+
+    // const functions don't copy, even if called for non-const object
+    EXPECT_EQ(copy.template call<value>(), 0);
+    EXPECT_EQ(copy[value{}](), 0);
+    EXPECT_EQ(Counter::alive, 1);
+
+    copy.template call<increment>();
+    EXPECT_EQ(Counter::alive, 2);
+    EXPECT_NE(const_copy.data(), std::as_const(original).data());
+    EXPECT_EQ(copy.template call<value>(), 1);
+    EXPECT_EQ(original.template call<value>(), 0);
+
+    // unique object is modified in place
+    auto const *data_p = const_copy.data();
+    copy[increment{}]();
+    EXPECT_EQ(const_copy.data(), data_p);
+    EXPECT_EQ(copy.template call<value>(), 2);
+    EXPECT_EQ(Counter::alive, 2);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TYPED_TEST(SharedPolymorphicStorage, Lifetime) {
+  using PolymorphicT = CounterPolymorphic<TypeParam>;
+  ASSERT_EQ(Counter::alive, 0);
+  {
+    PolymorphicT first{Counter{}};
+    PolymorphicT second{first};
+    {
+      PolymorphicT third;
+      third = second;
+      PolymorphicT moved = std::move(first);
+      EXPECT_TRUE(first.isEmpty());
+      EXPECT_EQ(Counter::alive, 1);
+    }
+    EXPECT_EQ(Counter::alive, 1);
+
+    second = PolymorphicT{Counter{}};
+    EXPECT_EQ(Counter::alive, 1);
+    second.reset();
+    EXPECT_EQ(Counter::alive, 0);
+
+    second.emplace(std::in_place_type_t<Counter>{});
+    first = second;
+    // const access doesn't copy the shared object, non-const access does
+    EXPECT_EQ(std::as_const(first).data(), std::as_const(second).data());
+    EXPECT_EQ(Counter::alive, 1);
+    EXPECT_NE(first.data(), std::as_const(second).data());
+    EXPECT_EQ(Counter::alive, 2);
+  }
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, SharedPolymorphicLayout) {
+  using namespace plugins;
+  using SharedT = SharedPolymorphic<increment, value>;
+  EXPECT_EQ(sizeof(SharedT),
+            sizeof(void *) + sizeof(SharedT::FunctionTableT));
+  EXPECT_TRUE(SharedT{BigCounter{}}.isTriviallyRelocatable());
+}
+
+TEST(PolymorphicStorage, AllocatorAwareConstruction) {
+  using namespace plugins;
+  using PolymorphicT = CounterPolymorphic<HybridStorage<64>>;
+  CountingResource global;
+  CountingResource local;
+  auto previous = setDefaultMemoryResource(global);
+  {
+    PolymorphicT big{std::allocator_arg, local, BigCounter{}};
+    PolymorphicT small{std::allocator_arg, local, Counter{}};
+    EXPECT_EQ(big.memoryResource().data(), &local);
+    EXPECT_TRUE(small.memoryResource().isEmpty());
+
+    // copies and moves keep the resource of the original
+    PolymorphicT copy = big;
+    PolymorphicT moved = std::move(copy);
+    EXPECT_EQ(moved.memoryResource().data(), &local);
+    EXPECT_EQ(moved.call<value>(), 0);
+
+    moved.emplace(std::allocator_arg, local,
+                  std::in_place_type_t<BigCounter>{});
+    PolymorphicT heap_copy{std::allocator_arg, global, moved};
+    EXPECT_EQ(heap_copy.memoryResource().data(), &global);
+    EXPECT_EQ(global.allocations, 1);
+  }
+  EXPECT_EQ(local.allocations, 3);
+  EXPECT_EQ(local.deallocations, 3);
+  EXPECT_EQ(global.deallocations, 1);
+  EXPECT_EQ(Counter::alive, 0);
+  setDefaultMemoryResource(previous);
+}
+
+TEST(PolymorphicStorage, SharedAllocatorAwareConstruction) {
+  using namespace plugins;
+  CountingResource local;
+  {
+    SharedPolymorphic<increment, value> shared{std::allocator_arg, local,
+                                               Counter{}};
+    auto copy = shared;
+    EXPECT_EQ(local.allocations, 1);
+    copy.call<increment>();
+    EXPECT_EQ(local.allocations, 2);
+    EXPECT_EQ(copy.memoryResource().data(), &local);
+  }
+  EXPECT_EQ(local.deallocations, 2);
+}
+
+TEST(PolymorphicStorage, SharedCopyThrows) {
+  using namespace plugins;
+  struct ThrowingCopy : Counter {
+    ThrowingCopy() = default;
+    ThrowingCopy(ThrowingCopy const & /*unused*/) : Counter() {
+      throw std::runtime_error("copy");
+    }
+    ThrowingCopy(ThrowingCopy &&) noexcept = default;
+  };
+  CountingResource local;
+  {
+    SharedPolymorphic<increment, value> shared{std::allocator_arg, local,
+                                               ThrowingCopy{}};
+    auto copy = shared;
+    EXPECT_THROW(copy.call<increment>(), std::runtime_error);
+    // memory for the copy is freed, the object is still shared
+    EXPECT_EQ(local.allocations, 2);
+    EXPECT_EQ(local.deallocations, 1);
+    EXPECT_EQ(std::as_const(copy).data(), std::as_const(shared).data());
+    EXPECT_EQ(Counter::alive, 1);
+  }
+  EXPECT_EQ(local.deallocations, 2);
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, PolymorphicFor) {
+  using namespace plugins;
+  using Types = TypeList<Counter, BigCounter, AlignedCounter>;
+  using PolymorphicT = PolymorphicFor<Types, increment, value>;
+  EXPECT_EQ(alignof(PolymorphicT), alignof(AlignedCounter));
+  EXPECT_EQ(sizeof(StorageForT<Types>),
+            utility::roundLengthToAlignment(sizeof(BigCounter),
+                                            alignof(AlignedCounter)));
+
+  auto const big_before = fallbackAllocationCount<BigCounter>();
+  auto const aligned_before = fallbackAllocationCount<AlignedCounter>();
+  {
+    PolymorphicT big{BigCounter{}};
+    PolymorphicT aligned{AlignedCounter{}};
+    EXPECT_TRUE(big.memoryResource().isEmpty());
+    EXPECT_TRUE(aligned.memoryResource().isEmpty());
+  }
+  EXPECT_EQ(fallbackAllocationCount<BigCounter>(), big_before);
+  EXPECT_EQ(fallbackAllocationCount<AlignedCounter>(), aligned_before);
+  EXPECT_EQ(Counter::alive, 0);
+}
+
+TEST(PolymorphicStorage, FallbackAllocationCount) {
+  using namespace plugins;
+  auto const before = fallbackAllocationCount<BigCounter>();
+  {
+    CounterPolymorphic<HybridStorage<64>> big{BigCounter{}};
+    auto copy = big;
+    CounterPolymorphic<HybridStorage<64>> small{Counter{}};
+    CounterPolymorphic<HeapStorage> heap{BigCounter{}};
+  }
+#if CXX_PLUGINS_COUNT_FALLBACK_ALLOCATIONS
+  EXPECT_EQ(fallbackAllocationCount<BigCounter>(), before + 2);
+#else
+  EXPECT_EQ(fallbackAllocationCount<BigCounter>(), before);
+#endif
+}
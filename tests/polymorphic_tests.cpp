@@ -143,3 +143,225 @@ TEST(Polymorphic, UniquePolymorphicTests) {
 
   UniquePolymorphic<Tag<printUnique>> up2 = std::move(up);
 }
+
+TEST(Polymorphic, TypeIndex) {
+  using namespace plugins;
+  using PolymorphicT = Polymorphic<Tag<add>, Tag<multiply>>;
+  static_assert(sizeof(PolymorphicT) ==
+                sizeof(DefaultStoragePolicy) +
+                    sizeof(PolymorphicT::FunctionTableT));
+
+  PolymorphicT poly;
+  EXPECT_EQ(poly.typeIndex(), type_id<void>());
+
+  foo obj;
+  poly = obj;
+  EXPECT_TRUE(poly.isA<foo>());
+  EXPECT_FALSE(poly.isA<int>());
+  EXPECT_EQ(poly.typeIndex(), type_id<foo>());
+
+  PolymorphicPtr<Tag<add>> ptr = poly;
+  EXPECT_TRUE(ptr.isA<foo>());
+  EXPECT_EQ(polymorphicCast<foo>(ptr), poly.data());
+
+  PolymorphicT moved = std::move(poly);
+  EXPECT_TRUE(moved.isA<foo>());
+  EXPECT_EQ(poly.typeIndex(), type_id<void>());
+}
+
+TEST(Polymorphic, ConstantTypeInfosAndTables) {
+  using namespace plugins;
+  static_assert(impl::type_name_v<foo> == "foo");
+  // cv-qualifiers are spelled differently by compilers
+  EXPECT_NE(impl::type_name_v<foo const &>.find("foo"),
+            std::string_view::npos);
+  static_assert(impl::typeInfoConstruct<foo const &>().size_m == 3);
+
+  using StorageT =
+      VTableStorage<foo, TaggedSignature<add, PolymorphicTagSignatureT<add>>>;
+  static_assert(StorageT::layout.header.type_info ==
+                &impl::typeInfoConstruct<foo>());
+  static_assert(StorageT::layout.header.size == sizeof(foo));
+  EXPECT_NE(StorageT::value, nullptr);
+  EXPECT_EQ(&impl::vtableHeader(StorageT::value), &StorageT::layout.header);
+  EXPECT_EQ(type_id<foo>().pretty_name(), "foo");
+}
+
+TEST(Polymorphic, InternedTypeInfosAndTables) {
+  using namespace plugins;
+  // infos with equal names are equal, as if they came from different plugins
+  auto const &info = impl::typeInfoConstruct<foo>();
+  EXPECT_EQ(&impl::internTypeInfo(std::string(info.type_m, info.size_m)),
+            &impl::internTypeInfo("foo"));
+  EXPECT_EQ(type_index(impl::internTypeInfo("foo")), type_id<foo>());
+  EXPECT_NE(type_id<foo>(), type_id<int>());
+
+  // ids are computed from names, so they are the same in every library
+  static_assert(impl::type_info_v<foo>.id_m == impl::fnv1a("foo"));
+  type_index const interned(impl::internTypeInfo("foo"));
+  EXPECT_EQ(interned.id(), type_id<foo>().id());
+  EXPECT_EQ(interned.hash_code(), type_id<foo>().hash_code());
+  EXPECT_FALSE(interned < type_id<foo>());
+  EXPECT_FALSE(type_id<foo>() < interned);
+
+  FnPtr<void()> const first_table[1] = {};
+  FnPtr<void()> const second_table[1] = {};
+  auto const &interface = impl::internTypeInfo("interned_tables_interface");
+  EXPECT_EQ(impl::internTypeTable(info, interface, first_table), first_table);
+  EXPECT_EQ(impl::internTypeTable(info, interface, second_table),
+            first_table);
+  // types without unique names are never shared
+  auto const &unnamed = impl::internTypeInfo("(anonymous namespace)::foo");
+  EXPECT_EQ(impl::internTypeTable(unnamed, interface, first_table),
+            first_table);
+  EXPECT_EQ(impl::internTypeTable(unnamed, interface, second_table),
+            second_table);
+}
+
+struct increment {};
+
+template <> struct plugins::PolymorphicTagSignature<increment> {
+  using Type = void();
+};
+template <>
+struct plugins::VTableSlotPriority<increment> : std::integral_constant<int, 1> {
+};
+
+template <typename T>
+constexpr void polymorphicExtend(increment /*unused*/, T &obj) {
+  obj.add(1);
+}
+
+TEST(Polymorphic, HotSlotsFirst) {
+  using namespace plugins;
+  using OrderT = impl::SlotOrder<add, multiply, increment>;
+  static_assert(OrderT::tag_at[0] == 2 && OrderT::tag_at[1] == 0 &&
+                OrderT::tag_at[2] == 1);
+  static_assert(OrderT::slot<increment> == 0 && OrderT::slot<add> == 1);
+  static_assert(impl::SlotOrder<Tag<multiply>, Tag<increment>>::slot<
+                    Tag<increment>> == 0);
+
+  using InterfaceT = TypeList<TaggedSignature<add, void(int)>,
+                              TaggedSignature<increment, void()>>;
+  using StorageT = VTableStorage<foo, TaggedSignature<add, void(int)>,
+                                 TaggedSignature<increment, void()>>;
+  static_assert(StorageT::layout.functions.typed.first ==
+                impl::table_trampoline_v<InterfaceT, increment, foo, void()>);
+
+  using PolymorphicT = Polymorphic<Tag<add>, Tag<multiply>, Tag<increment>>;
+  PolymorphicT poly{foo{}};
+  poly[tag<add>](2);
+  poly[tag<increment>]();
+  poly[tag<multiply>](3);
+  EXPECT_EQ(*static_cast<int *>(poly.data()), 9);
+
+  // hot functions are still the first ones, so the table is reused
+  static_assert(impl::SlotRemapping<TypeList<Tag<increment>, Tag<add>>,
+                                    TypeList<Tag<add>, Tag<multiply>,
+                                             Tag<increment>>>::is_prefix);
+  PolymorphicPtr<Tag<increment>, Tag<add>> prefix_ptr = poly;
+  prefix_ptr[tag<increment>]();
+  EXPECT_EQ(*static_cast<int *>(poly.data()), 10);
+
+  PolymorphicPtr<Tag<multiply>, Tag<add>> remapped_ptr = poly;
+  remapped_ptr[tag<add>](2);
+  remapped_ptr[tag<multiply>](2);
+  EXPECT_EQ(*static_cast<int *>(poly.data()), 24);
+  EXPECT_TRUE(remapped_ptr.isA<foo>());
+}
+
+namespace {
+void firstFunction() {}
+void secondFunction() {}
+} // namespace
+
+TEST(Polymorphic, RemappedTablesFollowSourceTables) {
+  using namespace plugins;
+  // source table as if it came from a library that is unloaded and another
+  // one is loaded at the same address
+  struct {
+    impl::VTableHeader header;
+    FnPtr<void()> functions[2];
+  } source{impl::makeVTableHeader<foo>(), {&firstFunction, &secondFunction}};
+  static_assert(sizeof(source) ==
+                sizeof(impl::VTableHeader) + 2 * sizeof(FnPtr<void()>));
+  constexpr std::uint8_t permutation[2] = {1, 0};
+
+  auto const *remapped_p =
+      impl::internVTable(source.functions, permutation, 2, 1, 2);
+  EXPECT_EQ(remapped_p[0], &secondFunction);
+  EXPECT_EQ(remapped_p[1], &firstFunction);
+  EXPECT_EQ(impl::internVTable(source.functions, permutation, 2, 1, 2),
+            remapped_p);
+
+  source.functions[1] = &firstFunction;
+  auto const *reloaded_p =
+      impl::internVTable(source.functions, permutation, 2, 1, 2);
+  EXPECT_NE(reloaded_p, remapped_p);
+  EXPECT_EQ(reloaded_p[0], &firstFunction);
+  EXPECT_FALSE(
+      impl::isRemappedVTable(remapped_p, source.functions, permutation, 2));
+
+  source.functions[1] = &secondFunction;
+  EXPECT_EQ(impl::internVTable(source.functions, permutation, 2, 1, 2),
+            remapped_p);
+}
+
+namespace {
+struct consume {};
+
+struct CountingArgument {
+  CountingArgument() = default;
+  CountingArgument(CountingArgument const & /*unused*/) { ++copies; }
+  CountingArgument(CountingArgument && /*unused*/) noexcept { ++moves; }
+  CountingArgument &operator=(CountingArgument const &) = delete;
+  CountingArgument &operator=(CountingArgument &&) = delete;
+  ~CountingArgument() = default;
+
+  static int copies;
+  static int moves;
+};
+int CountingArgument::copies = 0;
+int CountingArgument::moves = 0;
+
+struct Consumer {};
+
+void polymorphicExtend(consume /*unused*/, Consumer & /*unused*/,
+                       CountingArgument /*unused*/) {}
+} // namespace
+
+TEST(Polymorphic, ArgumentsAreForwardedWithoutCopies) {
+  using namespace plugins;
+  using ConsumeSignature = TaggedSignature<consume, void(CountingArgument)>;
+  static_assert(std::is_same_v<impl::TrampolineArgT<CountingArgument>,
+                               CountingArgument &&>);
+  static_assert(std::is_same_v<impl::TrampolineArgT<int>, int>);
+
+  Polymorphic<ConsumeSignature> poly{Consumer{}};
+  Consumer consumer;
+  PolymorphicPtr<ConsumeSignature> ptr{&consumer};
+  CountingArgument argument;
+
+  auto expectCounts = [](int copies, int moves) {
+    EXPECT_EQ(CountingArgument::copies, copies);
+    EXPECT_EQ(CountingArgument::moves, moves);
+    CountingArgument::copies = 0;
+    CountingArgument::moves = 0;
+  };
+
+  // rvalues are moved only into the parameter of polymorphicExtend
+  poly.call<consume>(CountingArgument{});
+  expectCounts(0, 1);
+  ptr.call<consume>(std::move(argument));
+  expectCounts(0, 1);
+  poly[consume{}](CountingArgument{});
+  expectCounts(0, 1);
+  // braced initializers are passed to the trampoline parameter
+  poly[consume{}]({});
+  expectCounts(0, 1);
+  // lvalues are copied once by the caller
+  poly.call<consume>(argument);
+  expectCounts(1, 1);
+  ptr[consume{}](argument);
+  expectCounts(1, 1);
+}
@@ -0,0 +1,175 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    polymorphic_vector_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    13 Oct 2020
+ * \brief
+ * Contains tests for PolymorphicVector
+ */
+
+#include <cxx_plugins/polymorphic_vector.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+struct accumulate {};
+struct total {};
+
+struct Adder {
+  void accumulate(int value) { sum_m += value; }
+  int sum_m = 0;
+};
+
+struct Multiplier {
+  void accumulate(int value) { sum_m += value * factor_m; }
+  int sum_m = 0;
+  int factor_m = 2;
+};
+
+struct Named {
+  Named() noexcept { ++alive; }
+  Named(Named const &other) : name_m(other.name_m), sum_m(other.sum_m) {
+    ++alive;
+  }
+  Named(Named &&other) noexcept
+      : name_m(std::move(other.name_m)), sum_m(other.sum_m) {
+    ++alive;
+  }
+  ~Named() { --alive; }
+
+  void accumulate(int value) { sum_m += value + static_cast<int>(name_m.size()); }
+
+  std::string name_m = "a name long enough to be allocated on the heap";
+  int sum_m = 0;
+  static int alive;
+};
+int Named::alive = 0;
+
+template <typename T>
+void polymorphicExtend(accumulate /*unused*/, T &obj, int value) {
+  obj.accumulate(value);
+}
+template <typename T> auto polymorphicExtend(total /*unused*/, T const &obj) -> int {
+  return obj.sum_m;
+}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<accumulate> {
+  using Type = void(int);
+};
+template <> struct plugins::PolymorphicTagSignature<total> {
+  using Type = int() const;
+};
+
+TEST(PolymorphicVector, ForEachAndIteration) {
+  using namespace plugins;
+  PolymorphicVector<accumulate, total> objects;
+  EXPECT_TRUE(objects.isEmpty());
+  EXPECT_EQ(objects.begin(), objects.end());
+
+  for (int i = 0; i < 10; ++i) {
+    objects.pushBack(Adder{});
+    objects.pushBack(Multiplier{});
+  }
+  EXPECT_EQ(objects.size(), 20);
+  EXPECT_EQ(objects.segmentCount(), 2);
+
+  objects.forEach<accumulate>(3);
+
+  int adders = 0;
+  int multipliers = 0;
+  for (auto obj : objects) {
+    if (obj.isA<Adder>()) {
+      ++adders;
+      EXPECT_EQ(obj.call<total>(), 3);
+    } else if (obj.isA<Multiplier>()) {
+      ++multipliers;
+      EXPECT_EQ(obj.call<total>(), 6);
+    }
+  }
+  EXPECT_EQ(adders, 10);
+  EXPECT_EQ(multipliers, 10);
+}
+
+TEST(PolymorphicVector, PolymorphicPtrViews) {
+  using namespace plugins;
+  PolymorphicVector<accumulate, total> objects;
+  objects.reserve<Adder>(2);
+  auto first = objects.pushBack(Adder{});
+  first.call<accumulate>(5);
+
+  PolymorphicPtr<total> view = first;
+  EXPECT_EQ(view.call<total>(), 5);
+  EXPECT_EQ(polymorphicCast<Adder>(first)->sum_m, 5);
+
+  auto const &const_objects = objects;
+  int sum = 0;
+  const_objects.forEach<total>();
+  for (auto obj : objects) {
+    sum += obj.call<total>();
+  }
+  EXPECT_EQ(sum, 5);
+}
+
+TEST(PolymorphicVector, ConstIteration) {
+  using namespace plugins;
+  PolymorphicVector<accumulate, total> objects;
+  auto const &const_objects = objects;
+  EXPECT_EQ(const_objects.begin(), const_objects.end());
+
+  objects.pushBack(Adder{});
+  objects.pushBack(Multiplier{});
+  objects.pushBack(Adder{});
+  objects.forEach<accumulate>(2);
+
+  static_assert(
+      std::is_same_v<decltype(*const_objects.begin()),
+                     PolymorphicVector<accumulate, total>::PointerT const>);
+  int sum = 0;
+  std::size_t count = 0;
+  for (auto const &obj : const_objects) {
+    sum += obj.call<total>();
+    ++count;
+  }
+  EXPECT_EQ(count, 3);
+  EXPECT_EQ(sum, 2 + 4 + 2);
+}
+
+TEST(PolymorphicVector, Lifetime) {
+  using namespace plugins;
+  {
+    PolymorphicVector<accumulate, total> objects;
+    for (int i = 0; i < 100; ++i) {
+      objects.emplaceBack(std::in_place_type_t<Named>{});
+      objects.pushBack(Adder{});
+    }
+    EXPECT_EQ(Named::alive, 100);
+    objects.forEach<accumulate>(1);
+
+    auto moved = std::move(objects);
+    EXPECT_TRUE(objects.isEmpty());
+    EXPECT_EQ(moved.size(), 200);
+    EXPECT_EQ(Named::alive, 100);
+
+    int named_total = 0;
+    for (auto obj : moved) {
+      if (obj.isA<Named>()) {
+        named_total += obj.call<total>();
+      }
+    }
+    EXPECT_EQ(named_total, 100 * (1 + static_cast<int>(Named{}.name_m.size())));
+
+    moved.clear();
+    EXPECT_EQ(Named::alive, 0);
+    moved.pushBack(Named{});
+    EXPECT_EQ(Named::alive, 1);
+  }
+  EXPECT_EQ(Named::alive, 0);
+}
@@ -0,0 +1,176 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    type_map_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for TypeMap and StaticTypeMap
+ */
+
+#include <cxx_plugins/type_map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <memory_resource>
+#include <string>
+#include <utility>
+
+namespace {
+template <std::size_t I> struct Numbered {};
+
+//! \brief Counts allocated bytes, memory is taken from new_delete_resource
+class CountingResource : public std::pmr::memory_resource {
+public:
+  std::size_t allocated_m = 0;
+  std::size_t deallocated_m = 0;
+
+private:
+  auto do_allocate(std::size_t bytes, std::size_t alignment) -> void * override {
+    allocated_m += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, std::size_t bytes,
+                     std::size_t alignment) override {
+    deallocated_m += bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  auto do_is_equal(std::pmr::memory_resource const &rhs) const noexcept
+      -> bool override {
+    return this == &rhs;
+  }
+};
+
+template <std::size_t... I>
+void insertNumbered(plugins::TypeMap<std::size_t> &map,
+                    std::index_sequence<I...> /*unused*/) {
+  (map.tryEmplace<Numbered<I>>(I), ...);
+}
+
+template <std::size_t... I>
+auto countFound(plugins::TypeMap<std::size_t> const &map,
+                std::index_sequence<I...> /*unused*/) -> std::size_t {
+  auto const found = [&map](std::size_t i, std::size_t const *value_p) {
+    return value_p != nullptr && *value_p == i ? 1 : 0;
+  };
+  return (std::size_t{0} + ... + found(I, map.find<Numbered<I>>()));
+}
+
+template <std::size_t... I>
+void eraseEven(plugins::TypeMap<std::size_t> &map,
+               std::index_sequence<I...> /*unused*/) {
+  ((I % 2 == 0 ? (void)map.erase<Numbered<I>>() : void()), ...);
+}
+} // namespace
+
+TEST(TypeMap, InsertsFindsAndErases) {
+  using namespace plugins;
+  TypeMap<std::string> map;
+  EXPECT_TRUE(map.isEmpty());
+  EXPECT_EQ(map.find<int>(), nullptr);
+
+  auto [value_p, inserted] = map.tryEmplace<int>("int");
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(*value_p, "int");
+  EXPECT_FALSE(map.tryEmplace<int>("other").second);
+  map.tryEmplace(type_id<double>(), "double");
+
+  EXPECT_EQ(map.size(), 2);
+  EXPECT_EQ(*map.find(type_id<int>()), "int");
+  EXPECT_EQ(*std::as_const(map).find<double>(), "double");
+  EXPECT_FALSE(map.contains<float>());
+
+  EXPECT_TRUE(map.erase<int>());
+  EXPECT_FALSE(map.erase<int>());
+  EXPECT_EQ(map.find<int>(), nullptr);
+  EXPECT_EQ(map.size(), 1);
+
+  // infos of other libraries have the same ids
+  auto const &info = impl::internTypeInfo(impl::type_name_v<double>);
+  EXPECT_EQ(*map.find(type_index(info)), "double");
+  // keys outlive libraries that inserted them
+  map.forEach([&info](type_index type, std::string const & /*unused*/) {
+    EXPECT_EQ(&type.type_info(), &info);
+  });
+}
+
+TEST(TypeMap, GrowsAndReusesDeletedSlots) {
+  using namespace plugins;
+  constexpr auto indices = std::make_index_sequence<200>{};
+  TypeMap<std::size_t> map;
+  insertNumbered(map, indices);
+  EXPECT_EQ(map.size(), 200);
+  EXPECT_EQ(countFound(map, indices), 200);
+  EXPECT_LE(map.size(), map.capacity() * 7 / 8);
+
+  eraseEven(map, indices);
+  EXPECT_EQ(map.size(), 100);
+  EXPECT_EQ(countFound(map, indices), 100);
+
+  auto const capacity = map.capacity();
+  for (int i = 0; i < 10; ++i) {
+    eraseEven(map, indices);
+    insertNumbered(map, indices);
+  }
+  EXPECT_EQ(map.capacity(), capacity);
+  EXPECT_EQ(countFound(map, indices), 200);
+
+  std::size_t sum = 0;
+  map.forEach([&sum](type_index /*unused*/, std::size_t value) { sum += value; });
+  EXPECT_EQ(sum, 199 * 200 / 2);
+
+  auto moved = std::move(map);
+  EXPECT_EQ(countFound(moved, indices), 200);
+  EXPECT_TRUE(map.isEmpty());
+  map = std::move(moved);
+  EXPECT_EQ(countFound(map, indices), 200);
+  map.clear();
+  EXPECT_EQ(countFound(map, indices), 0);
+}
+
+TEST(TypeMap, AllocatesThroughAllocator) {
+  using namespace plugins;
+  CountingResource resource;
+  {
+    TypeMap<Vector<int>> map(&resource);
+    map.tryEmplace<int>(100, 1);
+    map.tryEmplace<double>(100, 2);
+    // values are constructed with the allocator of the map
+    EXPECT_GE(resource.allocated_m, 200 * sizeof(int));
+
+    CountingResource other_resource;
+    TypeMap<Vector<int>> other(&other_resource);
+    other = std::move(map);
+    EXPECT_EQ(other.find<int>()->size(), 100);
+    EXPECT_EQ(other.find<double>()->front(), 2);
+  }
+  EXPECT_EQ(resource.allocated_m, resource.deallocated_m);
+}
+
+TEST(StaticTypeMap, IndexesByType) {
+  using namespace plugins;
+  CountingResource resource;
+  {
+    StaticTypeMap<std::string> map(&resource);
+    EXPECT_EQ(map.find<Numbered<0>>(), nullptr);
+    EXPECT_TRUE(map.tryEmplace<Numbered<0>>("zero").second);
+    EXPECT_FALSE(map.tryEmplace<Numbered<0>>("other").second);
+    map.tryEmplace<Numbered<1>>("one");
+    EXPECT_EQ(*map.find<Numbered<0>>(), "zero");
+    EXPECT_EQ(*std::as_const(map).find<Numbered<1>>(), "one");
+    EXPECT_EQ(map.size(), 2);
+
+    EXPECT_TRUE(map.erase<Numbered<0>>());
+    EXPECT_FALSE(map.contains<Numbered<0>>());
+    EXPECT_EQ(map.size(), 1);
+    EXPECT_GT(resource.allocated_m, 0);
+  }
+  EXPECT_EQ(resource.allocated_m, resource.deallocated_m);
+  EXPECT_EQ(impl::denseTypeIndex<Numbered<1>>(),
+            impl::denseTypeIndex(impl::internTypeInfo(
+                impl::type_name_v<Numbered<1>>)));
+}
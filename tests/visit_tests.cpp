@@ -0,0 +1,116 @@
+/*************************************************************************************************
+ * Copyright (C) 2020 by Andrey Ponomarev and Timur Kazhimuratov
+ * This file is part of CXX Plugins project.
+ * License is available at
+ * https://github.com/Spaghetti-Software/cxx_plugins/blob/master/LICENSE
+ *************************************************************************************************/
+/*!
+ * \file    visit_tests.cpp
+ * \author  Andrey Ponomarev
+ * \date    16 Oct 2020
+ * \brief
+ * Contains tests for visit
+ */
+
+#include <cxx_plugins/polymorphic.hpp>
+#include <cxx_plugins/polymorphic_ptr.hpp>
+#include <cxx_plugins/visit.hpp>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace {
+struct area {};
+struct grow {};
+
+struct Circle {
+  int radius_m = 1;
+};
+struct Box {
+  int side_m = 2;
+};
+struct Plane {};
+
+template <std::size_t I> struct Numbered {};
+
+template <typename T> auto polymorphicExtend(area /*unused*/, T const &) -> int {
+  return 0;
+}
+template <typename T> void polymorphicExtend(grow /*unused*/, T &) {}
+} // namespace
+
+template <> struct plugins::PolymorphicTagSignature<area> {
+  using Type = int() const;
+};
+template <> struct plugins::PolymorphicTagSignature<grow> {
+  using Type = void();
+};
+
+TEST(Visit, DispatchesOnDynamicType) {
+  using namespace plugins;
+  using PolymorphicT = Polymorphic<Tag<area>>;
+  using ShapesT = TypeList<Circle, Box>;
+  auto describe = Overloaded{
+      [](Circle &circle) { return "circle " + std::to_string(circle.radius_m); },
+      [](Box &box) { return "box " + std::to_string(box.side_m); },
+      [](UnknownType unknown) {
+        return "unknown " + std::string(unknown.type.pretty_name());
+      }};
+
+  PolymorphicT circle = Circle{3};
+  PolymorphicT box = Box{4};
+  PolymorphicT plane = Plane{};
+  EXPECT_EQ(visit<ShapesT>(circle, describe), "circle 3");
+  EXPECT_EQ(visit<ShapesT>(box, describe), "box 4");
+  EXPECT_EQ(visit<ShapesT>(plane, describe),
+            "unknown " + std::string(type_id<Plane>().pretty_name()));
+  EXPECT_EQ(visit<ShapesT>(PolymorphicT{}, describe), "unknown void");
+  EXPECT_EQ(visit<TypeList<>>(circle, describe),
+            "unknown " + std::string(type_id<Circle>().pretty_name()));
+}
+
+TEST(Visit, PassesObjectsWithAccessOfPolymorphic) {
+  using namespace plugins;
+  using ShapesT = TypeList<Circle, Box>;
+  auto doubled = Overloaded{[](Circle &circle) { circle.radius_m *= 2; },
+                            [](Box &box) { box.side_m *= 2; },
+                            [](UnknownType /*unused*/) {}};
+  auto is_const = [](auto &&object) {
+    return std::is_const_v<std::remove_reference_t<decltype(object)>>;
+  };
+
+  Circle circle{3};
+  PolymorphicPtr<Tag<grow>> ptr{&circle};
+  visit<ShapesT>(ptr, doubled);
+  EXPECT_EQ(circle.radius_m, 6);
+  // the visitor can be an rvalue
+  visit<ShapesT>(ptr, Overloaded{[](Circle &circle) { circle.radius_m = 1; },
+                                 [](auto const & /*unused*/) {}});
+  EXPECT_EQ(circle.radius_m, 1);
+
+  Polymorphic<Tag<grow>> const box = Box{4};
+  EXPECT_TRUE(visit<ShapesT>(box, is_const));
+  EXPECT_FALSE(visit<ShapesT>(ptr, is_const));
+}
+
+template <std::size_t... I>
+void expectAllNumberedTypesFound(std::index_sequence<I...> /*unused*/) {
+  using namespace plugins;
+  using HashT = impl::TypeIdHash<Numbered<I>...>;
+  std::size_t const indices[] = {HashT::find(type_id<Numbered<I>>().id())...};
+  for (std::size_t i = 0; i < sizeof...(I); ++i) {
+    EXPECT_EQ(indices[i], i);
+  }
+  EXPECT_EQ(HashT::find(type_id<Circle>().id()), HashT::npos);
+  EXPECT_EQ(HashT::find(type_id<void>().id()), HashT::npos);
+}
+
+TEST(Visit, PerfectHashOfManyTypes) {
+  using namespace plugins;
+  static_assert(impl::TypeIdHash<Circle, Box>::find(
+                    impl::typeInfoConstruct<Box>().id_m) == 1);
+  expectAllNumberedTypesFound(std::make_index_sequence<1>{});
+  expectAllNumberedTypesFound(std::make_index_sequence<17>{});
+  expectAllNumberedTypesFound(std::make_index_sequence<64>{});
+}